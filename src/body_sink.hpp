@@ -0,0 +1,43 @@
+/*
+ * WebCrawler: body_sink.hpp
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file body_sink.hpp
+ * @author Kyle Givler
+ */
+
+#ifndef _WC_BODY_SINK_H_
+#define _WC_BODY_SINK_H_
+
+#include <cstddef>
+
+class body_sink
+{
+public:
+  virtual ~body_sink() {}
+  
+  /**
+   * Receive the next piece of a response body
+   * @param data Only valid for the duration of the call
+   * @param size Number of bytes at data
+   */
+  virtual void append_body(const char *data, std::size_t size) = 0;
+private:
+};
+
+#endif
@@ -0,0 +1,180 @@
+/*
+ * WebCrawler: buffer_chain.cxx
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file buffer_chain.cxx
+ * @author Kyle Givler
+ */
+
+#include "buffer_chain.hpp"
+#include <algorithm>
+#include <cstring>
+
+const std::size_t buffer_pool::block_size;
+
+buffer_pool::buffer_pool(std::size_t max_free)
+  : max_free(max_free)
+{
+}
+
+buffer_pool::~buffer_pool()
+{
+  for(char *block : free_blocks)
+    delete[] block;
+}
+
+buffer_pool& buffer_pool::get()
+{
+  static buffer_pool pool;
+  return pool;
+}
+
+char* buffer_pool::acquire()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    in_use++;
+    if(!free_blocks.empty())
+    {
+      char *block = free_blocks.back();
+      free_blocks.pop_back();
+      return block;
+    }
+    allocated++;
+  }
+  return new char[block_size];
+}
+
+void buffer_pool::release(char *block)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    in_use--;
+    if(free_blocks.size() < max_free)
+    {
+      free_blocks.push_back(block);
+      return;
+    }
+  }
+  delete[] block;
+}
+
+std::size_t buffer_pool::get_allocated() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return allocated;
+}
+
+std::size_t buffer_pool::get_in_use() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return in_use;
+}
+
+std::size_t buffer_pool::get_free() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return free_blocks.size();
+}
+
+////////////////////////////////////////////////////////////////////////
+
+buffer_chain::buffer_chain(buffer_pool &pool)
+  : pool(pool)
+{
+}
+
+buffer_chain::~buffer_chain()
+{
+  clear();
+}
+
+void buffer_chain::append(const char *data, std::size_t size)
+{
+  length += size;
+  
+  // Read into prepare()'s space: kept, or moved over what was skipped
+  if(!chain.empty())
+  {
+    char *end = chain.back() + tail_used;
+    char *limit = chain.back() + buffer_pool::block_size;
+    if(data >= end && data < limit && size <= std::size_t(limit - data))
+    {
+      if(data != end)
+      {
+        std::memmove(end, data, size);
+        copied += size;
+      }
+      tail_used += size;
+      return;
+    }
+  }
+  
+  copied += size;
+  while(size > 0)
+  {
+    if(chain.empty() || tail_used == buffer_pool::block_size)
+    {
+      chain.push_back(pool.acquire());
+      tail_used = 0;
+    }
+    std::size_t n = std::min(size, buffer_pool::block_size - tail_used);
+    std::memcpy(chain.back() + tail_used, data, n);
+    tail_used += n;
+    data += n;
+    size -= n;
+  }
+}
+
+boost::asio::mutable_buffers_1 buffer_chain::prepare()
+{
+  if(chain.empty() || tail_used == buffer_pool::block_size)
+  {
+    chain.push_back(pool.acquire());
+    tail_used = 0;
+  }
+  return boost::asio::mutable_buffers_1(chain.back() + tail_used,
+    buffer_pool::block_size - tail_used);
+}
+
+void buffer_chain::clear()
+{
+  for(char *block : chain)
+    pool.release(block);
+  chain.clear();
+  tail_used = 0;
+  length = 0;
+  copied = 0;
+}
+
+std::string buffer_chain::prefix(std::size_t size) const
+{
+  std::string out;
+  out.reserve(std::min(size, length));
+  for(std::size_t i = 0; i < chain.size() && out.size() < size; i++)
+  {
+    boost::string_ref b = block(i);
+    out.append(b.data(), std::min(b.size(), size - out.size()));
+  }
+  return out;
+}
+
+std::string buffer_chain::to_string() const
+{
+  return prefix(length);
+}
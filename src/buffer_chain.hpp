@@ -0,0 +1,172 @@
+/*
+ * WebCrawler: buffer_chain.hpp
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file buffer_chain.hpp
+ * @author Kyle Givler
+ */
+
+#ifndef _WC_BUFFER_CHAIN_H_
+#define _WC_BUFFER_CHAIN_H_
+
+#include <boost/asio/buffer.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Fixed size blocks handed out again once they are given back, shared by
+ * every buffer_chain. Thread safe
+ */
+class buffer_pool
+{
+public:
+  static const std::size_t block_size = 16 * 1024;
+  
+  /**
+   * @param max_free Most returned blocks kept for reuse, the rest are freed
+   */
+  explicit buffer_pool(std::size_t max_free = 4096);
+  
+  virtual ~buffer_pool();
+  
+  /**
+   * @return A block of block_size bytes
+   */
+  char* acquire();
+  
+  void release(char *block);
+  
+  /**
+   * @return The pool the crawler's requests use
+   */
+  static buffer_pool& get();
+  
+  /**
+   * @return Blocks allocated from the heap so far
+   */
+  std::size_t get_allocated() const;
+  
+  /**
+   * @return Blocks handed out and not given back
+   */
+  std::size_t get_in_use() const;
+  
+  /**
+   * @return Blocks kept for reuse
+   */
+  std::size_t get_free() const;
+
+private:
+  mutable std::mutex mutex;
+  std::vector<char*> free_blocks;
+  std::size_t max_free;
+  std::size_t allocated = 0;
+  std::size_t in_use = 0;
+};
+
+/**
+ * A response body as a chain of pool blocks, it grows without moving what
+ * it holds. Read into prepare() and append() what was read, bytes already
+ * where they belong are kept in place
+ */
+class buffer_chain
+{
+public:
+  explicit buffer_chain(buffer_pool &pool = buffer_pool::get());
+  
+  buffer_chain(const buffer_chain&) = delete;
+  
+  buffer_chain& operator=(const buffer_chain&) = delete;
+  
+  virtual ~buffer_chain();
+  
+  /**
+   * Append bytes. Bytes inside the space prepare() returned are kept
+   * where they are, or moved down to the end of the chain, anything else
+   * is copied
+   */
+  void append(const char *data, std::size_t size);
+  
+  /**
+   * @return The free space at the end of the last block, a new block is
+   *  added when it is full. Bytes read into it must be appended before
+   *  anything else is
+   */
+  boost::asio::mutable_buffers_1 prepare();
+  
+  /**
+   * Give the blocks back to the pool, the block list keeps its capacity
+   */
+  void clear();
+  
+  /**
+   * @return Bytes held
+   */
+  std::size_t size() const { return this->length; }
+  
+  bool empty() const { return this->length == 0; }
+  
+  /**
+   * @return Number of blocks holding bytes, for a scatter view
+   */
+  std::size_t blocks() const { return this->chain.size(); }
+  
+  /**
+   * @return The bytes held in block i
+   */
+  boost::string_ref block(std::size_t i) const
+  {
+    return boost::string_ref(chain[i],
+      i + 1 == chain.size() ? tail_used : buffer_pool::block_size);
+  }
+  
+  /**
+   * @return The first size bytes, or all of them
+   */
+  std::string prefix(std::size_t size) const;
+  
+  /**
+   * @return All the bytes coalesced in one string
+   */
+  std::string to_string() const;
+  
+  /**
+   * @return Bytes of memory held, for accounting
+   */
+  std::size_t capacity() const
+  {
+    return this->chain.size() * buffer_pool::block_size;
+  }
+  
+  /**
+   * @return Bytes append() copied or moved, the rest were kept in place
+   */
+  std::size_t get_copied() const { return this->copied; }
+
+private:
+  buffer_pool &pool;
+  std::vector<char*> chain;
+  std::size_t tail_used = 0;
+  std::size_t length = 0;
+  std::size_t copied = 0;
+};
+
+#endif
@@ -0,0 +1,265 @@
+/*
+ * WebCrawler: byte_scanner.cxx
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file byte_scanner.cxx
+ * @author Kyle Givler
+ */
+
+#include "byte_scanner.hpp"
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define WC_SCAN_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+  bool is_space(char c)
+  {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\f' || c == '\r';
+  }
+  
+  const char* scalar_tag_stop(const char *p, const char *end, bool slash,
+    bool equals)
+  {
+    for(; p < end; p++)
+    {
+      char c = *p;
+      if(is_space(c) || c == '>' || (slash && c == '/') ||
+        (equals && c == '='))
+        return p;
+    }
+    return end;
+  }
+  
+  const char* scalar_end_tag(const char *p, const char *end, char c)
+  {
+    while(p < end)
+    {
+      p = static_cast<const char*>(std::memchr(p, '<', end - p));
+      if(!p)
+        return end;
+      if(end - p < 2 || (p[1] == '/' && (end - p < 3 || (p[2] | 0x20) == c)))
+        return p;
+      p++;
+    }
+    return end;
+  }
+
+#ifdef WC_SCAN_X86
+  // The vector loops leave the last few bytes to the scalar ones
+  
+  __attribute__((target("sse2")))
+  const char* sse2_tag_stop(const char *p, const char *end, bool slash,
+    bool equals)
+  {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i ff = _mm_set1_epi8('\f');
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i gt = _mm_set1_epi8('>');
+    // A disabled stop looks for '>' again
+    const __m128i sl = _mm_set1_epi8(slash ? '/' : '>');
+    const __m128i eq = _mm_set1_epi8(equals ? '=' : '>');
+    
+    for(; end - p >= 16; p += 16)
+    {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+      __m128i m = _mm_or_si128(
+        _mm_or_si128(
+          _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab)),
+          _mm_or_si128(_mm_cmpeq_epi8(v, lf), _mm_cmpeq_epi8(v, ff))),
+        _mm_or_si128(
+          _mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, gt)),
+          _mm_or_si128(_mm_cmpeq_epi8(v, sl), _mm_cmpeq_epi8(v, eq))));
+      int bits = _mm_movemask_epi8(m);
+      if(bits)
+        return p + __builtin_ctz(bits);
+    }
+    return scalar_tag_stop(p, end, slash, equals);
+  }
+  
+  __attribute__((target("sse2")))
+  const char* sse2_end_tag(const char *p, const char *end, char c)
+  {
+    const __m128i lt = _mm_set1_epi8('<');
+    const __m128i sl = _mm_set1_epi8('/');
+    const __m128i letter = _mm_set1_epi8(c);
+    const __m128i fold = _mm_set1_epi8(0x20);
+    
+    // Three loads a byte apart compare '<', '/' and c at once
+    for(; end - p >= 18; p += 16)
+    {
+      __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+      __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+      __m128i n = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 2));
+      __m128i m = _mm_and_si128(
+        _mm_and_si128(_mm_cmpeq_epi8(a, lt), _mm_cmpeq_epi8(b, sl)),
+        _mm_cmpeq_epi8(_mm_or_si128(n, fold), letter));
+      int bits = _mm_movemask_epi8(m);
+      if(bits)
+        return p + __builtin_ctz(bits);
+    }
+    return scalar_end_tag(p, end, c);
+  }
+  
+  __attribute__((target("avx2")))
+  const char* avx2_tag_stop(const char *p, const char *end, bool slash,
+    bool equals)
+  {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const __m256i ff = _mm256_set1_epi8('\f');
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i gt = _mm256_set1_epi8('>');
+    const __m256i sl = _mm256_set1_epi8(slash ? '/' : '>');
+    const __m256i eq = _mm256_set1_epi8(equals ? '=' : '>');
+    
+    for(; end - p >= 32; p += 32)
+    {
+      __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+      __m256i m = _mm256_or_si256(
+        _mm256_or_si256(
+          _mm256_or_si256(_mm256_cmpeq_epi8(v, space),
+            _mm256_cmpeq_epi8(v, tab)),
+          _mm256_or_si256(_mm256_cmpeq_epi8(v, lf),
+            _mm256_cmpeq_epi8(v, ff))),
+        _mm256_or_si256(
+          _mm256_or_si256(_mm256_cmpeq_epi8(v, cr),
+            _mm256_cmpeq_epi8(v, gt)),
+          _mm256_or_si256(_mm256_cmpeq_epi8(v, sl),
+            _mm256_cmpeq_epi8(v, eq))));
+      unsigned bits = _mm256_movemask_epi8(m);
+      if(bits)
+        return p + __builtin_ctz(bits);
+    }
+    return sse2_tag_stop(p, end, slash, equals);
+  }
+  
+  __attribute__((target("avx2")))
+  const char* avx2_end_tag(const char *p, const char *end, char c)
+  {
+    const __m256i lt = _mm256_set1_epi8('<');
+    const __m256i sl = _mm256_set1_epi8('/');
+    const __m256i letter = _mm256_set1_epi8(c);
+    const __m256i fold = _mm256_set1_epi8(0x20);
+    
+    for(; end - p >= 34; p += 32)
+    {
+      __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+      __m256i b = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(p + 1));
+      __m256i n = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(p + 2));
+      __m256i m = _mm256_and_si256(
+        _mm256_and_si256(_mm256_cmpeq_epi8(a, lt), _mm256_cmpeq_epi8(b, sl)),
+        _mm256_cmpeq_epi8(_mm256_or_si256(n, fold), letter));
+      unsigned bits = _mm256_movemask_epi8(m);
+      if(bits)
+        return p + __builtin_ctz(bits);
+    }
+    return sse2_end_tag(p, end, c);
+  }
+#endif
+
+  struct scan_functions
+  {
+    const char* (*tag_stop)(const char*, const char*, bool, bool);
+    const char* (*end_tag)(const char*, const char*, char);
+  };
+  
+  const scan_functions scalar_functions = { scalar_tag_stop, scalar_end_tag };
+#ifdef WC_SCAN_X86
+  const scan_functions sse2_functions = { sse2_tag_stop, sse2_end_tag };
+  const scan_functions avx2_functions = { avx2_tag_stop, avx2_end_tag };
+#endif
+
+  const scan_functions& functions_for(byte_scanner::Level level)
+  {
+#ifdef WC_SCAN_X86
+    if(level == byte_scanner::Level::AVX2)
+      return avx2_functions;
+    if(level == byte_scanner::Level::SSE2)
+      return sse2_functions;
+#endif
+    return scalar_functions;
+  }
+  
+  byte_scanner::Level detect()
+  {
+#ifdef WC_SCAN_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+      return byte_scanner::Level::AVX2;
+    if(__builtin_cpu_supports("sse2"))
+      return byte_scanner::Level::SSE2;
+#endif
+    return byte_scanner::Level::SCALAR;
+  }
+  
+  const byte_scanner::Level best_level = detect();
+  byte_scanner::Level current_level = best_level;
+  const scan_functions *current = &functions_for(best_level);
+}
+
+byte_scanner::Level byte_scanner::best()
+{
+  return best_level;
+}
+
+byte_scanner::Level byte_scanner::level()
+{
+  return current_level;
+}
+
+bool byte_scanner::use(Level level)
+{
+  if(level > best_level)
+    return false;
+  current_level = level;
+  current = &functions_for(level);
+  return true;
+}
+
+const char* byte_scanner::name(Level level)
+{
+  switch(level)
+  {
+    case Level::AVX2:
+      return "avx2";
+    case Level::SSE2:
+      return "sse2";
+    default:
+      return "scalar";
+  }
+}
+
+const char* byte_scanner::tag_stop(const char *p, const char *end,
+  bool slash, bool equals)
+{
+  return current->tag_stop(p, end, slash, equals);
+}
+
+const char* byte_scanner::end_tag(const char *p, const char *end, char c)
+{
+  return current->end_tag(p, end, c);
+}
@@ -0,0 +1,73 @@
+/*
+ * WebCrawler: byte_scanner.hpp
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file byte_scanner.hpp
+ * @author Kyle Givler
+ */
+
+#ifndef _WC_BYTE_SCANNER_H_
+#define _WC_BYTE_SCANNER_H_
+
+/**
+ * The byte searches link_extractor spends its time in, 16 or 32 bytes
+ * at a time with SSE2 or AVX2 when the CPU has them, one at a time
+ * otherwise. The fastest level the CPU supports is picked at startup
+ */
+class byte_scanner
+{
+public:
+  enum class Level { SCALAR, SSE2, AVX2 };
+  
+  /**
+   * @return The fastest level this CPU can run
+   */
+  static Level best();
+  
+  /**
+   * @return The level searches run at
+   */
+  static Level level();
+  
+  /**
+   * Run searches at level from now on, for tests and benchmarks. Not
+   * safe while another thread is scanning
+   * @return false if the CPU cannot run it, the level is left as it was
+   */
+  static bool use(Level level);
+  
+  static const char* name(Level level);
+  
+  /**
+   * Find where a tag name, attribute name or unquoted value stops
+   * @return The first HTML space or '>' in [p, end), or '/' if slash,
+   *  or '=' if equals; end if there is none
+   */
+  static const char* tag_stop(const char *p, const char *end,
+    bool slash, bool equals);
+  
+  /**
+   * Find the end tag of a raw text element whose name starts with c
+   * @param c A lower case letter, matched in either case
+   * @return The first "</c" in [p, end), or a '<' or "</" cut off by
+   *  end; end if there is none
+   */
+  static const char* end_tag(const char *p, const char *end, char c);
+};
+
+#endif
@@ -0,0 +1,297 @@
+/*
+ * WebCrawler: compact_url.cxx
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file compact_url.cxx
+ * @author Kyle Givler
+ */
+
+#include "compact_url.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+namespace
+{
+  const std::size_t chunk_size = 64 * 1024;
+  
+  std::uint64_t mix(std::uint64_t x)
+  {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+  }
+}
+
+/**
+ * A block of path bytes, freed when the last URL using it and the arena
+ * are done with it
+ */
+struct compact_url::chunk
+{
+  std::atomic<std::uint32_t> refs;
+  std::size_t capacity;
+  std::size_t used;
+  char data[1];
+};
+
+std::mutex compact_url::arena_mutex;
+compact_url::chunk *compact_url::current = nullptr;
+std::atomic<std::size_t> compact_url::arena_total(0);
+
+////////////////////////////////////////////////////////////////////////
+
+host_table::host_table()
+  : count(0)
+{
+  for(auto &block : blocks)
+    block = nullptr;
+}
+
+host_table::~host_table()
+{
+  for(auto &block : blocks)
+    delete[] block.load();
+}
+
+host_table& host_table::get()
+{
+  static host_table table;
+  return table;
+}
+
+void host_table::locate(std::uint32_t id, std::size_t &block, 
+  std::size_t &offset)
+{
+  // Block b starts at first_block * (2^b - 1)
+  std::uint64_t n = std::uint64_t(id) / first_block + 1;
+  block = 63 - __builtin_clzll(n);
+  offset = id - first_block * ((std::uint64_t(1) << block) - 1);
+}
+
+std::uint32_t host_table::intern(const std::string &host)
+{
+  host_table &t = get();
+  std::lock_guard<std::mutex> lock(t.mutex);
+  auto found = t.ids.find(host);
+  if(found != t.ids.end())
+    return found->second;
+  
+  std::size_t id = t.count.load(std::memory_order_relaxed);
+  std::size_t block, offset;
+  locate(id, block, offset);
+  if(offset == 0)
+    t.blocks[block].store(new std::string[first_block << block], 
+      std::memory_order_relaxed);
+  
+  t.blocks[block].load(std::memory_order_relaxed)[offset] = host;
+  t.ids[host] = id;
+  // Readers that see the new count see the name and its block
+  t.count.store(id + 1, std::memory_order_release);
+  return id;
+}
+
+const std::string& host_table::name(std::uint32_t id)
+{
+  host_table &t = get();
+  if(id >= t.count.load(std::memory_order_acquire))
+    throw(std::out_of_range("host_table: no such host id"));
+  
+  std::size_t block, offset;
+  locate(id, block, offset);
+  return t.blocks[block].load(std::memory_order_relaxed)[offset];
+}
+
+std::size_t host_table::size()
+{
+  return get().count.load(std::memory_order_acquire);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+compact_url::compact_url()
+{
+}
+
+compact_url::compact_url(
+  const std::string &protocol, 
+  const std::string &host, 
+  boost::string_ref path)
+  : host(host_table::intern(host)),
+    scheme(to_scheme(protocol)),
+    fp(fingerprint(protocol, host, path))
+{
+  store_path(path);
+}
+
+compact_url::compact_url(const compact_url &other)
+  : block(other.block),
+    offset(other.offset),
+    length(other.length),
+    host(other.host),
+    scheme(other.scheme),
+    fp(other.fp)
+{
+  if(block)
+    block->refs++;
+}
+
+compact_url::compact_url(compact_url &&other)
+  : block(other.block),
+    offset(other.offset),
+    length(other.length),
+    host(other.host),
+    scheme(other.scheme),
+    fp(other.fp)
+{
+  other.block = nullptr;
+  other.length = 0;
+}
+
+compact_url& compact_url::operator=(compact_url other)
+{
+  std::swap(block, other.block);
+  std::swap(offset, other.offset);
+  std::swap(length, other.length);
+  std::swap(host, other.host);
+  std::swap(scheme, other.scheme);
+  std::swap(fp, other.fp);
+  return *this;
+}
+
+compact_url::~compact_url()
+{
+  release();
+}
+
+const std::string& compact_url::get_protocol() const
+{
+  static const std::string http = "http";
+  static const std::string https = "https";
+  return scheme == Scheme::HTTPS ? https : http;
+}
+
+boost::string_ref compact_url::get_path() const
+{
+  if(!block)
+    return boost::string_ref();
+  return boost::string_ref(block->data + offset, length);
+}
+
+std::string compact_url::to_string() const
+{
+  std::string s = get_protocol() + "://" + get_host();
+  boost::string_ref path = get_path();
+  s.append(path.data(), path.size());
+  return s;
+}
+
+compact_url::site_type compact_url::make_site(const std::string &protocol,
+  const std::string &host)
+{
+  return make_site(to_scheme(protocol), host_table::intern(host));
+}
+
+std::string compact_url::site_name(site_type site)
+{
+  Scheme scheme = static_cast<Scheme>(site >> 32);
+  std::uint32_t host = static_cast<std::uint32_t>(site);
+  return (scheme == Scheme::HTTPS ? "https://" : "http://") + 
+    host_table::name(host);
+}
+
+std::uint64_t compact_url::fingerprint(
+  boost::string_ref protocol,
+  boost::string_ref host,
+  boost::string_ref path)
+{
+  // FNV-1a, the separators keep "a" + "bc" apart from "ab" + "c"
+  std::uint64_t h = 0xcbf29ce484222325ULL;
+  auto add = [&h](boost::string_ref s) {
+    for(unsigned char c : s)
+    {
+      h ^= c;
+      h *= 0x100000001b3ULL;
+    }
+    h ^= 0xff;
+    h *= 0x100000001b3ULL;
+  };
+  add(protocol);
+  add(host);
+  add(path);
+  return mix(h);
+}
+
+std::size_t compact_url::arena_bytes()
+{
+  return arena_total;
+}
+
+Scheme compact_url::to_scheme(const std::string &protocol)
+{
+  // Only http and https links are stored
+  return protocol == "https" ? Scheme::HTTPS : Scheme::HTTP;
+}
+
+void compact_url::store_path(boost::string_ref path)
+{
+  if(path.empty())
+    return;
+  
+  std::lock_guard<std::mutex> lock(arena_mutex);
+  if(!current || current->capacity - current->used < path.size())
+  {
+    // The arena lets go of the full chunk, the URLs in it keep it alive
+    if(current && --current->refs == 0)
+    {
+      arena_total -= current->capacity;
+      std::free(current);
+    }
+    
+    std::size_t capacity = std::max(chunk_size, path.size());
+    current = static_cast<chunk*>(std::malloc(sizeof(chunk) + capacity));
+    if(!current)
+      throw std::bad_alloc();
+    new (&current->refs) std::atomic<std::uint32_t>(1);
+    current->capacity = capacity;
+    current->used = 0;
+    arena_total += capacity;
+  }
+  
+  std::memcpy(current->data + current->used, path.data(), path.size());
+  block = current;
+  offset = current->used;
+  length = path.size();
+  current->used += path.size();
+  current->refs++;
+}
+
+void compact_url::release()
+{
+  if(block && --block->refs == 0)
+  {
+    arena_total -= block->capacity;
+    std::free(block);
+  }
+  block = nullptr;
+}
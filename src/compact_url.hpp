@@ -0,0 +1,187 @@
+/*
+ * WebCrawler: compact_url.hpp
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file compact_url.hpp
+ * @author Kyle Givler
+ */
+
+#ifndef _WC_COMPACT_URL_H_
+#define _WC_COMPACT_URL_H_
+
+#include <boost/utility/string_ref.hpp>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+enum class Scheme : std::uint8_t { HTTP = 0, HTTPS = 1 };
+
+/**
+ * Host names interned to small ids shared by every compact_url
+ * Ids are never reused and names never move, so a reference to a name
+ * stays valid. Thread safe, only intern() takes the lock: names are kept
+ * in blocks that are never moved or freed, each twice the size of the 
+ * one before, and a name is published by the count of names
+ */
+class host_table
+{
+public:
+  static std::uint32_t intern(const std::string &host);
+  
+  /**
+   * @param id An id intern() returned
+   */
+  static const std::string& name(std::uint32_t id);
+  
+  /**
+   * @return Number of hosts interned
+   */
+  static std::size_t size();
+  
+  ~host_table();
+  
+private:
+  static const std::size_t first_block = 1024;
+  // Enough blocks for every 32 bit id
+  static const std::size_t max_blocks = 23;
+  
+  std::mutex mutex;
+  std::atomic<std::string*> blocks[max_blocks];
+  std::atomic<std::size_t> count;
+  std::unordered_map<std::string, std::uint32_t> ids;
+  
+  host_table();
+  
+  static host_table& get();
+  
+  /**
+   * Find the block holding id and its place in it
+   */
+  static void locate(std::uint32_t id, std::size_t &block, 
+    std::size_t &offset);
+};
+
+/**
+ * A URL as an interned host, a scheme and a path kept in a shared arena,
+ * with its fingerprint. 32 bytes however long the host is, copies only 
+ * bump a reference count. Paths are stored in chunks that are freed once
+ * no URL uses them
+ */
+class compact_url
+{
+public:
+  /**
+   * The key a host is scheduled and tracked under, its scheme and host id
+   */
+  typedef std::uint64_t site_type;
+  
+  compact_url();
+  
+  /**
+   * @param protocol http or https
+   * @param host host[:port] as stored in the database
+   */
+  compact_url(
+    const std::string &protocol, 
+    const std::string &host, 
+    boost::string_ref path);
+  
+  compact_url(const compact_url &other);
+  
+  compact_url(compact_url &&other);
+  
+  compact_url& operator=(compact_url other);
+  
+  ~compact_url();
+  
+  Scheme get_scheme() const { return scheme; }
+  
+  const std::string& get_protocol() const;
+  
+  std::uint32_t get_host_id() const { return host; }
+  
+  const std::string& get_host() const { return host_table::name(host); }
+  
+  boost::string_ref get_path() const;
+  
+  std::uint64_t get_fingerprint() const { return fp; }
+  
+  site_type get_site() const 
+  { 
+    return make_site(scheme, host); 
+  }
+  
+  /**
+   * @return protocol://host/path
+   */
+  std::string to_string() const;
+  
+  static site_type make_site(Scheme scheme, std::uint32_t host)
+  {
+    return (static_cast<site_type>(scheme) << 32) | host;
+  }
+  
+  static site_type make_site(const std::string &protocol, 
+    const std::string &host);
+  
+  /**
+   * @return protocol://host of a site
+   */
+  static std::string site_name(site_type site);
+  
+  /**
+   * @return A 64 bit fingerprint of a URL, the same in every run
+   */
+  static std::uint64_t fingerprint(
+    boost::string_ref protocol,
+    boost::string_ref host,
+    boost::string_ref path);
+  
+  /**
+   * @return Bytes held by path chunks still in use
+   */
+  static std::size_t arena_bytes();
+  
+private:
+  struct chunk;
+  
+  // The chunk new paths go into, the arena holds a reference to it
+  static std::mutex arena_mutex;
+  static chunk *current;
+  static std::atomic<std::size_t> arena_total;
+  
+  chunk *block = nullptr;
+  std::uint32_t offset = 0;
+  std::uint32_t length = 0;
+  std::uint32_t host = 0;
+  Scheme scheme = Scheme::HTTP;
+  std::uint64_t fp = 0;
+  
+  static Scheme to_scheme(const std::string &protocol);
+  
+  /**
+   * Copy a path into the current chunk, starting a new one when it is full
+   */
+  void store_path(boost::string_ref path);
+  
+  void release();
+};
+
+#endif
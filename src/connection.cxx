@@ -0,0 +1,56 @@
+/*
+ * WebCrawler: connection.cxx
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file connection.cxx
+ * @author Kyle Givler
+ */
+
+#include "connection.hpp"
+
+connection::connection(
+  asio::io_service &io_service,
+  asio::ssl::context &sslctx,
+  std::string key,
+  bool ssl)
+  : socket(io_service),
+    ssl_sock(socket, sslctx),
+    key(key),
+    ssl(ssl)
+{
+}
+
+connection::~connection()
+{
+  close();
+}
+
+void connection::close()
+{
+  // OpenSSL stops offering a session whose connection is freed without
+  // a shutdown, mark it shut down so tls_session_cache can resume it
+  if(ssl)
+    SSL_set_shutdown(ssl_sock.native_handle(), SSL_SENT_SHUTDOWN);
+  
+  system::error_code ec;
+  if(socket.is_open())
+  {
+    socket.shutdown(tcp::socket::shutdown_both, ec);
+    socket.close(ec);
+  }
+}
@@ -0,0 +1,149 @@
+/*
+ * WebCrawler: connection.hpp
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file connection.hpp
+ * @author Kyle Givler
+ */
+
+#ifndef _WC_CONNECTION_H_
+#define _WC_CONNECTION_H_
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <memory>
+#include <string>
+
+using boost::asio::ip::tcp;
+using namespace boost;
+
+/**
+ * One TCP (and optionally TLS) connection to a server
+ * Outlives a single http_client request so it can be kept alive
+ */
+class connection
+{
+public:
+  connection(asio::io_service &io_service,
+    asio::ssl::context &sslctx,
+    std::string key,
+    bool ssl);
+  
+  virtual ~connection();
+  
+  /**
+   * @return The plain socket, also the lowest layer of the ssl stream
+   */
+  tcp::socket& get_socket() { return this->socket; }
+  
+  /**
+   * @return The ssl stream wrapping the socket
+   */
+  asio::ssl::stream<tcp::socket&>& get_ssl_stream() { return this->ssl_sock; }
+  
+  /**
+   * @return The connection_cache key (protocol, host, port) of this connection
+   */
+  std::string get_key() const { return this->key; }
+  
+  /**
+   * @return true if reads and writes go through TLS
+   */
+  bool is_ssl() const { return this->ssl; }
+  
+  /**
+   * @return true if the socket is open
+   */
+  bool is_open() const { return this->socket.is_open(); }
+  
+  /**
+   * Close the socket, errors are ignored
+   */
+  void close();
+  
+  /**
+   * @return Number of requests sent over this connection
+   */
+  std::size_t get_requests() const { return this->requests; }
+  
+  /**
+   * Count another request sent over this connection
+   */
+  void add_request() { this->requests++; }
+  
+  /**
+   * @return When the connection was last returned to the cache
+   */
+  posix_time::ptime get_idle_since() const { return this->idle_since; }
+  
+  /**
+   * @param time When the connection was returned to the cache
+   */
+  void set_idle_since(posix_time::ptime time) { this->idle_since = time; }
+  
+  template<typename Handler>
+  void async_write(asio::streambuf &buf, Handler handler)
+  {
+    if(ssl)
+      asio::async_write(ssl_sock, buf, handler);
+    else
+      asio::async_write(socket, buf, handler);
+  }
+  
+  template<typename Handler>
+  void async_read_until(asio::streambuf &buf, const std::string &delim,
+    Handler handler)
+  {
+    if(ssl)
+      asio::async_read_until(ssl_sock, buf, delim, handler);
+    else
+      asio::async_read_until(socket, buf, delim, handler);
+  }
+  
+  template<typename Handler>
+  void async_read_some(asio::mutable_buffers_1 buf, Handler handler)
+  {
+    if(ssl)
+      ssl_sock.async_read_some(buf, handler);
+    else
+      socket.async_read_some(buf, handler);
+  }
+  
+  template<typename CompletionCondition, typename Handler>
+  void async_read(asio::streambuf &buf, CompletionCondition condition,
+    Handler handler)
+  {
+    if(ssl)
+      asio::async_read(ssl_sock, buf, condition, handler);
+    else
+      asio::async_read(socket, buf, condition, handler);
+  }
+  
+private:
+  tcp::socket socket;
+  asio::ssl::stream<tcp::socket&> ssl_sock;
+  std::string key;
+  bool ssl;
+  std::size_t requests = 0;
+  posix_time::ptime idle_since;
+};
+
+typedef std::shared_ptr<connection> connection_ptr;
+
+#endif
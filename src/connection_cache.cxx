@@ -0,0 +1,131 @@
+/*
+ * WebCrawler: connection_cache.cxx
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file connection_cache.cxx
+ * @author Kyle Givler
+ */
+
+#include "connection_cache.hpp"
+#include <boost/bind.hpp>
+
+connection_cache::connection_cache(asio::io_service &io_service, 
+  std::size_t max_idle, long idle_timeout)
+  : max_idle(max_idle),
+    idle_timeout(posix_time::seconds(idle_timeout)),
+    idle_timer(io_service),
+    logger("connection_cache")
+{
+}
+
+connection_cache::~connection_cache()
+{
+  clear();
+}
+
+connection_ptr connection_cache::acquire(std::string key)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  evict_expired();
+  
+  for(auto it = idle.rbegin(); it != idle.rend(); ++it)
+  {
+    if((*it)->get_key() == key)
+    {
+      connection_ptr conn = *it;
+      idle.erase(std::next(it).base());
+      hits++;
+      logger.trace("Reusing connection: " + key);
+      return conn;
+    }
+  }
+  
+  misses++;
+  return connection_ptr();
+}
+
+void connection_cache::release(connection_ptr conn)
+{
+  if(!conn || !conn->is_open())
+    return;
+  
+  std::lock_guard<std::mutex> lock(mutex);
+  conn->set_idle_since(posix_time::microsec_clock::universal_time());
+  idle.push_back(conn);
+  
+  while(idle.size() > max_idle)
+  {
+    logger.trace("Cache full, closing: " + idle.front()->get_key());
+    idle.front()->close();
+    idle.pop_front();
+  }
+  evict_expired();
+  arm_idle_timer();
+}
+
+void connection_cache::clear()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  for(auto &conn : idle)
+    conn->close();
+  idle.clear();
+  
+  system::error_code ec;
+  idle_timer.cancel(ec);
+  timer_armed = false;
+}
+
+std::size_t connection_cache::size()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return idle.size();
+}
+
+void connection_cache::evict_expired()
+{
+  posix_time::ptime now = posix_time::microsec_clock::universal_time();
+  while(!idle.empty() && now - idle.front()->get_idle_since() > idle_timeout)
+  {
+    logger.trace("Idle timeout, closing: " + idle.front()->get_key());
+    idle.front()->close();
+    idle.pop_front();
+  }
+}
+
+void connection_cache::arm_idle_timer()
+{
+  if(timer_armed || idle.empty())
+    return;
+  
+  timer_armed = true;
+  idle_timer.expires_at(idle.front()->get_idle_since() + idle_timeout);
+  idle_timer.async_wait(bind(&connection_cache::handle_idle_timer, this, 
+    asio::placeholders::error));
+}
+
+void connection_cache::handle_idle_timer(const system::error_code &err)
+{
+  // clear() or a newer wait took over
+  if(err == asio::error::operation_aborted)
+    return;
+  
+  std::lock_guard<std::mutex> lock(mutex);
+  timer_armed = false;
+  evict_expired();
+  arm_idle_timer();
+}
@@ -0,0 +1,120 @@
+/*
+ * WebCrawler: connection_cache.hpp
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file connection_cache.hpp
+ * @author Kyle Givler
+ */
+
+#ifndef _WC_CONNECTION_CACHE_H_
+#define _WC_CONNECTION_CACHE_H_
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "connection.hpp"
+#include "logger/logger.hpp"
+
+/**
+ * Idle keep-alive connections shared by all http_clients
+ * Keyed by (protocol, host, port), thread safe. A timer closes idle 
+ * connections once they time out, so servers are not left holding them
+ */
+class connection_cache
+{
+public:
+  /**
+   * @param io_service Runs the idle timeout timer
+   * @param max_idle Most idle connections kept, the oldest are closed first
+   * @param idle_timeout Seconds an idle connection is kept before closing
+   */
+  connection_cache(asio::io_service &io_service, std::size_t max_idle = 64, 
+    long idle_timeout = 15);
+  
+  virtual ~connection_cache();
+  
+  /**
+   * @return The key for a (protocol, host, port) triple
+   */
+  static std::string make_key(
+    std::string protocol,
+    std::string host,
+    unsigned int port)
+  {
+    return protocol + "://" + host + ":" + std::to_string(port);
+  }
+  
+  /**
+   * Take an idle connection out of the cache
+   * @param key The key returned by make_key()
+   * @return The most recently used idle connection, or nullptr
+   */
+  connection_ptr acquire(std::string key);
+  
+  /**
+   * Return a connection that finished a response and may be reused
+   */
+  void release(connection_ptr conn);
+  
+  /**
+   * Close every idle connection and stop the timer
+   */
+  void clear();
+  
+  /**
+   * @return Number of idle connections
+   */
+  std::size_t size();
+  
+  /**
+   * @return Number of acquire() calls that found a connection
+   */
+  std::size_t get_hits() const { return this->hits; }
+  
+  /**
+   * @return Number of acquire() calls that did not
+   */
+  std::size_t get_misses() const { return this->misses; }
+
+private:
+  std::list<connection_ptr> idle; // Oldest first
+  std::mutex mutex;
+  std::size_t max_idle;
+  posix_time::time_duration idle_timeout;
+  asio::deadline_timer idle_timer;
+  bool timer_armed = false;
+  std::size_t hits = 0;
+  std::size_t misses = 0;
+  Logger logger;
+  
+  /**
+   * Close connections idle past the timeout, call with the mutex held
+   */
+  void evict_expired();
+  
+  /**
+   * Wake when the oldest idle connection times out, if the timer is not 
+   * already waiting. Call with the mutex held
+   */
+  void arm_idle_timer();
+  
+  void handle_idle_timer(const system::error_code &err);
+};
+
+#endif
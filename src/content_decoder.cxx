@@ -0,0 +1,279 @@
+/*
+ * WebCrawler: content_decoder.cxx
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file content_decoder.cxx
+ * @author Kyle Givler
+ */
+
+#include "content_decoder.hpp"
+#include <boost/algorithm/string/case_conv.hpp>
+#include <boost/algorithm/string/trim.hpp>
+#include <cstring>
+
+content_decoder::content_decoder()
+{
+  std::memset(&zs, 0, sizeof(zs));
+}
+
+content_decoder::~content_decoder()
+{
+  end_streams();
+}
+
+std::string content_decoder::accept_encoding()
+{
+#ifdef HAVE_BROTLI
+  return "gzip, deflate, br";
+#else
+  return "gzip, deflate";
+#endif
+}
+
+bool content_decoder::reset(
+  std::string encoding, 
+  body_sink *next, 
+  std::size_t max_size)
+{
+  end_streams();
+  this->next = next;
+  this->max_size = max_size;
+  this->wire_bytes = 0;
+  this->decoded_bytes = 0;
+  this->error.clear();
+  this->stream_end = false;
+  this->deflate_head.clear();
+  this->encoding = ContentEncoding::IDENTITY;
+  
+  boost::to_lower(encoding);
+  boost::algorithm::trim(encoding);
+  
+  if(encoding.empty() || encoding == "identity")
+    return true;
+  
+  if(encoding == "gzip" || encoding == "x-gzip")
+  {
+    this->encoding = ContentEncoding::GZIP;
+    return init_zlib(15 + 16);
+  }
+  
+  if(encoding == "deflate")
+  { // zlib or raw deflate is decided once the first two bytes arrive
+    this->encoding = ContentEncoding::DEFLATE;
+    return true;
+  }
+  
+#ifdef HAVE_BROTLI
+  if(encoding == "br")
+  {
+    this->encoding = ContentEncoding::BROTLI;
+    brotli = BrotliDecoderCreateInstance(0, 0, 0);
+    return brotli != nullptr;
+  }
+#endif
+  
+  return false;
+}
+
+void content_decoder::append_body(const char *data, std::size_t size)
+{
+  if(has_error() || size == 0)
+    return;
+  
+  wire_bytes += size;
+  
+  switch(encoding)
+  {
+    case ContentEncoding::GZIP:
+      inflate_data(data, size);
+      break;
+    case ContentEncoding::DEFLATE:
+      deflate_data(data, size);
+      break;
+#ifdef HAVE_BROTLI
+    case ContentEncoding::BROTLI:
+      brotli_data(data, size);
+      break;
+#endif
+    default:
+      emit(data, size);
+  }
+}
+
+void content_decoder::finish()
+{
+  if(has_error() || wire_bytes == 0)
+    return;
+  
+  if(encoding != ContentEncoding::IDENTITY && !stream_end)
+    fail("Compressed body ended early");
+}
+
+void content_decoder::end_streams()
+{
+  if(zs_init)
+  {
+    inflateEnd(&zs);
+    zs_init = false;
+  }
+  
+#ifdef HAVE_BROTLI
+  if(brotli)
+  {
+    BrotliDecoderDestroyInstance(brotli);
+    brotli = nullptr;
+  }
+#endif
+}
+
+bool content_decoder::init_zlib(int window_bits)
+{
+  if(zs_init)
+    inflateEnd(&zs);
+  
+  std::memset(&zs, 0, sizeof(zs));
+  zs_init = (inflateInit2(&zs, window_bits) == Z_OK);
+  return zs_init;
+}
+
+void content_decoder::deflate_data(const char *data, std::size_t size)
+{
+  if(zs_init)
+  {
+    inflate_data(data, size);
+    return;
+  }
+  
+  // Many servers send raw deflate without the zlib header, look at the
+  // header bytes before picking a window
+  deflate_head.append(data, size);
+  if(deflate_head.size() < 2)
+    return;
+  
+  unsigned char cmf = deflate_head[0];
+  unsigned char flg = deflate_head[1];
+  bool zlib_header = (cmf & 0x0f) == 8 && (cmf * 256 + flg) % 31 == 0;
+  
+  if(!init_zlib(zlib_header ? 15 : -15))
+  {
+    fail("inflateInit failed");
+    return;
+  }
+  
+  std::string head;
+  head.swap(deflate_head);
+  inflate_data(head.data(), head.size());
+}
+
+void content_decoder::inflate_data(const char *data, std::size_t size)
+{
+  char out[16384];
+  
+  zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+  zs.avail_in = size;
+  
+  while(!has_error())
+  {
+    if(stream_end)
+    {
+      if(zs.avail_in == 0 || encoding != ContentEncoding::GZIP)
+        return; // Done, or trailing garbage after a deflate stream
+      inflateReset(&zs); // Concatenated gzip members
+      stream_end = false;
+    }
+    
+    zs.next_out = reinterpret_cast<Bytef*>(out);
+    zs.avail_out = sizeof(out);
+    
+    int rc = inflate(&zs, Z_NO_FLUSH);
+    std::size_t produced = sizeof(out) - zs.avail_out;
+    
+    if(rc != Z_OK && rc != Z_STREAM_END && rc != Z_BUF_ERROR)
+    {
+      fail(std::string("inflate: ") + (zs.msg ? zs.msg : "error"));
+      return;
+    }
+    
+    emit(out, produced);
+    
+    if(rc == Z_STREAM_END)
+      stream_end = true;
+    else if(rc == Z_BUF_ERROR || (zs.avail_in == 0 && zs.avail_out != 0))
+      return; // Needs more input
+  }
+}
+
+#ifdef HAVE_BROTLI
+void content_decoder::brotli_data(const char *data, std::size_t size)
+{
+  uint8_t out[16384];
+  const uint8_t *next_in = reinterpret_cast<const uint8_t*>(data);
+  std::size_t avail_in = size;
+  
+  while(!has_error())
+  {
+    uint8_t *next_out = out;
+    std::size_t avail_out = sizeof(out);
+    
+    BrotliDecoderResult rc = BrotliDecoderDecompressStream(brotli, 
+      &avail_in, &next_in, &avail_out, &next_out, 0);
+    
+    emit(reinterpret_cast<const char*>(out), sizeof(out) - avail_out);
+    if(has_error())
+      return;
+    
+    if(rc == BROTLI_DECODER_RESULT_ERROR)
+    {
+      fail(std::string("brotli: ") + BrotliDecoderErrorString(
+        BrotliDecoderGetErrorCode(brotli)));
+      return;
+    }
+    
+    if(rc == BROTLI_DECODER_RESULT_SUCCESS)
+    {
+      stream_end = true;
+      return;
+    }
+    
+    if(rc == BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT)
+      return;
+    // NEEDS_MORE_OUTPUT: loop with a fresh buffer
+  }
+}
+#endif
+
+void content_decoder::emit(const char *data, std::size_t size)
+{
+  if(size == 0)
+    return;
+  
+  if(decoded_bytes + size > max_size)
+  {
+    fail("Decoded body larger than " + std::to_string(max_size) + " bytes");
+    return;
+  }
+  
+  decoded_bytes += size;
+  next->append_body(data, size);
+}
+
+void content_decoder::fail(std::string message)
+{
+  error = message;
+  end_streams();
+}
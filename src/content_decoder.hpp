@@ -0,0 +1,140 @@
+/*
+ * WebCrawler: content_decoder.hpp
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file content_decoder.hpp
+ * @author Kyle Givler
+ */
+
+#ifndef _WC_CONTENT_DECODER_H_
+#define _WC_CONTENT_DECODER_H_
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string>
+#include <zlib.h>
+#include "body_sink.hpp"
+
+#ifdef HAVE_BROTLI
+#include <brotli/decode.h>
+#endif
+
+enum class ContentEncoding { IDENTITY, GZIP, DEFLATE, BROTLI };
+
+/**
+ * Streaming Content-Encoding decoder
+ * Sits between the http_body_decoder and the request, decompressing each
+ * piece of the body as it arrives and enforcing a limit on decoded size
+ */
+class content_decoder : public body_sink
+{
+public:
+  content_decoder();
+  
+  virtual ~content_decoder();
+  
+  /**
+   * @return Value for the Accept-Encoding request header
+   */
+  static std::string accept_encoding();
+  
+  /**
+   * Start decoding a new body
+   * @param encoding The Content-Encoding header, empty for none
+   * @param next Where decoded bytes go
+   * @param max_size Most decoded bytes accepted before failing
+   * @return false if the encoding isn't supported, the body is passed
+   * through unchanged
+   */
+  bool reset(std::string encoding, body_sink *next, std::size_t max_size);
+  
+  /**
+   * Decode the next piece of the body
+   */
+  void append_body(const char *data, std::size_t size);
+  
+  /**
+   * The body is complete, check the compressed stream ended
+   */
+  void finish();
+  
+  /**
+   * @return The encoding being decoded, IDENTITY passes bytes through
+   */
+  ContentEncoding get_encoding() const { return this->encoding; }
+  
+  /**
+   * @return true if the body couldn't be decoded or was too large
+   */
+  bool has_error() const { return !this->error.empty(); }
+  
+  /**
+   * @return Description of the error
+   */
+  std::string get_error() const { return this->error; }
+  
+  /**
+   * @return Bytes of encoded body received
+   */
+  std::size_t get_wire_bytes() const { return this->wire_bytes; }
+  
+  /**
+   * @return Bytes of decoded body passed on
+   */
+  std::size_t get_decoded_bytes() const { return this->decoded_bytes; }
+
+private:
+  ContentEncoding encoding = ContentEncoding::IDENTITY;
+  body_sink *next = nullptr;
+  std::size_t max_size = 0;
+  std::size_t wire_bytes = 0;
+  std::size_t decoded_bytes = 0;
+  std::string error;
+  bool stream_end = false;
+  
+  z_stream zs;
+  bool zs_init = false;
+  std::string deflate_head;
+  
+#ifdef HAVE_BROTLI
+  BrotliDecoderState *brotli = nullptr;
+#endif
+  
+  void end_streams();
+  
+  bool init_zlib(int window_bits);
+  
+  void deflate_data(const char *data, std::size_t size);
+  
+  void inflate_data(const char *data, std::size_t size);
+  
+#ifdef HAVE_BROTLI
+  void brotli_data(const char *data, std::size_t size);
+#endif
+
+  /**
+   * Pass decoded bytes on, failing once max_size is exceeded
+   */
+  void emit(const char *data, std::size_t size);
+  
+  void fail(std::string message);
+};
+
+#endif
@@ -25,21 +25,42 @@
  
 #include "crawler.hpp"
 #include "robot_parser.hpp"
+#include "crawlerException.hpp"
 #include <boost/bind.hpp>
-#include <gumbo.h>
 #include <iostream>
 #include <csignal>
 
-Crawler::Crawler(boost::asio::io_service &io_service)
-  : client(io_service),
+Crawler::Crawler(boost::asio::io_service &io_service,
+  crawler_options options)
+  : options(options),
+    connections(io_service, options.max_idle_connections, 
+      options.idle_timeout),
+    dns(io_service, options.dns_ttl, options.dns_negative_ttl),
+    robots(options.robots_cache_size),
+    queue(options.host_delay, options.max_per_host),
+    queue_timer(io_service),
     signals(io_service),
     strand(io_service),
     io_service(io_service),
-    db(new sqlite("test.db")),
+    db(new write_behind(open_database(options), options.write_batch,
+      options.write_interval)),
+    reader_work(new asio::io_service::work(reader)),
+    reader_thread(boost::bind(&asio::io_service::run, &reader)),
+    parser(options.parse_threads, options.max_parse_queue),
     logger("Crawler")
 {
   logger.setIgnoreLevel(Level::NONE);
   
+  if(this->options.max_clients == 0)
+    this->options.max_clients = 1;
+  
+  for(std::size_t i = 0; i < this->options.max_clients; i++)
+  {
+    clients.push_back(std::unique_ptr<http_client>(new http_client(io_service,
+      connections, dns, tls, this->options.max_body_size)));
+    idle_clients.push_back(clients.back().get());
+  }
+  
   signals.add(SIGINT);
   signals.add(SIGTERM);
   #ifdef SIGQUIT
@@ -50,6 +71,8 @@ Crawler::Crawler(boost::asio::io_service &io_service)
  
 Crawler::~Crawler()
 {
+  stop_reader();
+  parser.stop();
   db->close_db();
   delete(db);
 }
@@ -59,25 +82,38 @@ void Crawler::receive_http_request(http_request *r)
   logger.trace("Recived completed request: " + r->get_protocol() + "://"
     + r->get_server() + r->get_path() );
 
+  strand.post(bind(&Crawler::dispatch_request, this, r));
+}
+
+void Crawler::dispatch_request(http_request *r)
+{
+  // Parsing and database writes run on the host's strand so a slow page
+  // only holds up its own host, not the crawler or the other sockets
+  asio::strand &host = host_strand(r);
+  
   if (r->get_request_type() == RequestType::ROBOT_GET)
   {
-    //handle_recived_robots(r);
-    strand.post(bind(&Crawler::handle_recived_robots, this, r));
+    host.post(bind(&Crawler::handle_recived_robots, this, r));
     return;
   }
   
   if (r->get_request_type() == RequestType::HEAD ||
       r->get_request_type() == RequestType::ROBOT_HEAD)
   {
-    //handle_recived_head(r);
-    strand.post(bind(&Crawler::handle_recived_head, this, r));
+    host.post(bind(&Crawler::handle_recived_head, this, r));
     return;
   }
   
   if(r->get_request_type() == RequestType::GET)
   {
-    strand.post(bind(&Crawler::handle_recived_get, this, r));
-    //handle_recived_get(r);
+    // The page is fetched, parsing it must not hold up the next fetch
+    free_client(r);
+    if(r->get_data().size() != 0 && !r->should_blacklist())
+      parser.post(r, host.wrap(bind(&Crawler::handle_recived_get, this, 
+        _1, _2)));
+    else
+      host.post(bind(&Crawler::handle_recived_get, this, r, 
+        std::vector<std::string>()));
     return;
   }
   
@@ -86,6 +122,11 @@ void Crawler::receive_http_request(http_request *r)
   exit(1);
 }
 
+asio::strand& Crawler::host_strand(http_request *r)
+{
+  return *host_strands[r->get_orignial_settings().get_site()].first;
+}
+
 ////////////////////////////////////////////////////////////////////////
 
 void Crawler::handle_recived_robots(http_request *request)
@@ -96,17 +137,82 @@ void Crawler::handle_recived_robots(http_request *request)
   if(request->get_timed_out())
     timed_out = true;
   
-  rp.process_robots(request->get_server(), request->get_protocol(),
-      request->get_data(), timed_out, db);
+  robot_rules_ptr rules = rp.process_robots(request->get_server(), 
+    request->get_protocol(), request->get_data().to_string(), timed_out, 
+    db);
   
-  logger.trace("handle_recived_robots: deleting pointer");
-  delete(request);
-  pDeleted++;
-  
-  //prepare_next_request();
-  strand.post(bind(&Crawler::prepare_next_request, this));
+  strand.post(bind(&Crawler::handle_robots_processed, this, request, 
+    rules));
   return;
 }
+
+void Crawler::handle_robots_processed(
+  http_request *request, 
+  robot_rules_ptr rules)
+{
+  // Links held back while robots.txt was fetched can go out now
+  key_type key = request->get_orignial_settings().get_site();
+  
+  robots_checked.insert(key);
+  use_robots(key, rules);
+  
+  std::size_t dropped = queue.drop_if(key, [this](const link &l) { 
+    return !robots_allow(l, true); });
+  if(dropped)
+    logger.debug("robots.txt disallows " + std::to_string(dropped) + 
+      " queued links for " + compact_url::site_name(key));
+  
+  queue.unhold(key);
+  
+  logger.trace("handle_recived_robots: releasing request");
+  release_request(request);
+}
+
+void Crawler::use_robots(key_type key, robot_rules_ptr rules)
+{
+  robots.put(key, rules);
+  
+  double crawl_delay = rules->get_crawl_delay();
+  if(crawl_delay > 0)
+    queue.set_delay(key, std::max(options.host_delay, 
+      std::min(crawl_delay, options.max_crawl_delay)));
+}
+
+robot_rules_ptr Crawler::host_robots(const link &l)
+{
+  key_type key = l.get_site();
+  robot_rules_ptr rules = robots.get(key);
+  if(rules)
+  { // The frontier forgets a host's Crawl-delay once it goes idle
+    use_robots(key, rules);
+    return rules;
+  }
+  
+  // Processed in an earlier run, or pushed out of the cache
+  rules = std::make_shared<robot_rules>(db->get_robots(l.get_host(), 
+    l.get_protocol()), robot_parser::agent);
+  use_robots(key, rules);
+  return rules;
+}
+
+bool Crawler::robots_allow(const link &l, bool known_only)
+{
+  key_type key = l.get_site();
+  
+  robot_rules_ptr rules;
+  if(known_only)
+    rules = robots.get(key);
+  else if(robots_checked.count(key))
+    rules = host_robots(l);
+  
+  std::string path = l.get_path().to_string();
+  if(!rules || rules->allowed(path))
+    return true;
+  
+  logger.debug("robots.txt disallows: " + l.to_string());
+  db->blacklist(l, "robots.txt");
+  return false;
+}
   
 void Crawler::handle_recived_head(http_request *r)
 {
@@ -133,48 +239,36 @@ void Crawler::handle_recived_head(http_request *r)
     db->blacklist(r->get_server(), r->get_path(), r->get_protocol(),
       "Timedout");
       
-  logger.trace("Deleting pointer becasue not HTML");
-  delete(r);
-  pDeleted++;
-  //prepare_next_request();
-  strand.post(bind(&Crawler::prepare_next_request, this));
-  
+  logger.trace("Releasing request becasue not HTML");
+  strand.post(bind(&Crawler::release_request, this, r));
   return;
 }
   
-void Crawler::handle_recived_get(http_request *r)
+void Crawler::handle_recived_get(
+  http_request *r, 
+  std::vector<std::string> links)
 {
   if(r->should_blacklist())
     db->blacklist(r->get_server(), r->get_path(), r->get_protocol(),
       r->get_blacklist_reason());
 
-  if(r->get_data().size() != 0)
-    db->add_links(r->get_links());
+  if(!links.empty())
+    db->add_links(links);
   
   if(!r->get_timed_out())
   {
     r->set_status_code(-1);
   }
   
+  // A redirected request is stored as the link it was queued as, not
+  // where it ended up
   if(r->get_redirected())
-  {
     logger.trace("Handeling redirected request");
-    auto settings =  r->get_orignial_settings();
-    db->set_visited(std::get<0>(settings), std::get<1>(settings), 
-    std::get<1>(settings), r->get_status_code());
-  } else {
-    db->set_visited(r->get_server(), r->get_path(), r->get_protocol(),
-      r->get_status_code());
-  }
+  db->set_visited(r->get_orignial_settings(), r->get_status_code());
 
     
-  logger.trace("Get: Deleting request, no longer needed");
-  delete(r);
-  pDeleted++;
-  
-  //prepare_next_request();
-  strand.post(bind(&Crawler::prepare_next_request, this));
-  
+  logger.trace("Get: Releasing request, no longer needed");
+  strand.post(bind(&Crawler::release_request, this, r));
   return;
 }
 
@@ -183,62 +277,226 @@ void Crawler::handle_recived_get(http_request *r)
 void Crawler::prepare_next_request()
 {
   logger.trace("Preparing next request: Queue size: " +
-    std::to_string(request_queue.size()));
+    std::to_string(queue.size()) + " hosts: " + 
+    std::to_string(queue.host_count()) + " in flight: " +
+    std::to_string(in_flight.size()));
+  
+  logger.trace("Requests: created: " + 
+    std::to_string(requests.get_created()) + 
+    " reused: " + std::to_string(requests.get_reused()) + 
+    " in use: " + std::to_string(requests.get_in_use()) + 
+    " free: " + std::to_string(requests.get_free()));
+  
+  logger.trace("Body bytes: wire: " + std::to_string(wire_bytes) +
+    " decoded: " + std::to_string(decoded_bytes) + 
+    " copied: " + std::to_string(copied_bytes));
+  
+  buffer_pool &pool = buffer_pool::get();
+  logger.trace("Body blocks: allocated: " + 
+    std::to_string(pool.get_allocated()) + 
+    " in use: " + std::to_string(pool.get_in_use()) + 
+    " free: " + std::to_string(pool.get_free()));
+  
+  logger.trace("DNS: hits: " + std::to_string(dns.get_hits()) + 
+    " misses: " + std::to_string(dns.get_misses()) + 
+    " coalesced: " + std::to_string(dns.get_coalesced()));
+  
+  logger.trace("TLS: handshakes: " + std::to_string(tls.get_handshakes()) + 
+    " resumed: " + std::to_string(tls.get_resumed()));
   
-  logger.trace("Pointers: created: " + std::to_string(pCreated) + 
-    " deleted: " + std::to_string(pDeleted));
+  logger.trace("Parse: queued: " + std::to_string(parser.get_depth()) + 
+    " max: " + std::to_string(parser.get_max_depth()) + 
+    " parsed: " + std::to_string(parser.get_parsed()) + 
+    " mean wait: " + std::to_string(parser.get_mean_wait()) + "us" +
+    " mean parse: " + std::to_string(parser.get_mean_parse()) + "us" +
+    " max parse: " + std::to_string(parser.get_max_parse()) + "us");
   
-  if(!request_queue.empty())
+  link t_request;
+  posix_time::ptime now = posix_time::microsec_clock::universal_time();
+  // While parsing is behind, fetching waits, release_request() of each 
+  // parsed page calls back here. Every fetch in flight may become a page
+  // to parse, so they count too and the queue never grows past its bound
+  while(!idle_clients.empty() && !parse_queue_full() && 
+    queue.pop(t_request, now))
   {
-    auto t_request = request_queue.front();
-    std::string domain = std::get<0>(t_request);
-    std::string path = std::get<1>(t_request);
-    std::string protocol = std::get<2>(t_request);
+    key_type key = t_request.get_site();
     
-    logger.trace("Creating pointer with: " + domain + " " + path + " "
-      + protocol);
-      
-    http_request *request = new http_request(*this, domain, path,
-      protocol);
-    pCreated++;
-    request->set_request_type(RequestType::HEAD);
+    bool fetch_robots = false;
+    if(robots_checked.count(key) == 0)
+    {
+      if(db->should_process_robots(t_request.get_host(), 
+        t_request.get_protocol()))
+        fetch_robots = true;
+      else
+        robots_checked.insert(key);
+    }
     
-    if(db->should_process_robots(domain, protocol))
+    if(!fetch_robots && !robots_allow(t_request, false))
     {
+      queue.finish(key);
+      continue;
+    }
+    
+    logger.trace("Requesting: " + t_request.to_string());
+      
+    http_request *request = requests.acquire(*this, t_request);
+    request->set_request_type(options.head_first ? 
+      RequestType::HEAD : RequestType::GET);
+    
+    if(fetch_robots)
+    { // Hold the host's links until robots.txt is processed
+      queue.push_front(t_request);
+      queue.hold(key);
       request->set_path("/robots.txt");
-      request->set_request_type(RequestType::ROBOT_HEAD);
-    } else {
-      request_queue.pop_front();
+      request->set_request_type(options.head_first ? 
+        RequestType::ROBOT_HEAD : RequestType::ROBOT_GET);
     }
-    strand.post(bind(&Crawler::do_request, this, request));
     
-  } else {
-    std::cout << "Queue is empty, quiting\n";
-    db->close_db();
-    exit(0);
+    in_flight[request] = idle_clients.back();
+    idle_clients.pop_back();
+    
+    auto &host = host_strands[key];
+    if(!host.first)
+      host.first.reset(new asio::strand(io_service));
+    host.second++;
+    strand.post(bind(&Crawler::do_request, this, request));
+  }
+  
+  start_refill();
+  
+  if(in_flight.empty() && queue.empty() && !refilling && refill_drained)
+  {
+    finish();
+    return;
+  }
+  
+  // A full parser is not waiting on a host, the timer would fire at once 
+  // and spin here until release_request() frees a slot
+  if(!idle_clients.empty() && !parse_queue_full())
+    arm_queue_timer();
+}
+
+void Crawler::start_refill()
+{
+  if(refilling || refill_drained || queue.size() >= options.refill_low_water)
+    return;
+  
+  refilling = true;
+  reader.post(bind(&Crawler::refill, this, refill_cursor));
+}
+
+void Crawler::refill(std::int64_t cursor)
+{
+  v_links links;
+  try
+  {
+    links = db->get_links(options.refill_batch, cursor);
+  } catch (std::exception &e) {
+    logger.error(std::string("Refill failed: ") + e.what());
+  }
+  strand.post(bind(&Crawler::handle_refill, this, links, cursor));
+}
+
+void Crawler::handle_refill(v_links links, std::int64_t cursor)
+{
+  logger.trace("Refilled: " + std::to_string(links.size()) + " links");
+  
+  refilling = false;
+  refill_cursor = cursor;
+  // Finished requests may add links after the end was reached, 
+  // release_request() clears this
+  refill_drained = links.empty();
+  
+  // Links of hosts whose rules are in memory are checked before they are
+  // queued, the rest when their host comes up
+  for(auto &link : links)
+    if(robots_allow(link, true))
+      queue.push(link);
+  
+  prepare_next_request();
+}
+
+void Crawler::arm_queue_timer()
+{
+  posix_time::ptime next = queue.next_ready();
+  if(next.is_not_a_date_time() || next == queue_timer_at)
+    return;
+  
+  queue_timer_at = next;
+  queue_timer.expires_at(next);
+  queue_timer.async_wait(strand.wrap(bind(&Crawler::handle_queue_timer, 
+    this, asio::placeholders::error)));
+}
+
+void Crawler::handle_queue_timer(const system::error_code &err)
+{
+  if(err == asio::error::operation_aborted)
+    return;
+  
+  queue_timer_at = posix_time::not_a_date_time;
+  prepare_next_request();
+}
+
+void Crawler::release_request(http_request *r)
+{
+  auto it = in_flight.find(r);
+  if(it != in_flight.end())
+  {
+    if(it->second)
+      idle_clients.push_back(it->second);
+    else
+      parsing--;
+    in_flight.erase(it);
   }
+  
+  key_type key = r->get_orignial_settings().get_site();
+  queue.finish(key);
+  
+  auto host = host_strands.find(key);
+  if(host != host_strands.end() && --host->second.second == 0)
+    host_strands.erase(host);
+  
+  // It may have added links past the end of the last refill
+  refill_drained = false;
+  
+  wire_bytes += r->get_wire_bytes();
+  decoded_bytes += r->get_data().size();
+  copied_bytes += r->get_data().get_copied();
+  
+  requests.release(r);
+  
+  strand.post(bind(&Crawler::prepare_next_request, this));
+}
+
+void Crawler::free_client(http_request *r)
+{
+  auto it = in_flight.find(r);
+  if(it == in_flight.end() || !it->second)
+    return;
+  
+  idle_clients.push_back(it->second);
+  it->second = nullptr;
+  parsing++;
+  strand.post(bind(&Crawler::prepare_next_request, this));
 }
 
 void Crawler::do_request(http_request *r)
 {
   logger.trace("Sending request to client: " + r->get_protocol() + "://"
     + r->get_server() + r->get_path());
-  strand.post(bind(&http_client::make_request, &client, r));
+  in_flight[r]->post_request(r);
   return;
 }
 
 void Crawler::start()
 {
-  auto links = db->get_links(100);
-  for(auto &link : links)
-    request_queue.push_back(link);
-
   //prepare_next_request();
   strand.post(bind(&Crawler::prepare_next_request, this));
 }
 
 
-bool Crawler::check_if_header_text_html(std::vector<std::string> headers)
+bool Crawler::check_if_header_text_html(
+  const std::vector<std::string> &headers)
 {
   for(auto &header : headers)
   {
@@ -260,44 +518,38 @@ bool Crawler::check_if_header_text_html(std::vector<std::string> headers)
 void Crawler::seed(std::string domain, std::string path)
 {
   db->add_link(domain + path);
+  db->close_db();
   std::cout << "Added seed to database\n";
   exit(0);
 }
 
-void Crawler::handle_stop()
+database* Crawler::open_database(const crawler_options &options)
 {
-  std::cerr << "\nCaught signal\n";
+  if(options.backend == "sqlite")
+    return new sqlite("test.db", options.storage);
+  if(options.backend == "log")
+    return new log_store("test.log", options.log_storage);
+  
+  throw(CrawlerException("Unknown backend: " + options.backend));
+}
+
+void Crawler::finish()
+{
+  std::cout << "Queue is empty, quiting\n";
+  connections.clear();
   io_service.stop();
-  db->close_db();
-  exit(0);
 }
 
-bool Crawler::check_if_html(std::string data)
+void Crawler::stop_reader()
 {
-  // This method currently isn't used anywhere
-  
-  bool is_html = false;
-  GumboOutput *output = gumbo_parse(data.c_str());
-  GumboNode *node = output->root;
-  
-  if(node->v.element.tag == GUMBO_TAG_HTML)
-   is_html = true;
-  
-  if(!is_html)
-  { // Pretty sure this should never be needed, but just in case
-    while(node->type == GUMBO_NODE_ELEMENT)
-    {
-      GumboVector *children = &node->v.element.children;
-      for(std::size_t i = 0; i < children->length; i++)
-        if(static_cast<GumboNode*>(children->data[i])->v.element.tag == GUMBO_TAG_HTML)
-        {
-          logger.warn("I guess it was needed!");
-          is_html = true;
-          break;
-        }
-    }
-  }
-  
-  gumbo_destroy_output(&kGumboDefaultOptions, output);
-  return is_html;
+  reader_work.reset();
+  if(reader_thread.joinable())
+    reader_thread.join();
+}
+
+void Crawler::handle_stop()
+{
+  std::cerr << "\nCaught signal\n";
+  connections.clear();
+  io_service.stop();
 }
@@ -26,18 +26,138 @@
 
 #include <boost/asio.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
-#include <deque>
+#include <boost/thread.hpp>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+#include "frontier.hpp"
+#include "robot_rules.hpp"
 #include "logger/logger.hpp"
 #include "sqlite.hpp"
+#include "log_store.hpp"
+#include "write_behind.hpp"
 #include "http_client.hpp"
+#include "parse_pool.hpp"
+#include "request_pool.hpp"
 #include "request_reciver.hpp"
 
 using namespace boost;
 
+/**
+ * Tunables for a crawl
+ */
+struct crawler_options
+{
+  /**
+   * Number of http_client slots, ie. requests kept in flight at once
+   */
+  std::size_t max_clients = 8;
+  
+  /**
+   * Most idle keep-alive connections kept open
+   */
+  std::size_t max_idle_connections = 64;
+  
+  /**
+   * Seconds a keep-alive connection may sit idle before it is closed
+   */
+  long idle_timeout = 15;
+  
+  /**
+   * Most decoded bytes accepted for one response body
+   */
+  std::size_t max_body_size = 16 * 1024 * 1024;
+  
+  /**
+   * Seconds a resolved host name is cached
+   */
+  long dns_ttl = 300;
+  
+  /**
+   * Seconds a failed host name lookup is cached
+   */
+  long dns_negative_ttl = 30;
+  
+  /**
+   * Threads that find the links of fetched pages
+   */
+  std::size_t parse_threads = 2;
+  
+  /**
+   * Most pages waiting to be parsed, fetches in flight count against it
+   * so it also limits the clients in use
+   */
+  std::size_t max_parse_queue = 64;
+  
+  /**
+   * Send a HEAD before each page GET to check the content type, instead of
+   * checking the headers of the GET itself
+   */
+  bool head_first = false;
+  
+  /**
+   * Seconds between the start of two requests to the same host
+   */
+  double host_delay = 1.0;
+  
+  /**
+   * Most requests in flight at once to the same host
+   */
+  std::size_t max_per_host = 2;
+  
+  /**
+   * Largest robots.txt Crawl-delay honoured, in seconds
+   */
+  double max_crawl_delay = 30;
+  
+  /**
+   * Most hosts whose compiled robots.txt rules are kept in memory
+   */
+  std::size_t robots_cache_size = 10000;
+  
+  /**
+   * Links are read from the database when fewer than this are queued
+   */
+  std::size_t refill_low_water = 200;
+  
+  /**
+   * Most links read from the database at once
+   */
+  std::size_t refill_batch = 500;
+  
+  /**
+   * Queued database writes that trigger a flush
+   */
+  std::size_t write_batch = 1000;
+  
+  /**
+   * Seconds a database write may be queued before it is flushed
+   */
+  double write_interval = 1.0;
+  
+  /**
+   * Where links are stored, "sqlite" for test.db or "log" for the 
+   * log_store test.log
+   */
+  std::string backend = "sqlite";
+  
+  /**
+   * Journal mode, reader connections and tuning for the sqlite database
+   */
+  sqlite_options storage;
+  
+  /**
+   * Compaction and buffering for the log store
+   */
+  log_store_options log_storage;
+};
+
 class Crawler : public request_reciver
 {
 public:
-  Crawler(boost::asio::io_service &io_service);
+  Crawler(boost::asio::io_service &io_service,
+    crawler_options options = crawler_options());
 
   virtual ~Crawler();
 
@@ -54,14 +174,7 @@ public:
    * @return true if html/text or false if the header wasn't sent
    */
   bool check_if_header_text_html(
-    std::vector<std::string> headers);
-  
-  /**
-   * Make the request, download contents, check if it has an <html> tag
-   * @param data The resource to check
-   * @return true if html, false otherwise
-   */
-  bool check_if_html(std::string data);
+    const std::vector<std::string> &headers);
   
   
   /**
@@ -73,31 +186,169 @@ public:
   
 
 private:
-  http_client client;
-  std::deque<std::tuple<std::string,std::string,std::string>> request_queue;
+  typedef frontier::link link;
+  typedef frontier::key_type key_type;
+
+  crawler_options options;
+  connection_cache connections;
+  dns_cache dns;
+  tls_session_cache tls;
+  std::vector<std::unique_ptr<http_client>> clients;
+  std::vector<http_client*> idle_clients;
+  // Pages being parsed have given their client back and map to null
+  std::map<http_request*, http_client*> in_flight;
+  // Entries of in_flight that map to null
+  std::size_t parsing = 0;
+  // Every request, in flight or not, is owned here
+  request_pool requests;
+  std::set<key_type> robots_checked;
+  robot_rules_cache robots;
+  std::map<key_type, std::pair<std::unique_ptr<asio::strand>, 
+    std::size_t>> host_strands;
+  frontier queue;
+  asio::deadline_timer queue_timer;
+  posix_time::ptime queue_timer_at;
+  std::int64_t refill_cursor = 0;
+  bool refilling = false;
+  bool refill_drained = false;
   asio::signal_set signals;
   asio::strand strand;
   asio::io_service &io_service;
   database *db;
+  // One thread reads refill batches, so a slow read never holds up an 
+  // I/O thread
+  asio::io_service reader;
+  std::unique_ptr<asio::io_service::work> reader_work;
+  boost::thread reader_thread;
+  parse_pool parser;
   Logger logger;
   
-  std::size_t pCreated=0;
-  std::size_t pDeleted=0;
+  std::size_t wire_bytes=0;
+  std::size_t decoded_bytes=0;
+  std::size_t copied_bytes=0;
   
   void do_request(http_request *request);
   
+  /**
+   * Hand a completed request to its host's strand
+   */
+  void dispatch_request(http_request *request);
+  
+  /**
+   * @return The strand serializing result processing for this request's host
+   */
+  asio::strand& host_strand(http_request *request);
+  
   void handle_recived_robots(http_request *request);
   
+  /**
+   * Drop the host's disallowed links, let the rest go out and release 
+   * the request
+   */
+  void handle_robots_processed(
+    http_request *request, 
+    robot_rules_ptr rules);
+  
+  /**
+   * Cache a host's rules and apply its Crawl-delay
+   */
+  void use_robots(key_type key, robot_rules_ptr rules);
+  
+  /**
+   * @return The rules of a host whose robots.txt was processed, compiled
+   *  from the database when they are not cached
+   */
+  robot_rules_ptr host_robots(const link &l);
+  
+  /**
+   * Check a link against its host's robots.txt, blacklisting it if it is
+   * disallowed. Hosts whose robots.txt is not processed yet are allowed, 
+   * their queue is filtered once it is
+   * @param known_only Only use rules already in memory
+   */
+  bool robots_allow(const link &l, bool known_only);
+  
   void handle_recived_head(http_request *request);
   
-  void handle_recived_get(http_request *request);
+  /**
+   * Store a page's links once the parse_pool found them
+   */
+  void handle_recived_get(
+    http_request *request, 
+    std::vector<std::string> links);
   
+  /**
+   * Let a fetched page's client start the next request while the page 
+   * is still being processed
+   */
+  void free_client(http_request *request);
+  
+  /**
+   * Fill every idle client slot from hosts that are ready, while the 
+   * pages being fetched would all fit in the parse queue
+   */
   void prepare_next_request();
   
   /**
-   * Close the database and exit
+   * @return true if the pages being fetched and parsed fill the parse 
+   *  queue, nothing new may be fetched
+   */
+  bool parse_queue_full() const
+  {
+    return parser.full(in_flight.size() - parsing);
+  }
+  
+  /**
+   * Wake prepare_next_request() when the next host becomes ready
+   */
+  void arm_queue_timer();
+  
+  void handle_queue_timer(const system::error_code &err);
+  
+  /**
+   * Read the next batch of links from the database when the queue is low
+   * and the last read may not have been the end of the table
+   */
+  void start_refill();
+  
+  /**
+   * Runs on the reader thread so no io_service thread waits on the 
+   * database and fetching continues while it is read
+   */
+  void refill(std::int64_t cursor);
+  
+  void handle_refill(
+    v_links links, 
+    std::int64_t cursor);
+  
+  /**
+   * Give a finished request back to the request_pool and its client slot 
+   * to the idle clients
+   */
+  void release_request(http_request *request);
+  
+  /**
+   * Let the reader thread finish the read it has queued and join it
+   */
+  void stop_reader();
+  
+  /**
+   * @return The backend named by options.backend
+   * @throw CrawlerException if there is no such backend
+   */
+  static database* open_database(const crawler_options &options);
+  
+  /**
+   * Caught a signal, stop the io_service like finish() so main joins the
+   * workers and the destructor closes the database
    */
   void handle_stop();
+  
+  /**
+   * Nothing is queued, in flight or left in the database, stop the
+   * io_service so main can return
+   */
+  void finish();
 };
 
 #endif
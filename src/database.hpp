@@ -24,10 +24,12 @@
 #ifndef _WC_DATABASE_H_
 #define _WC_DATABASE_H_
 
+#include <cstdint>
+#include <string>
 #include <vector>
-#include <tuple>
+#include "compact_url.hpp"
 
-typedef std::vector<std::tuple<std::string,std::string,std::string>> v_links;
+typedef std::vector<compact_url> v_links;
 
 class database
 {
@@ -39,6 +41,17 @@ public:
    */
   virtual void close_db() = 0;
   
+  /**
+   * Start a transaction, calls may nest and only the outermost 
+   * begin()/commit() pair takes effect
+   */
+  virtual void begin() = 0;
+  
+  /**
+   * Commit the transaction started by the matching begin()
+   */
+  virtual void commit() = 0;
+  
   /**
    * @param links A vector of links to add to the database
    */
@@ -66,6 +79,16 @@ public:
     std::string protocol,
     unsigned int code) = 0;
   
+  /**
+   * The compact_url overloads take a link as it was queued, by default
+   * they call the string versions
+   */
+  virtual void set_visited(const compact_url &link, unsigned int code)
+  {
+    set_visited(link.get_host(), link.get_path().to_string(), 
+      link.get_protocol(), code);
+  }
+  
   /**
    * Update the last visited date
    */
@@ -74,16 +97,30 @@ public:
     std::string path, 
     std::string protocol) = 0;
   
+  virtual void set_last_visited(const compact_url &link)
+  {
+    set_last_visited(link.get_host(), link.get_path().to_string(), 
+      link.get_protocol());
+  }
+  
   /**
    * @param num The number of links to return
-   * @return a vector of tuples representing links
+   * @param cursor Only links stored after the cursor are returned, it is
+   *  moved past the returned links. Start with 0
+   * @return The links, unvisited and not blacklisted
    */
-  virtual v_links get_links(std::size_t num) = 0;
+  virtual v_links get_links(std::size_t num, std::int64_t &cursor) = 0;
   
   virtual bool check_blacklist(
     std::string domain, 
     std::string path, 
     std::string proto) = 0;
+  
+  virtual bool check_blacklist(const compact_url &link)
+  {
+    return check_blacklist(link.get_host(), link.get_path().to_string(), 
+      link.get_protocol());
+  }
     
   virtual void remove_link(
     std::string domain, 
@@ -100,14 +137,33 @@ public:
     std::string protocol, 
     std::string reason = "default") = 0;
   
+  virtual void blacklist(
+    const compact_url &link, 
+    std::string reason = "default")
+  {
+    blacklist(link.get_host(), link.get_path().to_string(), 
+      link.get_protocol(), reason);
+  }
+  
+  /**
+   * @param robots The robots.txt text, kept for get_robots()
+   */
   virtual void set_robot_processed(
     std::string server, 
     std::string protocol,
-    bool timed_out) = 0;
+    bool timed_out,
+    std::string robots) = 0;
   
   virtual bool should_process_robots(
     std::string domain, 
     std::string protocol) = 0;
+  
+  /**
+   * @return The stored robots.txt, empty if there is none
+   */
+  virtual std::string get_robots(
+    std::string domain, 
+    std::string protocol) = 0;
     
 private:
 };
@@ -0,0 +1,146 @@
+/*
+ * WebCrawler: dns_cache.cxx
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file dns_cache.cxx
+ * @author Kyle Givler
+ */
+
+#include "dns_cache.hpp"
+#include <boost/bind.hpp>
+
+dns_cache::dns_cache(
+  asio::io_service &io_service, 
+  long ttl, 
+  long negative_ttl,
+  std::size_t max_entries)
+  : io_service(io_service),
+    resolver(io_service),
+    ttl(posix_time::seconds(ttl)),
+    negative_ttl(posix_time::seconds(negative_ttl)),
+    max_entries(max_entries),
+    logger("dns_cache")
+{
+}
+
+dns_cache::~dns_cache()
+{
+}
+
+void dns_cache::async_resolve(
+  std::string host, 
+  std::string service, 
+  resolve_handler handler)
+{
+  std::string key = host + ":" + service;
+  std::lock_guard<std::mutex> lock(mutex);
+  
+  auto it = entries.find(key);
+  if(it != entries.end())
+  {
+    entry &e = it->second;
+    if(e.pending)
+    {
+      coalesced++;
+      e.waiters.push_back(handler);
+      return;
+    }
+    
+    if(e.expires > posix_time::microsec_clock::universal_time())
+    {
+      hits++;
+      deliver(e, handler);
+      return;
+    }
+  }
+  
+  misses++;
+  if(entries.size() >= max_entries)
+    sweep();
+  
+  entry &e = entries[key];
+  e.pending = true;
+  e.waiters.push_back(handler);
+  
+  logger.trace("Resolving: " + key);
+  tcp::resolver::query query(host, service);
+  resolver.async_resolve(query, bind(&dns_cache::handle_resolve, this,
+    asio::placeholders::error, asio::placeholders::iterator, key));
+}
+
+void dns_cache::handle_resolve(
+  const system::error_code &err,
+  tcp::resolver::iterator endpoint_it,
+  std::string key)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  entry &e = entries[key];
+  
+  e.pending = false;
+  e.error = err;
+  auto endpoints = std::make_shared<std::vector<tcp::endpoint>>();
+  if(!err)
+  {
+    for(tcp::resolver::iterator end; endpoint_it != end; ++endpoint_it)
+      endpoints->push_back(endpoint_it->endpoint());
+  }
+  e.endpoints = endpoints;
+  
+  e.expires = posix_time::microsec_clock::universal_time() + 
+    (err ? negative_ttl : ttl);
+  
+  if(err)
+    logger.debug("Caching failed lookup: " + key + " " + err.message());
+  
+  std::vector<resolve_handler> waiters;
+  waiters.swap(e.waiters);
+  for(auto &handler : waiters)
+    deliver(e, handler);
+}
+
+void dns_cache::deliver(
+  const entry &e, 
+  resolve_handler handler)
+{
+  io_service.post(std::bind(handler, e.error, e.endpoints));
+}
+
+void dns_cache::sweep()
+{
+  posix_time::ptime now = posix_time::microsec_clock::universal_time();
+  
+  for(auto it = entries.begin(); it != entries.end(); )
+  {
+    if(!it->second.pending && it->second.expires <= now)
+      it = entries.erase(it);
+    else
+      ++it;
+  }
+  
+  // Everything is still fresh, start over rather than grow without bound
+  if(entries.size() >= max_entries)
+  {
+    for(auto it = entries.begin(); it != entries.end(); )
+    {
+      if(!it->second.pending)
+        it = entries.erase(it);
+      else
+        ++it;
+    }
+  }
+}
@@ -0,0 +1,128 @@
+/*
+ * WebCrawler: dns_cache.hpp
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file dns_cache.hpp
+ * @author Kyle Givler
+ */
+
+#ifndef _WC_DNS_CACHE_H_
+#define _WC_DNS_CACHE_H_
+
+#include <boost/asio.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "logger/logger.hpp"
+
+using boost::asio::ip::tcp;
+using namespace boost;
+
+/**
+ * Caching front end for tcp::resolver, shared by all http_clients
+ * Successful lookups are kept for ttl seconds, failures for negative_ttl
+ * seconds, and concurrent lookups of the same host share one query
+ */
+class dns_cache
+{
+public:
+  typedef std::shared_ptr<const std::vector<tcp::endpoint>> endpoints_ptr;
+  typedef std::function<void(const system::error_code&, 
+    endpoints_ptr)> resolve_handler;
+  
+  /**
+   * @param ttl Seconds a resolved host is cached
+   * @param negative_ttl Seconds a failed lookup is cached
+   * @param max_entries Cache size that triggers a sweep of expired entries
+   */
+  dns_cache(asio::io_service &io_service, 
+    long ttl = 300, 
+    long negative_ttl = 30,
+    std::size_t max_entries = 10000);
+  
+  virtual ~dns_cache();
+  
+  /**
+   * Resolve host, the handler is always called through the io_service, 
+   * never from inside this call. On error the endpoint list is empty
+   */
+  void async_resolve(
+    std::string host, 
+    std::string service, 
+    resolve_handler handler);
+  
+  /**
+   * @return Lookups answered from the cache, including cached failures
+   */
+  std::size_t get_hits() const { return this->hits; }
+  
+  /**
+   * @return Lookups that went to the resolver
+   */
+  std::size_t get_misses() const { return this->misses; }
+  
+  /**
+   * @return Lookups that waited on a query already in flight
+   */
+  std::size_t get_coalesced() const { return this->coalesced; }
+
+private:
+  struct entry
+  {
+    endpoints_ptr endpoints;
+    system::error_code error;
+    posix_time::ptime expires;
+    bool pending = false;
+    std::vector<resolve_handler> waiters;
+  };
+  
+  asio::io_service &io_service;
+  tcp::resolver resolver;
+  std::map<std::string, entry> entries;
+  std::mutex mutex;
+  posix_time::time_duration ttl;
+  posix_time::time_duration negative_ttl;
+  std::size_t max_entries;
+  std::size_t hits = 0;
+  std::size_t misses = 0;
+  std::size_t coalesced = 0;
+  Logger logger;
+  
+  void handle_resolve(
+    const system::error_code &err,
+    tcp::resolver::iterator endpoint_it,
+    std::string key);
+  
+  /**
+   * Post the handler with the entry's result, call with the mutex held
+   */
+  void deliver(
+    const entry &e, 
+    resolve_handler handler);
+  
+  /**
+   * Drop expired entries, call with the mutex held
+   */
+  void sweep();
+};
+
+#endif
@@ -0,0 +1,212 @@
+/*
+ * WebCrawler: frontier.cxx
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file frontier.cxx
+ * @author Kyle Givler
+ */
+
+#include "frontier.hpp"
+#include <algorithm>
+
+frontier::frontier(double delay, std::size_t max_per_host)
+  : delay(posix_time::milliseconds(static_cast<long>(delay * 1000))),
+    max_per_host(max_per_host == 0 ? 1 : max_per_host)
+{
+}
+
+frontier::~frontier()
+{
+}
+
+frontier::host& frontier::get_host(key_type key)
+{
+  auto it = hosts.find(key);
+  if(it == hosts.end())
+  {
+    it = hosts.insert(std::make_pair(key, host())).first;
+    it->second.delay = delay;
+  }
+  return it->second;
+}
+
+void frontier::push(const link &l)
+{
+  key_type key = l.get_site();
+  host &h = get_host(key);
+  h.queue.push_back(l);
+  queued++;
+  schedule(key, h);
+}
+
+void frontier::push_front(const link &l)
+{
+  key_type key = l.get_site();
+  host &h = get_host(key);
+  h.queue.push_front(l);
+  queued++;
+  schedule(key, h);
+}
+
+bool frontier::pop(link &l, posix_time::ptime now)
+{
+  expire(now);
+  
+  while(!ready.empty() && ready.top().first <= now)
+  {
+    entry top = ready.top();
+    ready.pop();
+    
+    host &h = hosts[top.second];
+    h.scheduled = false;
+    
+    // The host was held or filled up after it was scheduled
+    if(h.held || h.queue.empty() || h.active >= max_per_host)
+    {
+      retire(top.second, h);
+      continue;
+    }
+    
+    // Its delay grew after it was scheduled
+    if(h.next_allowed > now)
+    {
+      schedule(top.second, h);
+      continue;
+    }
+    
+    l = h.queue.front();
+    h.queue.pop_front();
+    queued--;
+    h.active++;
+    h.next_allowed = now + h.delay;
+    schedule(top.second, h);
+    return true;
+  }
+  
+  return false;
+}
+
+void frontier::finish(key_type key)
+{
+  auto it = hosts.find(key);
+  if(it == hosts.end())
+    return;
+  
+  if(it->second.active > 0)
+    it->second.active--;
+  schedule(key, it->second);
+  retire(key, it->second);
+}
+
+void frontier::hold(key_type key)
+{
+  get_host(key).held = true;
+}
+
+void frontier::unhold(key_type key)
+{
+  host &h = get_host(key);
+  h.held = false;
+  schedule(key, h);
+  retire(key, h);
+}
+
+std::size_t frontier::drop_if(key_type key, 
+  std::function<bool(const link&)> drop)
+{
+  auto it = hosts.find(key);
+  if(it == hosts.end())
+    return 0;
+  
+  std::deque<link> &q = it->second.queue;
+  std::size_t before = q.size();
+  q.erase(std::remove_if(q.begin(), q.end(), drop), q.end());
+  
+  std::size_t dropped = before - q.size();
+  queued -= dropped;
+  retire(key, it->second);
+  return dropped;
+}
+
+void frontier::set_delay(key_type key, double seconds)
+{
+  host &h = get_host(key);
+  posix_time::time_duration d = 
+    posix_time::milliseconds(static_cast<long>(seconds * 1000));
+  
+  // Keep the spacing from the last request started under the old delay
+  if(h.next_allowed != posix_time::min_date_time)
+    h.next_allowed += d - h.delay;
+  h.delay = d;
+  retire(key, h);
+}
+
+posix_time::ptime frontier::next_ready()
+{
+  while(!ready.empty())
+  {
+    const host &h = hosts[ready.top().second];
+    if(!h.held && !h.queue.empty() && h.active < max_per_host)
+      return std::max(ready.top().first, h.next_allowed);
+    
+    key_type key = ready.top().second;
+    ready.pop();
+    hosts[key].scheduled = false;
+    retire(key, hosts[key]);
+  }
+  
+  return posix_time::not_a_date_time;
+}
+
+void frontier::schedule(key_type key, host &h)
+{
+  if(h.scheduled || h.held || h.queue.empty() || h.active >= max_per_host)
+    return;
+  
+  h.scheduled = true;
+  ready.push(entry(h.next_allowed, key));
+}
+
+void frontier::retire(key_type key, host &h)
+{
+  if(h.scheduled || h.held || !h.queue.empty() || h.active > 0)
+    return;
+  
+  idle.push(entry(h.next_allowed, key));
+}
+
+void frontier::expire(posix_time::ptime now)
+{
+  while(!idle.empty() && idle.top().first <= now)
+  {
+    key_type key = idle.top().second;
+    idle.pop();
+    
+    // Links came back, or it was retired again with a later delay
+    auto it = hosts.find(key);
+    if(it == hosts.end())
+      continue;
+    
+    const host &h = it->second;
+    if(h.scheduled || h.held || !h.queue.empty() || h.active > 0 ||
+       h.next_allowed > now)
+      continue;
+    
+    hosts.erase(it);
+  }
+}
@@ -0,0 +1,165 @@
+/*
+ * WebCrawler: frontier.hpp
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file frontier.hpp
+ * @author Kyle Givler
+ */
+
+#ifndef _WC_FRONTIER_H_
+#define _WC_FRONTIER_H_
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <deque>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+#include "compact_url.hpp"
+
+using namespace boost;
+
+/**
+ * Links waiting to be crawled, queued per host
+ * A host is handed out again only after its delay has passed and while it 
+ * has fewer than max_per_host requests active, so many hosts are crawled
+ * in parallel without hammering any one of them. Not thread safe, the 
+ * Crawler only uses it on its strand
+ */
+class frontier
+{
+public:
+  typedef compact_url link;
+  
+  /**
+   * Hosts are queued under their scheme and host id
+   */
+  typedef compact_url::site_type key_type;
+  
+  /**
+   * @param delay Seconds between the start of two requests to a host
+   * @param max_per_host Most requests active at once for a host
+   */
+  frontier(double delay = 1.0, std::size_t max_per_host = 2);
+  
+  virtual ~frontier();
+  
+  /**
+   * Queue a link at the back of its host's queue
+   */
+  void push(const link &l);
+  
+  /**
+   * Queue a link at the front of its host's queue
+   */
+  void push_front(const link &l);
+  
+  /**
+   * Take the next link from a host that may be requested now
+   * The host counts the link as active until finish() is called
+   * @return false if no host is ready
+   */
+  bool pop(link &l, posix_time::ptime now);
+  
+  /**
+   * A request started by pop() for this host is done
+   */
+  void finish(key_type key);
+  
+  /**
+   * Stop handing out links for a host until unhold(), eg. while its 
+   * robots.txt is fetched
+   */
+  void hold(key_type key);
+  
+  void unhold(key_type key);
+  
+  /**
+   * Remove a host's queued links that drop returns true for
+   * @return Number of links removed
+   */
+  std::size_t drop_if(key_type key, std::function<bool(const link&)> drop);
+  
+  /**
+   * Set the delay for one host, eg. from its robots.txt Crawl-delay
+   */
+  void set_delay(key_type key, double seconds);
+  
+  /**
+   * @return When the next host becomes ready, or not_a_date_time if no 
+   * host can become ready without a finish() or unhold()
+   */
+  posix_time::ptime next_ready();
+  
+  /**
+   * @return Number of queued links
+   */
+  std::size_t size() const { return this->queued; }
+  
+  bool empty() const { return this->queued == 0; }
+  
+  /**
+   * @return Number of hosts with queued or active links, or whose delay
+   *  has not run out since their last request
+   */
+  std::size_t host_count() const { return this->hosts.size(); }
+
+private:
+  struct host
+  {
+    std::deque<link> queue;
+    posix_time::ptime next_allowed = posix_time::min_date_time;
+    posix_time::time_duration delay;
+    std::size_t active = 0;
+    bool held = false;
+    bool scheduled = false; // Has an entry in ready
+  };
+  
+  typedef std::pair<posix_time::ptime, key_type> entry;
+  
+  typedef std::priority_queue<entry, std::vector<entry>, 
+    std::greater<entry>> entry_heap;
+  
+  std::unordered_map<key_type, host> hosts;
+  entry_heap ready;
+  // Hosts left with nothing to do, by when their delay runs out. They are
+  // forgotten after that unless links came back for them
+  entry_heap idle;
+  posix_time::time_duration delay;
+  std::size_t max_per_host;
+  std::size_t queued = 0;
+  
+  host& get_host(key_type key);
+  
+  /**
+   * Put a host in the ready heap if it has links it may be handed out for
+   */
+  void schedule(key_type key, host &h);
+  
+  /**
+   * Put a host in the idle heap if it has nothing queued, active or held
+   */
+  void retire(key_type key, host &h);
+  
+  /**
+   * Forget the idle hosts whose delay has run out
+   */
+  void expire(posix_time::ptime now);
+};
+
+#endif
@@ -0,0 +1,227 @@
+/*
+ * WebCrawler: http_body_decoder.cxx
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file http_body_decoder.cxx
+ * @author Kyle Givler
+ */
+
+#include "http_body_decoder.hpp"
+#include <algorithm>
+#include <cctype>
+
+http_body_decoder::http_body_decoder()
+{
+}
+
+void http_body_decoder::reset(BodyFraming framing, std::size_t length)
+{
+  this->framing = framing;
+  this->state = ChunkState::SIZE;
+  this->remaining = 0;
+  this->size_digits = 0;
+  this->error.clear();
+  
+  switch(framing)
+  {
+    case BodyFraming::NONE:
+      complete = true;
+      break;
+    case BodyFraming::CONTENT_LENGTH:
+      remaining = length;
+      complete = (length == 0);
+      break;
+    default:
+      complete = false;
+  }
+}
+
+std::size_t http_body_decoder::decode(
+  const char *data, 
+  std::size_t size, 
+  body_sink &sink)
+{
+  if(complete || has_error())
+    return 0;
+  
+  switch(framing)
+  {
+    case BodyFraming::CONTENT_LENGTH:
+    {
+      std::size_t n = std::min(size, remaining);
+      if(n > 0)
+        sink.append_body(data, n);
+      remaining -= n;
+      complete = (remaining == 0);
+      return n;
+    }
+    case BodyFraming::CHUNKED:
+      return decode_chunked(data, size, sink);
+    case BodyFraming::UNTIL_CLOSE:
+      if(size > 0)
+        sink.append_body(data, size);
+      return size;
+    default:
+      return 0;
+  }
+}
+
+void http_body_decoder::finish()
+{
+  if(complete || has_error())
+    return;
+  
+  if(framing == BodyFraming::UNTIL_CLOSE)
+    complete = true;
+  else
+    fail("Connection closed before end of body");
+}
+
+std::size_t http_body_decoder::decode_chunked(
+  const char *data, 
+  std::size_t size, 
+  body_sink &sink)
+{
+  std::size_t pos = 0;
+  
+  while(pos < size && !complete && !has_error())
+  {
+    char c = data[pos];
+    
+    switch(state)
+    {
+      case ChunkState::SIZE:
+        if(std::isxdigit(static_cast<unsigned char>(c)))
+        {
+          // 15 hex digits is far past any sane chunk and can't overflow
+          if(++size_digits > 15)
+          {
+            fail("Chunk size too large");
+            break;
+          }
+          int digit = std::isdigit(static_cast<unsigned char>(c)) ? c - '0' :
+            std::tolower(static_cast<unsigned char>(c)) - 'a' + 10;
+          remaining = remaining * 16 + digit;
+          pos++;
+        } else if(size_digits == 0) {
+          fail("Missing chunk size");
+        } else if(c == ';' || c == ' ' || c == '\t') {
+          state = ChunkState::EXTENSION;
+          pos++;
+        } else if(c == '\r') {
+          state = ChunkState::SIZE_LF;
+          pos++;
+        } else if(c == '\n') { // Tolerate bare LF
+          state = (remaining == 0) ? ChunkState::TRAILER : ChunkState::DATA;
+          pos++;
+        } else {
+          fail("Invalid chunk size");
+        }
+        break;
+        
+      case ChunkState::EXTENSION:
+        if(c == '\r')
+          state = ChunkState::SIZE_LF;
+        else if(c == '\n')
+          state = (remaining == 0) ? ChunkState::TRAILER : ChunkState::DATA;
+        pos++;
+        break;
+        
+      case ChunkState::SIZE_LF:
+        if(c != '\n')
+        {
+          fail("Expected LF after chunk size");
+          break;
+        }
+        state = (remaining == 0) ? ChunkState::TRAILER : ChunkState::DATA;
+        pos++;
+        break;
+        
+      case ChunkState::DATA:
+      {
+        std::size_t n = std::min(size - pos, remaining);
+        sink.append_body(data + pos, n);
+        pos += n;
+        remaining -= n;
+        if(remaining == 0)
+          state = ChunkState::DATA_CR;
+        break;
+      }
+      
+      case ChunkState::DATA_CR:
+        if(c == '\r')
+          state = ChunkState::DATA_LF;
+        else if(c == '\n')
+        {
+          state = ChunkState::SIZE;
+          size_digits = 0;
+        }
+        else
+        {
+          fail("Expected CRLF after chunk data");
+          break;
+        }
+        pos++;
+        break;
+        
+      case ChunkState::DATA_LF:
+        if(c != '\n')
+        {
+          fail("Expected LF after chunk data");
+          break;
+        }
+        state = ChunkState::SIZE;
+        size_digits = 0;
+        pos++;
+        break;
+        
+      case ChunkState::TRAILER: // Start of a trailer line
+        if(c == '\r')
+          state = ChunkState::TRAILER_LF;
+        else if(c == '\n')
+          complete = true;
+        else
+          state = ChunkState::TRAILER_LINE;
+        pos++;
+        break;
+        
+      case ChunkState::TRAILER_LINE: // Trailers are ignored
+        if(c == '\n')
+          state = ChunkState::TRAILER;
+        pos++;
+        break;
+        
+      case ChunkState::TRAILER_LF:
+        if(c != '\n')
+        {
+          fail("Expected LF after trailers");
+          break;
+        }
+        complete = true;
+        pos++;
+        break;
+    }
+  }
+  
+  return pos;
+}
+
+void http_body_decoder::fail(std::string message)
+{
+  error = message;
+}
@@ -0,0 +1,103 @@
+/*
+ * WebCrawler: http_body_decoder.hpp
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file http_body_decoder.hpp
+ * @author Kyle Givler
+ */
+
+#ifndef _WC_HTTP_BODY_DECODER_H_
+#define _WC_HTTP_BODY_DECODER_H_
+
+#include <string>
+#include "body_sink.hpp"
+
+/**
+ * How the end of a response body is found
+ */
+enum class BodyFraming { NONE, CONTENT_LENGTH, CHUNKED, UNTIL_CLOSE };
+
+/**
+ * Incremental HTTP/1.1 message body decoder
+ * Fed bytes as they are read, strips chunked framing and reports
+ * when the body is complete so the connection can be reused
+ */
+class http_body_decoder
+{
+public:
+  http_body_decoder();
+  
+  /**
+   * Start a new body
+   * @param framing How the body is delimited
+   * @param length The Content-Length, only used with CONTENT_LENGTH
+   */
+  void reset(BodyFraming framing, std::size_t length = 0);
+  
+  /**
+   * Decode the next bytes read from the connection
+   * Decoded body bytes are passed to the sink, nothing past the end of 
+   * the body is consumed
+   * @return Number of bytes of data consumed
+   */
+  std::size_t decode(const char *data, std::size_t size, body_sink &sink);
+  
+  /**
+   * The connection was closed, completes an UNTIL_CLOSE body and is an 
+   * error for any body that wasn't finished
+   */
+  void finish();
+  
+  /**
+   * @return true once the whole body has been decoded
+   */
+  bool is_complete() const { return this->complete; }
+  
+  /**
+   * @return true if the body was malformed or cut short
+   */
+  bool has_error() const { return !this->error.empty(); }
+  
+  /**
+   * @return Description of the error
+   */
+  std::string get_error() const { return this->error; }
+  
+  /**
+   * @return How the current body is delimited
+   */
+  BodyFraming get_framing() const { return this->framing; }
+
+private:
+  enum class ChunkState { SIZE, EXTENSION, SIZE_LF, DATA, DATA_CR, DATA_LF,
+    TRAILER, TRAILER_LINE, TRAILER_LF };
+  
+  BodyFraming framing = BodyFraming::NONE;
+  ChunkState state = ChunkState::SIZE;
+  std::size_t remaining = 0;
+  std::size_t size_digits = 0;
+  bool complete = true;
+  std::string error;
+  
+  std::size_t decode_chunked(const char *data, std::size_t size, 
+    body_sink &sink);
+  
+  void fail(std::string message);
+};
+
+#endif
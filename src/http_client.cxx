@@ -20,19 +20,24 @@
 #include "http_request.hpp"
 #include <boost/bind.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
-#include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/case_conv.hpp>
+#include <cstring>
 #include <sstream>
 
-http_client::http_client(asio::io_service &io_service) 
+http_client::http_client(
+  asio::io_service &io_service,
+  connection_cache &connections,
+  dns_cache &dns,
+  tls_session_cache &tls,
+  std::size_t max_body_size) 
   : io_service(io_service),
-    socket(io_service),
     strand(io_service),
-    resolver(io_service),
     logger("http_client"),
-    sslctx(asio::ssl::context::sslv23_client),
-    ssl_sock(socket, sslctx),
-    deadline(io_service)
+    deadline(io_service),
+    connections(connections),
+    dns(dns),
+    tls(tls),
+    max_body_size(max_body_size)
 {
   logger.setIgnoreLevel(Level::NONE);
 }
@@ -44,31 +49,54 @@ http_client::~http_client()
 
 void http_client::stop(http_request *request, std::string from)
 {
+  // Several handlers may have posted a stop for the same request
+  if(stopped)
+    return;
+  
   logger.info("Stop: " + from);
   stopped = true;
   
-  if(request->get_protocol() == "https")
-    ssl_sock.lowest_layer().close();
-  else
-    socket.close();
-    
+  if(sniffing)
+    sniff_content(request, true);
+  
+  if(body.is_complete())
+  {
+    content.finish();
+    if(content.has_error())
+      request->add_error("Error: " + content.get_error());
+  }
+  request->set_wire_bytes(content.get_wire_bytes());
+  
+  release_connection();
   deadline.cancel();
   request->set_completed(true);
   //request->call_request_reciver(request);
   strand.post(bind(&http_request::call_request_reciver, request, request));
 }
 
-void http_client::check_deadline(http_request *request)
+void http_client::release_connection()
 {
-  if(stopped)
+  if(!conn)
+    return;
+  
+  if(keep_alive && body.is_complete() && !body.has_error())
+    connections.release(conn);
+  else
+    conn->close();
+  
+  conn.reset();
+}
+
+void http_client::check_deadline(http_request *request, std::size_t id)
+{
+  // A newer make_request() re-armed the timer, request may be gone
+  if(stopped || id != deadline_id)
     return;
     
   if(deadline.expires_at() <= asio::deadline_timer::traits_type::now())
   {
-    if(request->get_protocol() == "https")
-      ssl_sock.lowest_layer().close();
-    else
-      socket.close();
+    if(conn)
+      conn->close();
   
     logger.warn("Timedout: " + request->get_protocol() + "://" + 
       request->get_server() + request->get_path());
@@ -78,53 +106,58 @@ void http_client::check_deadline(http_request *request)
   }
 }
 
+void http_client::post_request(http_request *request)
+{
+  strand.post(bind(&http_client::make_request, this, request));
+}
+
 void http_client::make_request(
   http_request *request)
 {
   stopped = false;
   requested_content = false;
+  keep_alive = false;
+  sniffing = false;
+  body.reset(BodyFraming::NONE);
+  request->reset_headers();
   deadline.expires_from_now(posix_time::seconds(45));
-  deadline.async_wait( std::bind( &http_client::check_deadline, this, request) );
-  ssl_sock.set_verify_mode(asio::ssl::verify_none);
-  ssl_sock.set_verify_callback(bind(&http_client::always_verify, this, _1, _2));
-  ssl_sock.async_shutdown(bind(&http_client::ssl_shutdown_handler, this, asio::placeholders::error, request));
+  deadline.async_wait( strand.wrap( bind( &http_client::check_deadline, this, 
+    request, ++deadline_id ) ) );
   
-  //sslctx.set_verify_mode(asio::ssl::verify_none);
-  //sslctx.set_verify_callback(bind(&http_client::always_verify, this, _1, _2));
   //logger.info( "Requesting: " + request->get_protocol() + "://" + 
   //  request->get_server() + request->get_path() + " port: " + 
   //    std::to_string(request->get_port()));
     
-  std::string domain = request->get_server();
-  if(domain[0] == '/' && domain[1] == '/')
+  // The server is host[:port] as add_links() stored it
+  boost::string_ref name;
+  unsigned int port = request->get_protocol() == "https" ? 443 : 80;
+  if(!url::split_host_port(request->get_server(), name, port))
   {
-    logger.debug("Fixing link: " + domain);
-    domain.erase(0,2);
-    domain.insert(0, "http://");
+    request->add_error("Error: Bad server: " + request->get_server());
+    strand.post(bind(&http_client::stop, this, request, "make_request"));
+    return;
   }
+  host = name.to_string();
+  request->set_port(port);
   
-  std::size_t found = domain.find("://");
-  if(found != std::string::npos)
-  {
-    std::string proto = domain.substr(0, found + 3);
-    if(proto == "https://")
-    {
-      logger.debug("Set protocol to https");
-      request->set_protocol("https");
-    }
-    domain = domain.substr(found + 3);
-    request->set_server(domain);
-    logger.debug("Converted to: " + domain);
-  }
+  build_request(request);
   
-  if(request->get_protocol() == "https" && request->get_port() == 80)
+  conn = connections.acquire(connection_cache::make_key(
+    request->get_protocol(), request->get_server(), request->get_port()));
+  if(conn)
   {
-    logger.debug("Fixing https port...");
-    request->set_port(443);
-    logger.debug("Fixed: " + request->get_protocol() + "://" + request->get_server() +
-      request->get_path() + " port: " + std::to_string(request->get_port()));
+    reused = true;
+    logger.trace("Reusing connection: " + conn->get_key());
+    write_request(request);
+    return;
   }
   
+  open_connection(request);
+}
+
+void http_client::build_request(http_request *request)
+{
+  request->get_request_buf().consume(request->get_request_buf().size());
   std::ostream request_stream(&request->get_request_buf());
   
   if(request->get_request().size() > 0) // Request provided
@@ -132,7 +165,8 @@ void http_client::make_request(
     request_stream << request->get_request();
     request_stream << "User-Agent: JoyfulReaper\r\n";
   }
-  else if (request->get_request_type() == RequestType::GET) // Get request
+  else if (request->get_request_type() == RequestType::GET ||
+           request->get_request_type() == RequestType::ROBOT_GET) // Get request
   {
     logger.debug("GET REQUEST: " + request->get_protocol() + "://" + 
       request->get_server() + request->get_path() + " port: " + 
@@ -142,8 +176,10 @@ void http_client::make_request(
     request_stream << "Host: " << request->get_server() << "\r\n";
     request_stream << "Accept: */*\r\n";
     request_stream << "Accept-Charset: utf-8\r\n";
-    request_stream << "Connection: close\r\n\r\n";
-  } else if (request->get_request_type() == RequestType::HEAD) // Head request
+    request_stream << "Accept-Encoding: " << content_decoder::accept_encoding() << "\r\n";
+    request_stream << "Connection: keep-alive\r\n\r\n";
+  } else if (request->get_request_type() == RequestType::HEAD ||
+             request->get_request_type() == RequestType::ROBOT_HEAD) // Head request
   {
     logger.debug("HEAD REQUEST: " + request->get_protocol() + "://" + 
       request->get_server() + request->get_path() + " port: " + 
@@ -153,37 +189,63 @@ void http_client::make_request(
     request_stream << "Host: " << request->get_server() << "\r\n";
     request_stream << "Accept: */*\r\n";
     request_stream << "Accept-Charset: utf-8\r\n";
-    request_stream << "Connection: close\r\n\r\n";
+    request_stream << "Accept-Encoding: " << content_decoder::accept_encoding() << "\r\n";
+    request_stream << "Connection: keep-alive\r\n\r\n";
   }
+}
+
+void http_client::open_connection(http_request *request)
+{
+  reused = false;
+  conn = std::make_shared<connection>(io_service, tls.get_context(), 
+    connection_cache::make_key(request->get_protocol(), 
+      request->get_server(), request->get_port()),
+    request->get_protocol() == "https");
+  conn->get_ssl_stream().set_verify_mode(asio::ssl::verify_none);
+  conn->get_ssl_stream().set_verify_callback(
+    bind(&http_client::always_verify, this, _1, _2));
   
-  tcp::resolver::query query(request->get_server(), std::to_string(request->get_port()));
-  resolver.async_resolve( query, strand.wrap(bind ( &http_client::handle_resolve, this,
-    asio::placeholders::error, asio::placeholders::iterator, request ) ) );
+  dns.async_resolve( host, std::to_string(request->get_port()),
+    strand.wrap(bind ( &http_client::handle_resolve, this,
+      _1, _2, request, conn ) ) );
+}
+
+void http_client::retry_request(http_request *request)
+{
+  logger.debug("Kept alive connection was closed, reconnecting: " + 
+    conn->get_key());
+  conn->close();
+  request->reset_buffers();
+  build_request(request);
+  open_connection(request);
+}
+
+void http_client::write_request(http_request *request)
+{
+  conn->add_request();
+  conn->async_write( request->get_request_buf(), 
+    strand.wrap( bind ( &http_client::handle_write_request, this, 
+      asio::placeholders::error, request, conn ) ) );
 }
 
 void http_client::handle_resolve(
   const system::error_code &err, 
-  tcp::resolver::iterator endpoint_it, 
-  http_request *request)
+  dns_cache::endpoints_ptr endpoints, 
+  http_request *request,
+  connection_ptr c)
 {
-  if(stopped)
+  if(stopped || c != conn)
     return;
     
   if(!err)
   {
     logger.trace("handle_resolve: " + request->get_server());
-    if(request->get_protocol() == "https")
-    {
-      logger.trace("https resolve");
-      
-      asio::async_connect( ssl_sock.lowest_layer(), endpoint_it,
+    // Keep the cached list alive until the connect finishes
+    this->endpoints = endpoints;
+    asio::async_connect( conn->get_socket(), 
+      this->endpoints->begin(), this->endpoints->end(),
       strand.wrap( bind( &http_client::handle_connect, this, 
-        asio::placeholders::error, request ) ) );
-    } else {
-      asio::async_connect( socket, endpoint_it,
-        strand.wrap( bind( &http_client::handle_connect, this, 
-          asio::placeholders::error, request ) ) );
-    }
+        asio::placeholders::error, request, conn ) ) );
   } else {
     logger.warn("Resolve: " + err.message());
     request->add_error("Error: " + err.message());
@@ -194,26 +256,26 @@ void http_client::handle_resolve(
 
 void http_client::handle_connect(
   const system::error_code &err, 
-  http_request *request)
+  http_request *request,
+  connection_ptr c)
 {
-  if(stopped)
+  if(stopped || c != conn)
     return;
     
   if(!err)
   {
     logger.trace("handle_connect: " + request->get_server());
-    if(request->get_protocol() == "https")
+    if(conn->is_ssl())
     {
       //asio::ssl::stream_base::client
       logger.trace("https connect");
-      ssl_sock.lowest_layer().set_option(tcp::no_delay(true));
-      ssl_sock.async_handshake(asio::ssl::stream<tcp::socket>::client,
+      conn->get_socket().set_option(tcp::no_delay(true));
+      tls.prepare(*conn, host);
+      conn->get_ssl_stream().async_handshake(asio::ssl::stream_base::client,
       strand.wrap( bind( &http_client::handle_handshake, this, 
-        asio::placeholders::error, request ) ) );
+        asio::placeholders::error, request, conn ) ) );
     } else {
-      asio::async_write( socket, request->get_request_buf(), 
-        strand.wrap( bind ( &http_client::handle_write_request, this, 
-          asio::placeholders::error, request ) ) );
+      write_request(request);
     }
   } else {
     logger.warn("Connect: " + err.message());
@@ -225,29 +287,29 @@ void http_client::handle_connect(
 
 void http_client::handle_handshake(
     const system::error_code &err, 
-    http_request *request)
+    http_request *request,
+    connection_ptr c)
 {
-  if(stopped)
+  if(stopped || c != conn)
     return;
     
   if(!err)
   {
     logger.trace("https handshake: " + request->get_server());
+    tls.handshake_done(*conn);
     logger.info(request->get_protocol() + "://" + request->get_server() + request->get_path() + ":" +
     std::to_string(request->get_port()));
     
-    asio::async_write( ssl_sock, request->get_request_buf(), 
-      strand.wrap( bind ( &http_client::handle_write_request, this, 
-        asio::placeholders::error, request ) ) );
+    write_request(request);
   }
-  if (err.category() == asio::error::get_ssl_category() &&
+  else if (err.category() == asio::error::get_ssl_category() &&
     err.value() == ERR_PACK(ERR_LIB_SSL, 0, SSL_R_SHORT_READ)) {
     logger.warn("Handshake completed with short read");
-      asio::async_read(ssl_sock, request->get_response_buf(), asio::transfer_at_least(1),
-        strand.wrap( bind(&http_client::handle_write_request, this,
-          asio::placeholders::error, request ) ) );
-  } else if(err != 0) {
+    tls.handshake_done(*conn);
+    write_request(request);
+  } else {
     logger.warn("NOT 0: Handshake: " + err.message());
+    tls.remove(*conn);
     request->add_error ("Error: " + err.message());
     //stop(request, "handle_handshake");
     strand.post(bind(&http_client::stop, this, request, "handle_handshake"));
@@ -256,25 +318,20 @@ void http_client::handle_handshake(
 
 void http_client::handle_write_request(
   const system::error_code &err, 
-  http_request *request)
+  http_request *request,
+  connection_ptr c)
 {
-  if(stopped)
+  if(stopped || c != conn)
     return;
     
   if(!err)
   {
     logger.trace("handle_write_request: " + request->get_server());
-    if(request->get_protocol() == "https")
-    {
-      logger.trace("https write_request: " + request->get_server());
-      asio::async_read_until( ssl_sock, request->get_response_buf(), "\r\n",
-        strand.wrap ( bind ( &http_client::handle_read_status_line, this, asio::placeholders::error,
-        request ) ) );
-    } else {
-      asio::async_read_until( socket, request->get_response_buf(), "\r\n",
-        strand.wrap ( bind ( &http_client::handle_read_status_line, this, asio::placeholders::error,
-        request ) ) );
-    }
+    conn->async_read_until( request->get_response_buf(), "\r\n",
+      strand.wrap ( bind ( &http_client::handle_read_status_line, this, 
+        asio::placeholders::error, request, conn ) ) );
+  } else if(reused) {
+    retry_request(request);
   } else {
     logger.warn("Write: " + err.message());
     request->add_error ("Error: " + err.message());
@@ -285,9 +342,10 @@ void http_client::handle_write_request(
 
 void http_client::handle_read_status_line(
   const system::error_code &err, 
-  http_request *request)
+  http_request *request,
+  connection_ptr c)
 {
-  if(stopped)
+  if(stopped || c != conn)
     return;  
 
   if(!err)
@@ -310,24 +368,20 @@ void http_client::handle_read_status_line(
       request->add_error( "Invalid HTTP response");
       strand.post(bind(&http_client::stop, this, request, "Invalid HTTP Response"));
       //stop(request, "handle_read_status_line_INVALID");
+      return;
     }
     
     logger.debug("HTTP Version: " + http_version);
     logger.debug("Status code: " + std::to_string(status_code));
     logger.debug("Status message: " + status_message);
     
-    if(request->get_protocol() == "https")
-    {
-      asio::async_read_until( ssl_sock, request->get_response_buf(), "\r\n\r\n",
-        strand.wrap ( bind ( &http_client::handle_read_headers, this, asio::placeholders::error,
-        request ) ) );
-    } else {
-      asio::async_read_until( socket, request->get_response_buf(), "\r\n\r\n",
-        strand.wrap( bind( &http_client::handle_read_headers, this, asio::placeholders::error, 
-          request ) ) );
-    }
-  } else if(//(err != asio::error::operation_aborted && 
-            err != asio::error::eof) {
+    conn->async_read_until( request->get_response_buf(), "\r\n\r\n",
+      strand.wrap ( bind ( &http_client::handle_read_headers, this, 
+        asio::placeholders::error, request, conn ) ) );
+  } else if(reused && request->get_response_buf().size() == 0) {
+    // Server closed the idle connection before we sent
+    retry_request(request);
+  } else {
     logger.warn("Status line: " + err.message());
     request->add_error ("Error: " + err.message());
     //stop(request, "handle_read_status_line");
@@ -335,11 +389,63 @@ void http_client::handle_read_status_line(
   }
 }
 
+void http_client::set_framing(http_request *request)
+{
+  std::string content_encoding = request->get_header("Content-Encoding");
+  if(!content.reset(content_encoding, request, max_body_size))
+  {
+    logger.warn("Unsupported Content-Encoding: " + content_encoding);
+    request->add_error("Error: Unsupported Content-Encoding: " + 
+      content_encoding);
+  }
+
+  std::string connection_header = request->get_header("Connection");
+  boost::to_lower(connection_header);
+  
+  keep_alive = (request->get_http_version() == "HTTP/1.1");
+  if(connection_header == "close")
+    keep_alive = false;
+  else if(connection_header == "keep-alive")
+    keep_alive = true;
+  
+  int code = request->get_status_code();
+  if(request->get_request_type() == RequestType::HEAD ||
+     request->get_request_type() == RequestType::ROBOT_HEAD ||
+     (code >= 100 && code < 200) || code == 204 || code == 304)
+  {
+    body.reset(BodyFraming::NONE);
+    return;
+  }
+  
+  std::string transfer_encoding = request->get_header("Transfer-Encoding");
+  boost::to_lower(transfer_encoding);
+  std::string content_length = request->get_header("Content-Length");
+  
+  // Transfer-Encoding overrides Content-Length (RFC 7230 3.3.3)
+  if(transfer_encoding.find("chunked") != std::string::npos)
+  {
+    body.reset(BodyFraming::CHUNKED);
+  } else if(!content_length.empty()) {
+    try
+    {
+      body.reset(BodyFraming::CONTENT_LENGTH, std::stoul(content_length));
+    } catch(std::exception &e) {
+      logger.warn("Bad Content-Length: " + content_length);
+      body.reset(BodyFraming::UNTIL_CLOSE);
+      keep_alive = false;
+    }
+  } else {
+    body.reset(BodyFraming::UNTIL_CLOSE);
+    keep_alive = false;
+  }
+}
+
 void http_client::handle_read_headers(
   const system::error_code &err, 
-  http_request *request)
+  http_request *request,
+  connection_ptr c)
 {
-  if(stopped)
+  if(stopped || c != conn)
     return;
 
   if(!err)
@@ -351,14 +457,11 @@ void http_client::handle_read_headers(
     while(std::getline(response_stream, header) && header != "\r")
     {
       logger.trace(header);
-      request->add_header(header + "\n");
-    }
-    
-    if(request->get_response_buf().size() > 0)
-    {
-      logger.trace(header);
+      header += '\n';
       request->add_header(header);
     }
+    
+    set_framing(request);
      
     if(request->get_status_code() == 403 || 
        request->get_status_code() == 404 ||
@@ -366,72 +469,86 @@ void http_client::handle_read_headers(
        request->get_status_code() == 408 ||
        request->get_status_code() == 503)
     {
-      logger.warn(request->get_status_code() + ": " + request->get_server() + request->get_path());
+      logger.warn(std::to_string(request->get_status_code()) + ": " + 
+        request->get_server() + request->get_path());
       //stop(request, "Stopping becasue of status code");
       strand.post(bind(&http_client::stop, this, request, "Stopping becasue of status code"));
+      return;
     }
     
     // If response code is 302 or 301 try request again
     if(request->get_status_code() == 302 || request->get_status_code() == 301)
     {
-      auto headers = request->get_headers();
+      const auto &headers = request->get_headers();
       for(auto &header : headers)
       {
         std::string lower_header = header;
         boost::to_lower(lower_header);
         std::size_t found = lower_header.find("location: ");
-        if(found != std::string::npos)
+        if(found == 0)
         {
-          std::string location = header.substr(10, header.length());
-          found = location.find("https://");
-          if(found != std::string::npos)
-            request->set_protocol("https");
-            
-          found = location.find("://");
-          if(found)
+          // Resolved against the URL that was requested, so a relative
+          // Location works too
+          std::string page = request->get_protocol() + "://" + 
+            request->get_server() + request->get_path();
+          std::string location;
+          if(!url::resolve(url::split(page), header.substr(found + 10), 
+            location))
           {
-            location = location.substr(found + 3, location.length());
-            found = location.find("/");
-            if(found != std::string::npos)
-            {
-              std::string server = location.substr(0, found);
-              std::string resource = location.substr(found, location.length());
-              if(redirect_count >= 5)
-              {
-                logger.warn("Breaking redirect loop");
-                break;
-              } else {
-                resource = boost::algorithm::replace_all_copy(resource, "\r", "");
-                resource = boost::algorithm::replace_all_copy(resource, "\n", "");
-                logger.warn("301/302 Redirecting: (" + std::to_string(redirect_count) + ")");
-                request->reset_buffers();
-                request->reset_errors();
-                request->set_server(server);
-                request->set_path(resource);
-                request->set_redirected(true);
-                logger.warn("Redir to: " + request->get_protocol() + "://" + request->get_server() + request->get_path() + " port: " + std::to_string(request->get_port()));
-                redirect_count++;
-                make_request(request);
-              }
-            }
+            logger.warn("Bad redirect: " + header);
+            break;
           }
+          
+          if(redirect_count >= 5)
+          {
+            logger.warn("Breaking redirect loop");
+            break;
+          }
+          
+          url::parts target = url::split(location);
+          std::string resource = target.path.to_string();
+          if(target.has_query)
+            resource += "?" + target.query.to_string();
+          
+          logger.warn("301/302 Redirecting: (" + std::to_string(redirect_count) + ")");
+          release_connection();
+          request->reset_buffers();
+          request->reset_errors();
+          request->set_protocol(target.scheme.to_string());
+          request->set_server(target.authority.to_string());
+          request->set_path(resource);
+          request->set_redirected(true);
+          logger.warn("Redir to: " + location);
+          redirect_count++;
+          make_request(request);
+          return;
         } // Found location header
       } // For all headers
     } // 301/302
     
-    if(request->get_protocol() == "https")
+    if(!check_content_type(request))
     {
-      logger.trace("https read_header");
-      asio::async_read( ssl_sock, request->get_response_buf(), 
-        asio::transfer_at_least(1), strand.wrap( bind( &http_client::handle_read_content, 
-          this, asio::placeholders::error, request ) ) );
-    } else {
-      asio::async_read( socket, request->get_response_buf(), 
-        asio::transfer_at_least(1), strand.wrap( bind( &http_client::handle_read_content, 
-          this, asio::placeholders::error, request ) ) );
+      strand.post(bind(&http_client::stop, this, request, "Not html"));
+      return;
+    }
+    
+    // Part of the body may have arrived with the headers
+    take_content(request);
+    if(!sniff_content(request, false))
+    {
+      strand.post(bind(&http_client::stop, this, request, "Sniffed: Not html"));
+      return;
     }
+    
+    if(body.is_complete() || body.has_error() || content.has_error())
+    {
+      strand.post(bind(&http_client::stop, this, request, "Completed: Framed"));
+      return;
+    }
+    
+    read_content(request);
   } 
-  else if (err != asio::error::eof) 
+  else
   {
     logger.warn("Headers: " + err.message());
     request->add_error ("Error: " + err.message());
@@ -440,12 +557,169 @@ void http_client::handle_read_headers(
   }
 }
 
+bool http_client::check_content_type(http_request *request)
+{
+  if(request->get_request_type() != RequestType::GET)
+    return true;
+  
+  std::string type = request->get_header("Content-Type");
+  if(type.empty())
+  {
+    logger.debug("No Content-Type, sniffing: " + request->get_server() + 
+      request->get_path());
+    sniffing = true;
+    return true;
+  }
+  
+  boost::to_lower(type);
+  if(type.find("text/html") == 0 || type.find("application/xhtml+xml") == 0)
+    return true;
+  
+  logger.info("Not HTML (" + type + "): " + request->get_server() + 
+    request->get_path());
+  request->should_blacklist(true, "Probably not html");
+  return false;
+}
+
+bool http_client::sniff_content(http_request *request, bool finished)
+{
+  // Same window browsers use for content sniffing
+  static const std::size_t sniff_size = 512;
+  
+  if(!sniffing)
+    return true;
+  
+  if(!finished && !body.is_complete() && 
+     request->get_data().size() < sniff_size)
+    return true;
+  
+  sniffing = false;
+  if(looks_like_html(request->get_data().prefix(sniff_size)))
+    return true;
+  
+  logger.info("Sniffed, not HTML: " + request->get_server() + 
+    request->get_path());
+  request->should_blacklist(true, "Probably not html");
+  return false;
+}
+
+bool http_client::looks_like_html(const std::string &data)
+{
+  static const char *tags[] = { "<!doctype html", "<html", "<head", 
+    "<script", "<iframe", "<h1", "<div", "<font", "<table", "<a", "<style",
+    "<title", "<b", "<body", "<br", "<p" };
+  
+  std::size_t start = 0;
+  if(data.compare(0, 3, "\xEF\xBB\xBF") == 0) // UTF-8 BOM
+    start = 3;
+  start = data.find_first_not_of(" \t\r\n\f", start);
+  if(start == std::string::npos)
+    return false;
+  
+  std::string prefix = data.substr(start, 16);
+  boost::to_lower(prefix);
+  
+  if(prefix.compare(0, 4, "<!--") == 0)
+    return true;
+  
+  for(const char *tag : tags)
+  {
+    std::size_t len = std::strlen(tag);
+    // The tag name must end there, "<a" does not match "<abbr"
+    if(prefix.size() > len && prefix.compare(0, len, tag) == 0 &&
+       (prefix[len] == ' ' || prefix[len] == '>'))
+      return true;
+  }
+  return false;
+}
+
+void http_client::take_content(http_request *request)
+{
+  asio::streambuf &buf = request->get_response_buf();
+  std::size_t used = take_content(request, 
+    asio::buffer_cast<const char*>(buf.data()), buf.size());
+  buf.consume(used);
+}
+
+std::size_t http_client::take_content(
+  http_request *request, 
+  const char *data, 
+  std::size_t size)
+{
+  bool failed = body.has_error() || content.has_error();
+  std::size_t used = body.decode(data, size, content);
+  
+  if(failed)
+    return used;
+  
+  if(body.has_error())
+  {
+    logger.warn("Body: " + body.get_error());
+    request->add_error("Error: " + body.get_error());
+  }
+  
+  if(content.has_error())
+  {
+    logger.warn("Content: " + content.get_error());
+    request->add_error("Error: " + content.get_error());
+  }
+  return used;
+}
+
+void http_client::read_content(http_request *request)
+{
+  // An uncompressed body is read straight into the request's blocks and
+  // stays where it lands, chunk sizes are moved out from between the data
+  if(content.get_encoding() == ContentEncoding::IDENTITY)
+  {
+    asio::mutable_buffers_1 space = request->get_data().prepare();
+    conn->async_read_some(space, strand.wrap( bind( 
+      &http_client::handle_read_body, this, asio::placeholders::error, 
+      asio::placeholders::bytes_transferred, 
+      asio::buffer_cast<const char*>(space), request, conn ) ) );
+    return;
+  }
+  
+  conn->async_read( request->get_response_buf(), asio::transfer_at_least(1), 
+    strand.wrap( bind( &http_client::handle_read_content, this, 
+      asio::placeholders::error, request, conn ) ) );
+}
+
+void http_client::handle_read_body(
+  const system::error_code &err, 
+  std::size_t bytes,
+  const char *data,
+  http_request *request,
+  connection_ptr c)
+{
+  if(stopped || c != conn)
+    return;
+  
+  take_content(request, data, bytes);
+  content_read(err, request);
+}
+
 void http_client::handle_read_content(
+  const system::error_code &err, 
+  http_request *request,
+  connection_ptr c)
+{
+  if(stopped || c != conn)
+    return;
+  
+  take_content(request);
+  content_read(err, request);
+}
+
+void http_client::content_read(
   const system::error_code &err, 
   http_request *request)
 {
-  if(stopped)
+  if(!sniff_content(request, false))
+  {
+    strand.post(bind(&http_client::stop, this, request, "Sniffed: Not html"));
     return;
+  }
   
   if(!err)
   {
@@ -456,31 +730,30 @@ void http_client::handle_read_content(
       logger.warn("Requested content");
     }
     
-    std::ostringstream ss;
-    ss << &request->get_response_buf();
-    request->get_data().append(ss.str());
-
-    if(request->get_protocol() == "https")
+    if(body.is_complete() || body.has_error() || content.has_error())
     {
-      //logger.trace("https read_content");
-      asio::async_read(ssl_sock, request->get_response_buf(), asio::transfer_at_least(1),
-        strand.wrap( bind(&http_client::handle_read_content, this,
-          asio::placeholders::error, request ) ) );
-    } else {
-      asio::async_read(socket, request->get_response_buf(), asio::transfer_at_least(1),
-        strand.wrap( bind(&http_client::handle_read_content, this,
-          asio::placeholders::error, request ) ) );
+      logger.debug("Read Request completed: " + request->get_server() + request->get_path());
+      strand.post(bind(&http_client::stop, this, request, "Completed: Framed"));
+      return;
     }
+    
+    read_content(request);
   } 
   else if (err.category() == asio::error::get_ssl_category() &&
     err.value() == ERR_PACK(ERR_LIB_SSL, 0, SSL_R_SHORT_READ)) {
+      body.finish();
+      if(body.has_error())
+        request->add_error("Error: " + body.get_error());
       //stop(request, "ssl short read: completed");
       strand.post(bind(&http_client::stop, this, request, "SSL Shortread: completed"));
   } else if (err == asio::error::eof) {
+      body.finish();
+      if(body.has_error())
+        request->add_error("Error: " + body.get_error());
       logger.debug("Read Request completed: " + request->get_server() + request->get_path());
       //stop(request, "Completed: EOF");
       strand.post(bind(&http_client::stop, this, request, "Completed: EOF"));
-  } else if (err != asio::error::eof && err != 0) {
+  } else {
       logger.debug("Read Content Error: " + err.message());
       request->add_error ("Error: " + err.message());
       strand.post(bind(&http_client::stop, this, request, "Completed: Not EOF"));
@@ -34,6 +34,13 @@
 #include <boost/asio/ssl.hpp>
 #include <map>
 #include <memory>
+#include "connection.hpp"
+#include "connection_cache.hpp"
+#include "content_decoder.hpp"
+#include "dns_cache.hpp"
+#include "http_body_decoder.hpp"
+#include "tls_session_cache.hpp"
+#include "url.hpp"
 #include "logger/logger.hpp"
 
 class http_request;
@@ -44,30 +51,58 @@ using namespace boost;
 class http_client
 {
 public:
-  http_client(asio::io_service &io_service);
+  /**
+   * @param max_body_size Most decoded body bytes accepted for one response
+   */
+  http_client(asio::io_service &io_service,
+    connection_cache &connections,
+    dns_cache &dns,
+    tls_session_cache &tls,
+    std::size_t max_body_size);
   
   virtual ~http_client();
   
+  /**
+   * Queue a request on this client's strand
+   * Safe to call from any thread
+   */
+  void post_request(http_request *request);
+  
+  /**
+   * Start a request, must be called on this client's strand
+   */
   void make_request(http_request *request);
 
 private:
   asio::io_service &io_service;
-  tcp::socket socket;
   asio::strand strand;
-  tcp::resolver resolver;
   Logger logger;
-  asio::ssl::context sslctx;
-  asio::ssl::stream<tcp::socket&> ssl_sock;
   asio::deadline_timer deadline;
+  connection_cache &connections;
+  dns_cache &dns;
+  tls_session_cache &tls;
+  dns_cache::endpoints_ptr endpoints;
+  // The request's server without its port, for DNS and SNI
+  std::string host;
+  connection_ptr conn;
+  http_body_decoder body;
+  content_decoder content;
+  std::size_t max_body_size;
   std::size_t redirect_count = 0;
+  std::size_t deadline_id = 0;
   bool stopped = false;
   bool requested_content = false;
+  bool reused = false;
+  bool keep_alive = false;
+  bool sniffing = false;
 
   void stop(
     http_request *request, 
     std::string from);
   
-  void check_deadline(http_request *request);
+  void check_deadline(
+    http_request *request,
+    std::size_t id);
 
   bool always_verify(
     bool preverfied,
@@ -76,42 +111,124 @@ private:
     logger.trace("always verify!");
     return true;
   }
-    
-  void ssl_shutdown_handler(
-    const system::error_code &err,
-    http_request *request)
-    {
-      logger.trace("ssl shutdown");
-      ssl_sock.lowest_layer().close();
-      return;
-    }
+  
+  /**
+   * Write the request line and headers into the request buffer
+   */
+  void build_request(http_request *request);
+  
+  /**
+   * Resolve and connect a new connection for the request
+   */
+  void open_connection(http_request *request);
+  
+  /**
+   * A kept alive connection was closed by the server before it answered,
+   * send the request again over a new connection
+   */
+  void retry_request(http_request *request);
+  
+  /**
+   * Return the connection to the cache if the response was fully read and
+   * the server allows it, otherwise close it
+   */
+  void release_connection();
+  
+  /**
+   * Decide how the response body is delimited and decoded from the 
+   * parsed headers
+   */
+  void set_framing(http_request *request);
+  
+  /**
+   * Check the Content-Type of a page GET, blacklist it when not html
+   * Starts sniffing the body when the header is missing
+   * @return false if the transfer should be aborted
+   */
+  bool check_content_type(http_request *request);
+  
+  /**
+   * Decide from the first body bytes whether a page without a Content-Type
+   * is html, once enough has arrived or the body ended
+   * @param finished true if no more body will arrive
+   * @return false if the transfer should be aborted
+   */
+  bool sniff_content(http_request *request, bool finished);
+  
+  /**
+   * @return true if data starts like an html document
+   */
+  bool looks_like_html(const std::string &data);
+  
+  /**
+   * Decode the body bytes waiting in the response buffer
+   */
+  void take_content(http_request *request);
+  
+  /**
+   * Decode body bytes that were read
+   * @return Bytes used, the rest is past the end of the body
+   */
+  std::size_t take_content(
+    http_request *request, 
+    const char *data, 
+    std::size_t size);
+  
+  void write_request(http_request *request);
+  
+  void read_content(http_request *request);
 
   void handle_resolve(
     const system::error_code &err, 
-    tcp::resolver::iterator endpoint_it, 
-    http_request *request);
+    dns_cache::endpoints_ptr endpoints, 
+    http_request *request,
+    connection_ptr c);
 
   void handle_connect(
     const system::error_code &err, 
-    http_request *request);
+    http_request *request,
+    connection_ptr c);
 
   void handle_handshake(
     const system::error_code &err, 
-    http_request *request);
+    http_request *request,
+    connection_ptr c);
 
   void handle_write_request(
     const system::error_code &err, 
-    http_request *request);
+    http_request *request,
+    connection_ptr c);
 
   void handle_read_status_line(
     const system::error_code &err, 
-    http_request *request);
+    http_request *request,
+    connection_ptr c);
 
   void handle_read_headers(
     const system::error_code &err, 
-    http_request *request);
+    http_request *request,
+    connection_ptr c);
 
   void handle_read_content(
+    const system::error_code &err, 
+    http_request *request,
+    connection_ptr c);
+  
+  /**
+   * A read straight into the request's body blocks finished
+   * @param data Where the bytes were read to
+   */
+  void handle_read_body(
+    const system::error_code &err, 
+    std::size_t bytes,
+    const char *data,
+    http_request *request,
+    connection_ptr c);
+  
+  /**
+   * Finish the response or read more once read bytes are decoded
+   */
+  void content_read(
     const system::error_code &err, 
     http_request *request);
 };
@@ -22,21 +22,17 @@
  */
 
 #include "request_reciver.hpp"
-#include <boost/algorithm/string/case_conv.hpp>
-#include <boost/algorithm/string/replace.hpp>
-#include <cstdlib>
+#include <boost/algorithm/string/predicate.hpp>
 
 
 
 http_request::http_request(
   request_reciver &reciver, 
-  std::string server,
-  std::string path,
-  std::string protocol)
-  : server(server),
-    path(path),
-    protocol(protocol),
-    org(server, path, protocol),
+  const compact_url &link)
+  : server(link.get_host()),
+    path(link.get_path().to_string()),
+    protocol(link.get_protocol()),
+    org(link),
     reciver(&reciver),
     logger("http_request")
 {
@@ -47,11 +43,84 @@ http_request::http_request(
 
 http_request::~http_request() {}
 
+void http_request::reset(request_reciver &reciver, const compact_url &link)
+{
+  clear();
+  
+  server = link.get_host();
+  boost::string_ref link_path = link.get_path();
+  path.assign(link_path.data(), link_path.size());
+  protocol = link.get_protocol();
+  org = link;
+  this->reciver = &reciver;
+  if(this->protocol == "https")
+    set_port(443);
+}
+
+void http_request::clear()
+{
+  data.clear();
+  request.clear();
+  http_version = "NULL";
+  blacklist_reason = "default";
+  // Lets go of the path's arena chunk
+  org = compact_url();
+  port = 80;
+  wire_bytes = 0;
+  type = RequestType::GET;
+  reset_buffers();
+  reset_headers();
+  reset_errors();
+  status_code = 0;
+  requestCompleted = false;
+  blacklist = false;
+  timed_out = false;
+  redirected = false;
+}
+
 void http_request::call_request_reciver(http_request *r) 
 { 
   reciver->receive_http_request(r); 
 }
 
+void http_request::add_header(const std::string &header)
+{
+  if(spare_headers.empty())
+  {
+    headers.push_back(header);
+    return;
+  }
+  
+  headers.push_back(std::move(spare_headers.back()));
+  spare_headers.pop_back();
+  headers.back().assign(header);
+}
+
+void http_request::reset_headers()
+{
+  for(auto &header : headers)
+    spare_headers.push_back(std::move(header));
+  headers.clear();
+}
+
+std::string http_request::get_header(boost::string_ref name) const
+{
+  for(auto &header : headers)
+  {
+    std::size_t found = header.find(':');
+    if(found != name.size() || 
+       !boost::iequals(boost::string_ref(header.data(), found), name))
+      continue;
+    
+    std::size_t begin = header.find_first_not_of(" \t\r\n", found + 1);
+    if(begin == std::string::npos)
+      return "";
+    std::size_t end = header.find_last_not_of(" \t\r\n");
+    return header.substr(begin, end - begin + 1);
+  }
+  
+  return "";
+}
 
 std::vector<std::string> http_request::get_links()
 {
@@ -60,95 +129,50 @@ std::vector<std::string> http_request::get_links()
   if(get_data().size() == 0)
     return links;
   
-  GumboOutput *output = gumbo_parse(get_data().c_str());
-  search_for_links(output->root, links);
-  gumbo_destroy_output(&kGumboDefaultOptions, output);
+  extractor.reset();
+  for(std::size_t i = 0; i < data.blocks(); i++)
+    extractor.feed(data.block(i).data(), data.block(i).size());
+  
+  std::string page = get_protocol() + "://" + get_server() + get_path();
+  url::parts base = url::split(page);
+  std::string scratch;
+  
+  // A <base href> is itself relative to the page
+  std::string base_url;
+  if(!extractor.get_base().empty() && 
+    url::resolve(base, extractor.get_base(), base_url))
+    base = url::split(base_url);
+  
+  if(extractor.get_nofollow())
+    logger.debug("nofollow: " + page);
+  else
+    for(auto &href : extractor.get_hrefs())
+      add_link(base, href, scratch, links);
+  
+  if(!extractor.get_canonical().empty())
+    add_link(base, extractor.get_canonical(), scratch, links);
   
   return links;
 }
 
-void http_request::search_for_links(GumboNode *node, std::vector<std::string> &links)
+void http_request::add_link(
+  const url::parts &base,
+  const std::string &ref,
+  std::string &scratch,
+  std::vector<std::string> &links)
 {
-  if(node->type != GUMBO_NODE_ELEMENT)
-    return;
-  
-  GumboAttribute *href;
-  if(node->v.element.tag == GUMBO_TAG_A &&
-    (href = gumbo_get_attribute(&node->v.element.attributes, "href")))
-  { // Minimal normilization
-    std::size_t found = std::string::npos;
-    std::string link = href->value;
-    
-    link = boost::algorithm::replace_all_copy(link, "..", "");
-    
-    if(link[0] == '/' && link[1] == '/')
-    {
-      logger.trace("Fixing link: " + link);
-      link.erase(0,2);
-      link.insert(0, "http://");
-    }
-    
-    if(link[0] == '/')
-    {
-      logger.trace("Fixing link: " + link);
-      link.insert(0, get_server());
-    }
-
-    if(link.find(get_server()) == std::string::npos && link.find("://") == std::string::npos)
-    {
-      logger.trace("Fixing link: " + link);
-      link.insert(0, get_server() + "/");
-    }
-
-    found = link.find("#");
-    if(found != std::string::npos)
-    {
-      logger.trace("Dropping link: " + link);
-      return;
-    }
-
-    found = link.find("?");
-    if(found != std::string::npos)
-    {
-      logger.trace("Dropping link: " + link);
-      return;
-    }
-
-    if( (found = link.find("javascript:")) != std::string::npos)
-    {
-      logger.debug("Dropping link: "+ link);
-      return;
-    }
-
-    found = link.find("%");
-    if(found != std::string::npos)
-    {
-      if(!isdigit(link[found + 1]))
-      {
-        link[found + 1] = toupper(link[found + 1]);
-        logger.debug("Normalilzed: " + link);
-      }
-      if(!isdigit(link[found + 2]))
-      {
-        link[found + 2] = toupper(link[found + 1]);
-        logger.debug("Normalilzed: " + link);
-      }
-    }
-
-    found = link.find(":80");
-    if(found != std::string::npos)
-    {
-      std::string before = link.substr(0, found);
-      std::string after = link.substr(found + 3, link.length());
-      link = before + after;
-      logger.debug("Normailzed: " + link);
-    }
-    
-    logger.trace("Adding link: " + link);
-    links.push_back(link);
+  // Drops javascript:, mailto: and anything else that is not http(s)
+  if(!url::resolve(base, ref, scratch))
+  {
+    logger.trace("Dropping link: " + ref);
+  }
+  else if(scratch.find('?') != std::string::npos)
+  { // We don't crawl queries
+    logger.trace("Dropping link: " + scratch);
+  } 
+  else 
+  {
+    logger.trace("Adding link: " + scratch);
+    links.push_back(scratch);
   }
-  
-  GumboVector *children = &node->v.element.children;
-  for(std::size_t i = 0; i < children->length; ++i)
-    search_for_links(static_cast<GumboNode*>(children->data[i]), links);
 }
@@ -25,25 +25,41 @@
 #define _WC_HTTP_REQUEST_H_
 
 #include <boost/asio.hpp>
-#include <gumbo.h>
 #include <string>
 #include <vector>
 #include <memory>
-#include <tuple>
+#include "body_sink.hpp"
+#include "buffer_chain.hpp"
+#include "compact_url.hpp"
+#include "link_extractor.hpp"
+#include "url.hpp"
 #include "logger/logger.hpp"
 
 enum class RequestType { HEAD, GET, ROBOT_HEAD, ROBOT_GET };
 class request_reciver;
 
-class http_request
+class http_request : public body_sink
 {
 public:
-  http_request(request_reciver &reciver,
-    std::string server, 
-    std::string path,
-    std::string protocol);
+  /**
+   * @param link The link to request, kept as the original settings
+   */
+  http_request(request_reciver &reciver, const compact_url &link);
   
   virtual ~http_request();
+  
+  /**
+   * Make this a new request for link, as if it had just been constructed.
+   * Buffers, the header and error lists and the body's block list keep 
+   * their capacity
+   */
+  void reset(request_reciver &reciver, const compact_url &link);
+  
+  /**
+   * Forget everything about the last request and give the body's blocks
+   * back, keeping capacity
+   */
+  void clear();
 
   /**
    * Send the completed http_request to the caller
@@ -63,7 +79,7 @@ public:
   /**
    * @return server associated with this http_request
    */
-  std::string get_server() const { return this->server; }
+  const std::string& get_server() const { return this->server; }
   
   /**
    * @param server Server associated with this http_request
@@ -73,7 +89,7 @@ public:
   /**
    * @return Path/Resource associated with this http_request
    */
-  std::string get_path() const { return this->path; }
+  const std::string& get_path() const { return this->path; }
   
   /**
    * @param path Path/Resource associated with this http_request
@@ -101,19 +117,49 @@ public:
   void set_status_code(int code) { this->status_code = code; }
   
   /**
-   * @return The raw data that the server returned
+   * @return The body that the server returned, in pool blocks
+   */
+  buffer_chain& get_data() { return this->data; }
+  
+  /**
+   * Append decoded body bytes to the data, bytes read into 
+   * get_data().prepare() are kept where they are
    */
-  std::string& get_data() { return this->data; }
+  void append_body(const char *data, std::size_t size)
+  {
+    this->data.append(data, size);
+  }
   
   /**
-   * @param header The header to add
+   * @return Bytes of body received before Content-Encoding was decoded
    */
-  void add_header(std::string header) { this->headers.push_back(header); }
+  std::size_t get_wire_bytes() const { return this->wire_bytes; }
+  
+  /**
+   * @param bytes Bytes of body received before Content-Encoding was decoded
+   */
+  void set_wire_bytes(std::size_t bytes) { this->wire_bytes = bytes; }
+  
+  /**
+   * @param header The header to add, copied into the string of a header
+   *  forgotten by reset_headers() when there is one
+   */
+  void add_header(const std::string &header);
   
   /**
    * @return A vector of the headers that the server responded with
    */
-  std::vector<std::string> get_headers() const { return this->headers; }
+  const std::vector<std::string>& get_headers() const 
+  { 
+    return this->headers; 
+  }
+  
+  /**
+   * @param name The header to look for, case insensitive
+   * @return The header's value with surrounding whitespace removed, 
+   * or an empty string if the server didn't send it
+   */
+  std::string get_header(boost::string_ref name) const;
   
   /**
    * @param request The http request to make
@@ -162,7 +208,10 @@ public:
   RequestType get_request_type() { return this->type; }
   
   /**
-   * @return all links to other pages
+   * Scan the body for links, slow on a large page: the crawler calls it
+   * on a parse_pool thread
+   * @return all links to other pages, resolved against the page's base URL
+   *  and normalized
    */
   std::vector<std::string> get_links();
 
@@ -173,16 +222,19 @@ public:
   {
     response_buf.consume(response_buf.size());
     request_buf.consume(request_buf.size());
+    extractor.reset();
   }
 
+  /**
+   * Forget the headers of a previous response, their strings are kept for
+   * the next ones
+   */
+  void reset_headers();
+
   /**
    * Reset Errors
    */
-  void reset_errors()
-  {
-    while(!errors.empty())
-      errors.pop_back();
-  }
+  void reset_errors() { errors.clear(); }
 
   /**
    * @return True if the request completed, false if it is in progress
@@ -212,7 +264,7 @@ public:
   /**
    * @return This request's protocol
    */
-  std::string get_protocol() const { return this->protocol; }
+  const std::string& get_protocol() const { return this->protocol; }
   
   /**
    * @param blacklist true if the URL should be blacklisted, false if not
@@ -248,26 +300,29 @@ public:
   
   void set_redirected(bool redirect) { this->redirected = redirect; }
 
-  std::tuple<std::string,std::string,std::string> get_orignial_settings()
-  {
-    return org;
-  }
+  /**
+   * @return The link this request was made for, before any redirect
+   */
+  const compact_url& get_orignial_settings() const { return org; }
 
 private:
   std::string server = "NULL";
   std::string path = "NULL";
-  std::string data;
+  buffer_chain data;
   std::string request;
   std::string http_version = "NULL";
   std::string protocol = "http";
   std::string blacklist_reason = "default";
-  std::tuple<std::string,std::string,std::string> org;
+  compact_url org;
   unsigned int port = 80;
+  std::size_t wire_bytes = 0;
   RequestType type = RequestType::GET;
   boost::asio::streambuf response_buf;
   boost::asio::streambuf request_buf;
+  link_extractor extractor;
   std::vector<std::string> errors;
   std::vector<std::string> headers;
+  std::vector<std::string> spare_headers;
   int status_code = 0;
   bool requestCompleted = false;
   bool blacklist = false;
@@ -276,7 +331,16 @@ private:
   request_reciver *reciver;
   Logger logger;
   
-  void search_for_links(GumboNode *node, std::vector<std::string> &links);
+  /**
+   * Resolve a link found on this page and add it if it is crawlable
+   * @param base The URL links on this page are relative to, split
+   * @param scratch Buffer reused for every link
+   */
+  void add_link(
+    const url::parts &base,
+    const std::string &ref,
+    std::string &scratch,
+    std::vector<std::string> &links);
 };
 
 #endif
@@ -0,0 +1,611 @@
+/*
+ * WebCrawler: link_extractor.cxx
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file link_extractor.cxx
+ * @author Kyle Givler
+ */
+
+#include "link_extractor.hpp"
+#include "byte_scanner.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+  // Longest unfinished token kept between pieces, a longer one is dropped
+  const std::size_t max_pending = 1024 * 1024;
+  
+  bool is_space(char c)
+  {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\f' || c == '\r';
+  }
+  
+  bool is_alpha(char c)
+  {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+  }
+  
+  bool is_alnum(char c)
+  {
+    return is_alpha(c) || (c >= '0' && c <= '9');
+  }
+  
+  char lower(char c)
+  {
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+  }
+  
+  bool iequals(boost::string_ref a, const char *b)
+  {
+    std::size_t len = std::strlen(b);
+    if(a.size() != len)
+      return false;
+    for(std::size_t i = 0; i < len; i++)
+      if(lower(a[i]) != b[i])
+        return false;
+    return true;
+  }
+  
+  void append_utf8(std::uint32_t cp, std::string &out)
+  {
+    if(cp < 0x80)
+      out += static_cast<char>(cp);
+    else if(cp < 0x800)
+    {
+      out += static_cast<char>(0xc0 | (cp >> 6));
+      out += static_cast<char>(0x80 | (cp & 0x3f));
+    }
+    else if(cp < 0x10000)
+    {
+      out += static_cast<char>(0xe0 | (cp >> 12));
+      out += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+      out += static_cast<char>(0x80 | (cp & 0x3f));
+    }
+    else
+    {
+      out += static_cast<char>(0xf0 | (cp >> 18));
+      out += static_cast<char>(0x80 | ((cp >> 12) & 0x3f));
+      out += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+      out += static_cast<char>(0x80 | (cp & 0x3f));
+    }
+  }
+  
+  // Numeric references to 0x80-0x9F mean windows-1252, 0 if unmapped
+  const std::uint16_t windows_1252[32] = {
+    0x20ac, 0, 0x201a, 0x0192, 0x201e, 0x2026, 0x2020, 0x2021,
+    0x02c6, 0x2030, 0x0160, 0x2039, 0x0152, 0, 0x017d, 0,
+    0, 0x2018, 0x2019, 0x201c, 0x201d, 0x2022, 0x2013, 0x2014,
+    0x02dc, 0x2122, 0x0161, 0x203a, 0x0153, 0, 0x017e, 0x0178 };
+  
+  struct entity
+  {
+    const char *name;
+    std::uint32_t cp;
+    bool legacy; // Recognized without its ';'
+  };
+  
+  // The references that turn up in URLs, others are left as they are
+  const entity entities[] = {
+    { "amp", '&', true }, { "lt", '<', true }, { "gt", '>', true },
+    { "quot", '"', true }, { "apos", '\'', false }, 
+    { "nbsp", 0xa0, true }, { "sol", '/', false }, 
+    { "quest", '?', false }, { "equals", '=', false }, 
+    { "num", '#', false }, { "percnt", '%', false }, 
+    { "colon", ':', false }, { "period", '.', false } };
+}
+
+link_extractor::link_extractor()
+{
+  reset();
+}
+
+void link_extractor::reset()
+{
+  state = State::DATA;
+  pending.clear();
+  raw_tag.clear();
+  comment_tail[0] = comment_tail[1] = 0;
+  hrefs.clear();
+  base.clear();
+  canonical.clear();
+  has_base = false;
+  nofollow = false;
+  noindex = false;
+}
+
+void link_extractor::feed(const char *data, std::size_t size)
+{
+  if(state == State::PLAINTEXT)
+    return;
+  
+  if(pending.empty())
+  {
+    scan(data, data + size);
+    return;
+  }
+  
+  // Finish the split token with the new piece
+  std::string joined;
+  joined.swap(pending);
+  joined.append(data, size);
+  scan(joined.data(), joined.data() + joined.size());
+}
+
+void link_extractor::scan(const char *p, const char *end)
+{
+  while(p < end)
+  {
+    switch(state)
+    {
+      case State::DATA:
+      {
+        const char *q = static_cast<const char*>(std::memchr(p, '<', 
+          end - p));
+        if(!q)
+          return;
+        
+        std::size_t used = markup(q, end);
+        if(used == 0)
+        {
+          if(static_cast<std::size_t>(end - q) < max_pending)
+          {
+            pending.assign(q, end);
+            return;
+          }
+          // Too long to be a tag worth reading, skip to its end
+          state = State::BOGUS;
+          used = 1;
+        }
+        p = q + used;
+        break;
+      }
+      
+      case State::COMMENT:
+      {
+        const char *q = static_cast<const char*>(std::memchr(p, '>', 
+          end - p));
+        if(!q)
+        {
+          if(end - p >= 2)
+            comment_tail[0] = end[-2];
+          else
+            comment_tail[0] = comment_tail[1];
+          comment_tail[1] = end[-1];
+          return;
+        }
+        
+        // "-->" may be split across pieces
+        char a = q - p >= 2 ? q[-2] : (q - p == 1 ? comment_tail[1] : 
+          comment_tail[0]);
+        char b = q - p >= 1 ? q[-1] : comment_tail[1];
+        if(a == '-' && b == '-')
+          state = State::DATA;
+        comment_tail[0] = b;
+        comment_tail[1] = '>';
+        p = q + 1;
+        break;
+      }
+      
+      case State::BOGUS:
+      {
+        const char *q = static_cast<const char*>(std::memchr(p, '>', 
+          end - p));
+        if(!q)
+          return;
+        state = State::DATA;
+        p = q + 1;
+        break;
+      }
+      
+      case State::RAWTEXT:
+        p += raw_text(p, end);
+        if(!pending.empty())
+          return;
+        break;
+      
+      case State::PLAINTEXT:
+        return;
+    }
+  }
+}
+
+std::size_t link_extractor::markup(const char *p, const char *end)
+{
+  std::size_t left = end - p;
+  if(left < 2)
+    return 0;
+  
+  char c = p[1];
+  if(c == '!')
+  {
+    static const char open[] = "<!--";
+    std::size_t n = std::min<std::size_t>(left, 4);
+    if(std::memcmp(p, open, n) == 0)
+    {
+      if(n < 4)
+        return 0;
+      // "<!-->" and "<!--->" are whole comments
+      state = State::COMMENT;
+      comment_tail[0] = comment_tail[1] = '-';
+      return 4;
+    }
+    // Doctypes and CDATA outside foreign content end at the next '>'
+    state = State::BOGUS;
+    return 2;
+  }
+  
+  if(c == '/')
+  {
+    if(left < 3)
+      return 0;
+    if(is_alpha(p[2]))
+    {
+      std::size_t used = read_tag(p + 2, end, true);
+      return used ? used + 2 : 0;
+    }
+    if(p[2] == '>')
+      return 3;
+    state = State::BOGUS;
+    return 2;
+  }
+  
+  if(c == '?')
+  {
+    state = State::BOGUS;
+    return 1;
+  }
+  
+  if(is_alpha(c))
+  {
+    std::size_t used = read_tag(p + 1, end, false);
+    return used ? used + 1 : 0;
+  }
+  
+  // A '<' in the text
+  return 1;
+}
+
+std::size_t link_extractor::read_tag(const char *p, const char *end, 
+  bool closing)
+{
+  const char *q = byte_scanner::tag_stop(p, end, true, false);
+  if(q == end)
+    return 0;
+  
+  boost::string_ref name(p, q - p);
+  Tag kind = closing ? Tag::OTHER : classify(name);
+  attributes attrs;
+  // Only these tags' attributes are looked at, the rest are skipped over
+  bool wanted = kind == Tag::A || kind == Tag::BASE || kind == Tag::LINK ||
+    kind == Tag::META;
+  
+  while(true)
+  {
+    while(q < end && (is_space(*q) || *q == '/'))
+      q++;
+    if(q == end)
+      return 0;
+    if(*q == '>')
+    {
+      q++;
+      break;
+    }
+    
+    // An '=' starting a name is part of it
+    const char *start = q++;
+    q = byte_scanner::tag_stop(q, end, true, true);
+    boost::string_ref attr(start, q - start);
+    
+    while(q < end && is_space(*q))
+      q++;
+    if(q == end)
+      return 0;
+    
+    boost::string_ref value;
+    if(*q == '=')
+    {
+      q++;
+      while(q < end && is_space(*q))
+        q++;
+      if(q == end)
+        return 0;
+      
+      if(*q == '"' || *q == '\'')
+      {
+        const char *close = static_cast<const char*>(std::memchr(q + 1, *q,
+          end - q - 1));
+        if(!close)
+          return 0;
+        value = boost::string_ref(q + 1, close - q - 1);
+        q = close + 1;
+      }
+      else if(*q != '>')
+      {
+        const char *start = q;
+        q = byte_scanner::tag_stop(q, end, false, false);
+        if(q == end)
+          return 0;
+        value = boost::string_ref(start, q - start);
+      }
+    }
+    
+    // The first of a repeated attribute is the one kept
+    if(!wanted || attr.size() > 7)
+      continue;
+    if(!attrs.has_href && iequals(attr, "href"))
+    {
+      attrs.href = value;
+      attrs.has_href = true;
+    }
+    else if(!attrs.has_rel && iequals(attr, "rel"))
+    {
+      attrs.rel = value;
+      attrs.has_rel = true;
+    }
+    else if(!attrs.has_name && iequals(attr, "name"))
+    {
+      attrs.name = value;
+      attrs.has_name = true;
+    }
+    else if(!attrs.has_content && iequals(attr, "content"))
+    {
+      attrs.content = value;
+      attrs.has_content = true;
+    }
+  }
+  
+  if(kind != Tag::OTHER)
+    tag(kind, name, attrs);
+  
+  return q - p;
+}
+
+link_extractor::Tag link_extractor::classify(boost::string_ref name)
+{
+  // Sorted out by length first, most tags are none of these
+  switch(name.size())
+  {
+    case 1:
+      return lower(name[0]) == 'a' ? Tag::A : Tag::OTHER;
+    case 3:
+      return iequals(name, "xmp") ? Tag::RAWTEXT : Tag::OTHER;
+    case 4:
+      if(iequals(name, "base"))
+        return Tag::BASE;
+      if(iequals(name, "link"))
+        return Tag::LINK;
+      return iequals(name, "meta") ? Tag::META : Tag::OTHER;
+    case 5:
+      return iequals(name, "style") || iequals(name, "title") ? 
+        Tag::RAWTEXT : Tag::OTHER;
+    case 6:
+      return iequals(name, "script") || iequals(name, "iframe") ? 
+        Tag::RAWTEXT : Tag::OTHER;
+    case 7:
+      return iequals(name, "noembed") ? Tag::RAWTEXT : Tag::OTHER;
+    case 8:
+      return iequals(name, "textarea") || iequals(name, "noframes") ? 
+        Tag::RAWTEXT : Tag::OTHER;
+    case 9:
+      return iequals(name, "plaintext") ? Tag::PLAINTEXT : Tag::OTHER;
+    default:
+      return Tag::OTHER;
+  }
+}
+
+void link_extractor::tag(Tag kind, boost::string_ref name, 
+  const attributes &attrs)
+{
+  if(kind == Tag::A)
+  {
+    if(attrs.has_href)
+    {
+      hrefs.push_back(std::string());
+      decode(attrs.href, hrefs.back());
+    }
+    return;
+  }
+  
+  if(kind == Tag::BASE)
+  { // Only the first <base> with an href counts
+    if(!has_base && attrs.has_href)
+    {
+      decode(attrs.href, base);
+      has_base = true;
+    }
+    return;
+  }
+  
+  if(kind == Tag::LINK)
+  {
+    if(canonical.empty() && attrs.has_href && attrs.has_rel)
+    {
+      std::string rel;
+      decode(attrs.rel, rel);
+      if(has_token(rel, "canonical"))
+        decode(attrs.href, canonical);
+    }
+    return;
+  }
+  
+  if(kind == Tag::META)
+  {
+    if(!attrs.has_name || !attrs.has_content)
+      return;
+    
+    std::string meta_name, content;
+    decode(attrs.name, meta_name);
+    if(!has_token(meta_name, "robots"))
+      return;
+    
+    decode(attrs.content, content);
+    if(has_token(content, "nofollow") || has_token(content, "none"))
+      nofollow = true;
+    if(has_token(content, "noindex") || has_token(content, "none"))
+      noindex = true;
+    return;
+  }
+  
+  if(kind == Tag::PLAINTEXT)
+  {
+    state = State::PLAINTEXT;
+    return;
+  }
+  
+  // The name of a raw text element, lowered for its end tag
+  state = State::RAWTEXT;
+  raw_tag.resize(name.size());
+  std::transform(name.begin(), name.end(), raw_tag.begin(), lower);
+}
+
+std::size_t link_extractor::raw_text(const char *p, const char *end)
+{
+  // Only "</" + the element's name, then a space, '/' or '>', ends it
+  std::size_t need = 2 + raw_tag.size() + 1;
+  const char *q = p;
+  while(q < end)
+  {
+    // Only a '<' that may start "</" + the name's first letter stops it
+    q = byte_scanner::end_tag(q, end, raw_tag[0]);
+    if(q == end)
+      return end - p;
+    
+    std::size_t left = end - q;
+    bool match = true;
+    for(std::size_t i = 1; match && i < raw_tag.size() && 2 + i < left; i++)
+      match = lower(q[2 + i]) == raw_tag[i];
+    
+    if(match && left < need)
+    { // Maybe the end tag, decided with the next piece
+      pending.assign(q, end);
+      return end - p;
+    }
+    
+    if(match)
+    {
+      char after = q[need - 1];
+      if(is_space(after) || after == '/' || after == '>')
+      {
+        state = State::DATA;
+        return q - p;
+      }
+    }
+    q++;
+  }
+  return end - p;
+}
+
+void link_extractor::decode(boost::string_ref value, std::string &out)
+{
+  std::size_t i = 0;
+  while(i < value.size())
+  {
+    const char *amp = static_cast<const char*>(std::memchr(value.data() + i,
+      '&', value.size() - i));
+    if(!amp)
+    {
+      out.append(value.data() + i, value.size() - i);
+      return;
+    }
+    out.append(value.data() + i, amp - value.data() - i);
+    i = amp - value.data() + 1;
+    
+    if(i < value.size() && value[i] == '#')
+    {
+      std::size_t j = i + 1;
+      bool hex = j < value.size() && (value[j] == 'x' || value[j] == 'X');
+      if(hex)
+        j++;
+      
+      std::uint32_t cp = 0;
+      std::size_t digits = j;
+      for(; j < value.size(); j++)
+      {
+        char c = lower(value[j]);
+        int d;
+        if(c >= '0' && c <= '9')
+          d = c - '0';
+        else if(hex && c >= 'a' && c <= 'f')
+          d = c - 'a' + 10;
+        else
+          break;
+        cp = std::min<std::uint32_t>(cp * (hex ? 16 : 10) + d, 0x110000);
+      }
+      
+      if(j == digits)
+      { // Not a reference after all
+        out += '&';
+        continue;
+      }
+      if(j < value.size() && value[j] == ';')
+        j++;
+      
+      if(cp >= 0x80 && cp <= 0x9f && windows_1252[cp - 0x80])
+        cp = windows_1252[cp - 0x80];
+      if(cp == 0 || cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff))
+        cp = 0xfffd;
+      append_utf8(cp, out);
+      i = j;
+      continue;
+    }
+    
+    std::size_t j = i;
+    while(j < value.size() && is_alnum(value[j]))
+      j++;
+    boost::string_ref name(value.data() + i, j - i);
+    bool semicolon = j < value.size() && value[j] == ';';
+    
+    const entity *found = nullptr;
+    for(auto &e : entities)
+      if(name == e.name)
+        found = &e;
+    
+    // Without a ';' only the old names count, and not before an '='
+    if(found && !semicolon && 
+      (!found->legacy || (j < value.size() && value[j] == '=')))
+      found = nullptr;
+    
+    if(!found)
+    {
+      out += '&';
+      continue;
+    }
+    
+    append_utf8(found->cp, out);
+    i = semicolon ? j + 1 : j;
+  }
+}
+
+bool link_extractor::has_token(const std::string &list, const char *token)
+{
+  std::size_t i = 0;
+  while(i < list.size())
+  {
+    while(i < list.size() && (is_space(list[i]) || list[i] == ','))
+      i++;
+    std::size_t start = i;
+    while(i < list.size() && !is_space(list[i]) && list[i] != ',')
+      i++;
+    if(i > start && iequals(boost::string_ref(list.data() + start, 
+      i - start), token))
+      return true;
+  }
+  return false;
+}
@@ -0,0 +1,160 @@
+/*
+ * WebCrawler: link_extractor.hpp
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file link_extractor.hpp
+ * @author Kyle Givler
+ */
+
+#ifndef _WC_LINK_EXTRACTOR_H_
+#define _WC_LINK_EXTRACTOR_H_
+
+#include <boost/utility/string_ref.hpp>
+#include <string>
+#include <vector>
+
+/**
+ * Collects the links of an HTML page as its body arrives, without
+ * building a tree
+ * Follows the HTML tokenizer far enough to find tags where a parser 
+ * would: comments, doctypes and the text of script, style and the other
+ * raw text elements are skipped, attribute values have their character 
+ * references decoded. A tag split between two pieces of the body is kept 
+ * until the rest arrives
+ */
+class link_extractor
+{
+public:
+  link_extractor();
+  
+  /**
+   * Forget the page, ready for the next one
+   */
+  void reset();
+  
+  /**
+   * Scan the next piece of the page
+   */
+  void feed(const char *data, std::size_t size);
+  
+  /**
+   * @return The href of every <a>, in page order
+   */
+  const std::vector<std::string>& get_hrefs() const { return hrefs; }
+  
+  /**
+   * @return The href of the first <base>, empty if there is none
+   */
+  const std::string& get_base() const { return base; }
+  
+  /**
+   * @return The href of the first <link rel=canonical>, or empty
+   */
+  const std::string& get_canonical() const { return canonical; }
+  
+  /**
+   * @return true if a robots <meta> says not to follow the page's links
+   */
+  bool get_nofollow() const { return nofollow; }
+  
+  /**
+   * @return true if a robots <meta> says not to index the page
+   */
+  bool get_noindex() const { return noindex; }
+  
+private:
+  enum class State { DATA, COMMENT, BOGUS, RAWTEXT, PLAINTEXT };
+  
+  // The start tags that are acted on
+  enum class Tag { OTHER, A, BASE, LINK, META, RAWTEXT, PLAINTEXT };
+  
+  /**
+   * The attributes of a tag that are looked at, views into the page 
+   * before their character references are decoded
+   */
+  struct attributes
+  {
+    boost::string_ref href, rel, name, content;
+    bool has_href = false;
+    bool has_rel = false;
+    bool has_name = false;
+    bool has_content = false;
+  };
+  
+  State state;
+  // The start of a token that did not fit in the last piece
+  std::string pending;
+  // The raw text element whose end tag is looked for
+  std::string raw_tag;
+  // The last two bytes of a comment seen so far
+  char comment_tail[2];
+  
+  std::vector<std::string> hrefs;
+  std::string base;
+  std::string canonical;
+  bool has_base;
+  bool nofollow;
+  bool noindex;
+  
+  /**
+   * Scan a contiguous run of the page, keeping an unfinished token
+   */
+  void scan(const char *p, const char *end);
+  
+  /**
+   * Read markup starting at '<'
+   * @return Bytes used, 0 if the token does not end before end
+   */
+  std::size_t markup(const char *p, const char *end);
+  
+  /**
+   * Read a tag's name and attributes, p is past the '<' or "</"
+   * @param closing An end tag, it is only skipped
+   * @return Bytes used, 0 if the tag does not end before end
+   */
+  std::size_t read_tag(const char *p, const char *end, bool closing);
+  
+  /**
+   * @return Bytes to the end of the raw text element, or end - p with
+   *  the start of a possible end tag kept in pending
+   */
+  std::size_t raw_text(const char *p, const char *end);
+  
+  /**
+   * @return What a start tag's name is, in any case
+   */
+  static Tag classify(boost::string_ref name);
+  
+  /**
+   * Act on a start tag other than Tag::OTHER once it is read
+   */
+  void tag(Tag kind, boost::string_ref name, const attributes &attrs);
+  
+  /**
+   * Append an attribute value with its character references decoded
+   */
+  static void decode(boost::string_ref value, std::string &out);
+  
+  /**
+   * @return true if a whitespace or comma separated list holds token, 
+   *  ignoring case
+   */
+  static bool has_token(const std::string &list, const char *token);
+};
+
+#endif
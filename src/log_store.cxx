@@ -0,0 +1,784 @@
+/*
+ * WebCrawler: log_store.cxx
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file log_store.cxx
+ * @author Kyle Givler
+ */
+
+#include "log_store.hpp"
+#include "crawlerException.hpp"
+#include "url.hpp"
+#include <zlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+  const char magic[8] = { 'W', 'C', 'L', 'O', 'G', '0', '0', '1' };
+  
+  // crc, key length and value length
+  const std::size_t header_size = 12;
+  
+  // Value length of a deletion
+  const std::uint32_t tombstone = 0xffffffff;
+  
+  void put_u32(std::string &out, std::uint32_t v)
+  {
+    for(int i = 0; i < 4; i++)
+      out += static_cast<char>((v >> (8 * i)) & 0xff);
+  }
+  
+  void put_u64(std::string &out, std::uint64_t v)
+  {
+    for(int i = 0; i < 8; i++)
+      out += static_cast<char>((v >> (8 * i)) & 0xff);
+  }
+  
+  std::uint32_t get_u32(const char *p)
+  {
+    std::uint32_t v = 0;
+    for(int i = 3; i >= 0; i--)
+      v = (v << 8) | static_cast<unsigned char>(p[i]);
+    return v;
+  }
+  
+  std::uint64_t get_u64(const char *p)
+  {
+    std::uint64_t v = 0;
+    for(int i = 7; i >= 0; i--)
+      v = (v << 8) | static_cast<unsigned char>(p[i]);
+    return v;
+  }
+  
+  std::uint32_t checksum(const char *data, std::size_t size)
+  {
+    return crc32(crc32(0, Z_NULL, 0), 
+      reinterpret_cast<const Bytef*>(data), size);
+  }
+  
+  std::uint64_t record_size(std::size_t key, std::size_t value)
+  {
+    return header_size + key + value;
+  }
+  
+  /**
+   * Write all of data at offset
+   * @return false with errno set if it failed
+   */
+  bool write_all(int fd, std::uint64_t offset, const char *data, 
+    std::size_t size)
+  {
+    while(size > 0)
+    {
+      ssize_t n = ::pwrite(fd, data, size, offset);
+      if(n < 0 && errno == EINTR)
+        continue;
+      if(n <= 0)
+        return false;
+      data += n;
+      offset += n;
+      size -= n;
+    }
+    return true;
+  }
+  
+  /**
+   * @return Bytes read, short only at the end of the file, or -1
+   */
+  ssize_t read_all(int fd, std::uint64_t offset, char *out, std::size_t size)
+  {
+    std::size_t done = 0;
+    while(done < size)
+    {
+      ssize_t n = ::pread(fd, out + done, size - done, offset + done);
+      if(n < 0 && errno == EINTR)
+        continue;
+      if(n < 0)
+        return -1;
+      if(n == 0)
+        break;
+      done += n;
+    }
+    return done;
+  }
+  
+  CrawlerException io_error(std::string what)
+  {
+    return CrawlerException("log_store: " + what + ": " + 
+      std::strerror(errno));
+  }
+}
+
+log_store::log_store(std::string file, log_store_options options)
+  : file(file),
+    options(options),
+    logger("log_store")
+{
+  logger.setIgnoreLevel(Level::TRACE);
+  
+  fd = ::open(file.c_str(), O_RDWR | O_CREAT, 0644);
+  if(fd < 0)
+    throw(io_error("open " + file));
+  
+  try
+  {
+    load();
+  } catch (CrawlerException &e) {
+    ::close(fd);
+    fd = -1;
+    throw;
+  }
+}
+
+log_store::~log_store()
+{
+  close_db();
+}
+
+void log_store::load()
+{
+  char head[sizeof(magic)];
+  ssize_t n = read_all(fd, 0, head, sizeof(magic));
+  if(n < 0)
+    throw(io_error("read " + file));
+  
+  if(n == 0)
+  { // A new log
+    if(!write_all(fd, 0, magic, sizeof(magic)))
+      throw(io_error("write " + file));
+    file_size = sizeof(magic);
+    return;
+  }
+  
+  if(n != sizeof(magic) || !std::equal(magic, magic + sizeof(magic), head))
+    throw(CrawlerException("log_store: " + file + " is not a link log"));
+  
+  off_t end = ::lseek(fd, 0, SEEK_END);
+  if(end < 0)
+    throw(io_error("seek " + file));
+  
+  // Records are read in blocks, one may span two reads
+  std::string data;
+  std::size_t pos = 0;
+  std::uint64_t offset = sizeof(magic);
+  std::uint64_t read_offset = sizeof(magic);
+  bool eof = false;
+  
+  auto fill = [&](std::size_t need) {
+    while(data.size() - pos < need && !eof)
+    {
+      data.erase(0, pos);
+      pos = 0;
+      std::size_t have = data.size();
+      data.resize(have + std::max<std::size_t>(need, 4 * 1024 * 1024));
+      ssize_t got = read_all(fd, read_offset, &data[have], 
+        data.size() - have);
+      if(got < 0)
+        throw(io_error("read " + file));
+      data.resize(have + got);
+      read_offset += got;
+      eof = static_cast<std::size_t>(got) == 0;
+    }
+    return data.size() - pos >= need;
+  };
+  
+  std::size_t records = 0;
+  std::string key, value;
+  while(fill(1))
+  {
+    if(!fill(header_size))
+      break;
+    
+    const char *h = data.data() + pos;
+    std::uint32_t crc = get_u32(h);
+    std::uint32_t key_size = get_u32(h + 4);
+    std::uint32_t value_size = get_u32(h + 8);
+    bool erased = value_size == tombstone;
+    std::uint64_t body = key_size + (erased ? 0 : value_size);
+    
+    // A torn header may claim any length
+    if(offset + header_size + body > static_cast<std::uint64_t>(end) ||
+      !fill(header_size + body))
+      break;
+    
+    h = data.data() + pos;
+    if(checksum(h + 4, header_size - 4 + body) != crc)
+      break;
+    
+    key.assign(h + header_size, key_size);
+    value.assign(h + header_size + key_size, erased ? 0 : value_size);
+    apply(key, value, offset + header_size + key_size, erased);
+    
+    pos += header_size + body;
+    offset += header_size + body;
+    records++;
+  }
+  
+  file_size = offset;
+  if(static_cast<std::uint64_t>(end) > offset)
+  {
+    logger.warn("Dropping a torn record at the end of " + file);
+    if(::ftruncate(fd, offset) != 0)
+      throw(io_error("truncate " + file));
+  }
+  
+  logger.info("Loaded " + std::to_string(records) + " records, " + 
+    std::to_string(index.size()) + " keys, " + 
+    std::to_string(frontier.size()) + " unvisited links");
+}
+
+void log_store::close_db()
+{
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  if(fd < 0)
+    return;
+  
+  logger.debug("Closing database");
+  try
+  {
+    flush();
+  } catch (CrawlerException &e) {
+    logger.error(e.what());
+  }
+  
+  ::close(fd);
+  fd = -1;
+}
+
+void log_store::begin()
+{
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  transaction_depth++;
+}
+
+void log_store::end_transaction()
+{
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  if(transaction_depth > 0)
+    transaction_depth--;
+}
+
+void log_store::commit()
+{
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  if(transaction_depth == 0 || --transaction_depth > 0)
+    return;
+  
+  flush();
+  if(options.sync && ::fdatasync(fd) != 0)
+    logger.error(io_error("sync " + file).what());
+  
+  std::uint64_t garbage = file_size - sizeof(magic) - live_bytes;
+  if(file_size >= options.compact_min_bytes && 
+    garbage > options.compact_ratio * file_size)
+    compact();
+}
+
+void log_store::put(const std::string &key, const std::string &value, 
+  bool erase)
+{
+  std::size_t start = buffer.size();
+  put_u32(buffer, 0);
+  put_u32(buffer, key.size());
+  put_u32(buffer, erase ? tombstone : value.size());
+  buffer += key;
+  if(!erase)
+    buffer += value;
+  
+  std::uint32_t crc = checksum(&buffer[start + 4], buffer.size() - start - 4);
+  for(int i = 0; i < 4; i++)
+    buffer[start + i] = static_cast<char>((crc >> (8 * i)) & 0xff);
+  
+  apply(key, value, file_size + start + header_size + key.size(), erase);
+  
+  // Nothing of an open transaction is written before its commit
+  if(transaction_depth == 0 && buffer.size() >= options.write_buffer)
+    flush();
+}
+
+void log_store::apply(const std::string &key, const std::string &value,
+  std::uint64_t offset, bool erase)
+{
+  auto it = index.find(key);
+  if(it != index.end())
+  {
+    live_bytes -= record_size(key.size(), it->second.size);
+    if(it->second.seq)
+      frontier.erase(it->second.seq);
+    
+    if(erase)
+    {
+      index.erase(it);
+      return;
+    }
+  }
+  
+  if(erase)
+    return;
+  
+  if(it == index.end())
+    it = index.emplace(key, slot()).first;
+  
+  slot &s = it->second;
+  s.offset = offset;
+  s.size = value.size();
+  s.seq = 0;
+  live_bytes += record_size(key.size(), value.size());
+  
+  link_state state;
+  if(key[0] == 'L' && decode(value, state))
+  {
+    next_seq = std::max(next_seq, state.seq + 1);
+    if(state.visited == 0)
+    {
+      s.seq = state.seq;
+      frontier[state.seq] = &it->first;
+    }
+  }
+}
+
+bool log_store::get(const std::string &key, std::string &value)
+{
+  auto it = index.find(key);
+  if(it == index.end())
+    return false;
+  
+  value.resize(it->second.size);
+  if(!value.empty())
+    read_at(it->second.offset, value.size(), &value[0]);
+  return true;
+}
+
+void log_store::read_at(std::uint64_t offset, std::size_t size, char *out)
+{
+  if(offset >= file_size)
+  { // Still in the buffer, records are written whole
+    std::memcpy(out, buffer.data() + (offset - file_size), size);
+    return;
+  }
+  
+  if(fd < 0)
+    throw(CrawlerException("log_store: read: database is closed"));
+  
+  if(read_all(fd, offset, out, size) != static_cast<ssize_t>(size))
+    throw(io_error("read " + file));
+}
+
+void log_store::flush()
+{
+  if(buffer.empty())
+    return;
+  
+  if(fd < 0)
+    throw(CrawlerException("log_store: write: database is closed"));
+  
+  if(!write_all(fd, file_size, buffer.data(), buffer.size()))
+    throw(io_error("write " + file));
+  
+  file_size += buffer.size();
+  buffer.clear();
+}
+
+void log_store::compact()
+{
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  flush();
+  
+  std::uint64_t before = file_size;
+  std::string tmp = file + ".compact";
+  int out = ::open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if(out < 0)
+    throw(io_error("open " + tmp));
+  
+  // The index moves to the new offsets only once the new log is in place
+  std::vector<std::uint64_t> offsets;
+  offsets.reserve(index.size());
+  
+  std::string records(magic, sizeof(magic));
+  std::uint64_t size = 0;
+  std::string value;
+  bool ok = true;
+  for(auto &entry : index)
+  {
+    try
+    {
+      get(entry.first, value);
+    } catch (CrawlerException &e) {
+      ::close(out);
+      std::remove(tmp.c_str());
+      throw;
+    }
+    
+    std::size_t start = records.size();
+    put_u32(records, 0);
+    put_u32(records, entry.first.size());
+    put_u32(records, value.size());
+    records += entry.first;
+    records += value;
+    
+    std::uint32_t crc = checksum(&records[start + 4], 
+      records.size() - start - 4);
+    for(int i = 0; i < 4; i++)
+      records[start + i] = static_cast<char>((crc >> (8 * i)) & 0xff);
+    offsets.push_back(size + start + header_size + entry.first.size());
+    
+    if(records.size() >= options.write_buffer)
+    {
+      if(!(ok = write_all(out, size, records.data(), records.size())))
+        break;
+      size += records.size();
+      records.clear();
+    }
+  }
+  
+  if(ok && (ok = write_all(out, size, records.data(), records.size())))
+    size += records.size();
+  
+  if(!ok || ::fsync(out) != 0 || ::rename(tmp.c_str(), file.c_str()) != 0)
+  {
+    CrawlerException e = io_error("compact " + tmp);
+    ::close(out);
+    std::remove(tmp.c_str());
+    throw(e);
+  }
+  
+  ::close(fd);
+  fd = out;
+  file_size = size;
+  
+  std::size_t i = 0;
+  for(auto &entry : index)
+    entry.second.offset = offsets[i++];
+  
+  logger.info("Compacted " + file + " from " + std::to_string(before) + 
+    " to " + std::to_string(size) + " bytes");
+}
+
+////////////////////////////////////////////////////////////////////////
+
+std::string log_store::make_key(char family, const std::string &protocol,
+  const std::string &domain, const std::string &path)
+{
+  std::string key;
+  key.reserve(4 + protocol.size() + domain.size() + path.size());
+  key += family;
+  key += '|';
+  key += protocol;
+  key += '\n';
+  key += domain;
+  key += '\n';
+  key += path;
+  return key;
+}
+
+void log_store::split_key(const std::string &key, std::string &protocol,
+  std::string &domain, std::string &path)
+{
+  std::size_t first = key.find('\n', 2);
+  std::size_t second = key.find('\n', first + 1);
+  protocol.assign(key, 2, first - 2);
+  domain.assign(key, first + 1, second - first - 1);
+  path.assign(key, second + 1, std::string::npos);
+}
+
+std::string log_store::encode(const link_state &state)
+{
+  std::string value;
+  put_u64(value, state.seq);
+  value += static_cast<char>(state.visited);
+  put_u32(value, state.code);
+  put_u64(value, state.last_visited);
+  return value;
+}
+
+bool log_store::decode(const std::string &value, link_state &state)
+{
+  if(value.size() != 21)
+    return false;
+  
+  state.seq = get_u64(value.data());
+  state.visited = static_cast<std::uint8_t>(value[8]);
+  state.code = get_u32(value.data() + 9);
+  state.last_visited = get_u64(value.data() + 13);
+  return true;
+}
+
+bool log_store::get_link(const std::string &key, link_state &state)
+{
+  std::string value;
+  return get(key, value) && decode(value, state);
+}
+
+void log_store::put_link(const std::string &key, const link_state &state)
+{
+  put(key, encode(state));
+}
+
+std::int64_t log_store::now()
+{
+  using namespace std::chrono;
+  return duration_cast<seconds>(system_clock::now().time_since_epoch()).count();
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void log_store::add_links(std::vector<std::string> links)
+{
+  logger.debug("Adding links to DB");
+  std::string protocol, domain, path;
+  
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  transaction_guard transaction(*this);
+  
+  for(auto &link : links)
+  {
+    if(!url::split_link(link, protocol, domain, path))
+    {
+      logger.debug("log_store: Dropping: " + link);
+      continue;
+    }
+    
+    std::string key = make_key('L', protocol, domain, path);
+    if(index.count(key))
+    {
+      logger.trace("Already in DB: " + domain + path);
+      continue;
+    }
+    
+    link_state state;
+    state.seq = next_seq++;
+    put_link(key, state);
+    logger.trace("Added link to DB: " + protocol + "://" + domain + path);
+  }
+  
+  transaction.commit();
+}
+
+bool log_store::get_visited(
+  std::string domain, 
+  std::string path, 
+  std::string protocol)
+{
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  link_state state;
+  if(!get_link(make_key('L', protocol, domain, path), state))
+    throw(CrawlerException("get_visited: no such link"));
+  return state.visited != 0;
+}
+
+void log_store::set_visited(
+  std::string domain,
+  std::string path,
+  std::string protocol,
+  unsigned int code)
+{
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  std::string key = make_key('L', protocol, domain, path);
+  link_state state;
+  if(!get_link(key, state))
+    return;
+  
+  state.visited = 1;
+  state.code = code;
+  state.last_visited = now();
+  
+  transaction_guard transaction(*this);
+  put_link(key, state);
+  transaction.commit();
+}
+
+void log_store::set_last_visited(
+  std::string domain,
+  std::string path,
+  std::string protocol)
+{
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  std::string key = make_key('L', protocol, domain, path);
+  link_state state;
+  if(!get_link(key, state))
+    return;
+  
+  state.last_visited = now();
+  
+  transaction_guard transaction(*this);
+  put_link(key, state);
+  transaction.commit();
+}
+
+v_links log_store::get_links(std::size_t num, std::int64_t &cursor)
+{
+  v_links links;
+  std::vector<std::string> hits;
+  std::string protocol, domain, path;
+  
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  
+  // Each host's blacklist is read and compiled once per call
+  std::map<compact_url::site_type, path_matcher> blacklists;
+  
+  auto it = frontier.upper_bound(std::max<std::int64_t>(cursor, 0));
+  for(; it != frontier.end() && links.size() < num; ++it)
+  {
+    // Blacklisted links are marked, so the cursor can move past them
+    cursor = it->first;
+    split_key(*it->second, protocol, domain, path);
+    compact_url link(protocol, domain, path);
+    
+    auto found = blacklists.find(link.get_site());
+    if(found == blacklists.end())
+      found = blacklists.emplace(link.get_site(), 
+        load_blacklist(domain, protocol)).first;
+    
+    if(found->second.matches(path))
+    {
+      logger.debug("Hit blacklist: " + link.to_string());
+      hits.push_back(*it->second);
+      continue;
+    }
+    
+    links.push_back(link);
+  }
+  
+  if(!hits.empty())
+  {
+    logger.info("Dropping " + std::to_string(hits.size()) + 
+      " blacklisted links");
+    
+    transaction_guard transaction(*this);
+    link_state state;
+    for(auto &key : hits)
+      if(get_link(key, state))
+      {
+        state.visited = 2;
+        put_link(key, state);
+      }
+    transaction.commit();
+  }
+  
+  return links;
+}
+
+bool log_store::check_blacklist(
+  std::string domain, 
+  std::string path, 
+  std::string proto)
+{
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  return load_blacklist(domain, proto).matches(path);
+}
+
+path_matcher log_store::load_blacklist(
+  const std::string &domain, 
+  const std::string &proto)
+{
+  path_matcher matcher;
+  std::string prefix = make_key('B', proto, domain);
+  
+  for(auto it = index.lower_bound(prefix); it != index.end() && 
+    it->first.compare(0, prefix.size(), prefix) == 0; ++it)
+    matcher.add(it->first.substr(prefix.size()));
+  
+  return matcher;
+}
+
+void log_store::remove_link(
+  std::string domain, 
+  std::string path, 
+  std::string protocol)
+{
+  logger.warn("REMOVING LINK: " + protocol + "://" + domain + path + "!");
+  
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  std::string key = make_key('L', protocol, domain, path);
+  if(!index.count(key))
+    return;
+  
+  transaction_guard transaction(*this);
+  erase(key);
+  transaction.commit();
+}
+
+void log_store::blacklist(v_links blacklist, std::string reason)
+{
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  transaction_guard transaction(*this);
+  
+  for(auto &link : blacklist)
+  {
+    std::string path = link.get_path().to_string();
+    put(make_key('B', link.get_protocol(), link.get_host(), path), reason);
+    logger.info("Blacklisted: " + link.get_host() + path + " (" + 
+      link.get_protocol() + ")");
+  }
+  
+  transaction.commit();
+}
+
+void log_store::blacklist(
+  std::string domain, 
+  std::string path, 
+  std::string protocol,
+  std::string reason)
+{
+  logger.info("Blacklisting: " + protocol + "://" + domain + path + " ( " + reason + ")");
+  
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  transaction_guard transaction(*this);
+  put(make_key('B', protocol, domain, path), reason);
+  transaction.commit();
+}
+
+void log_store::set_robot_processed(std::string domain, 
+  std::string protocol,
+  bool timed_out,
+  std::string robots)
+{
+  std::int64_t seconds = timed_out ? 0 : now();
+  logger.debug("Adding " + domain + " to RobotRules");
+  
+  // lastUpdated, then the robots.txt
+  std::string value;
+  put_u64(value, seconds);
+  value += robots;
+  
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  transaction_guard transaction(*this);
+  put(make_key('R', protocol, domain), value);
+  transaction.commit();
+}
+
+bool log_store::should_process_robots(std::string domain, std::string protocol)
+{
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  return index.count(make_key('R', protocol, domain)) == 0;
+}
+
+std::string log_store::get_robots(std::string domain, std::string protocol)
+{
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  std::string value;
+  if(!get(make_key('R', protocol, domain), value) || value.size() < 8)
+    return "";
+  return value.substr(8);
+}
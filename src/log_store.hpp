@@ -0,0 +1,298 @@
+/*
+ * WebCrawler: log_store.hpp
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file log_store.hpp
+ * @author Kyle Givler
+ */
+
+#ifndef _WC_LOG_STORE_H_
+#define _WC_LOG_STORE_H_
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "database.hpp"
+#include "path_matcher.hpp"
+#include "logger/logger.hpp"
+
+/**
+ * How the log store is opened
+ */
+struct log_store_options
+{
+  /**
+   * Rewrite the log once this share of it is overwritten records
+   */
+  double compact_ratio = 0.5;
+  
+  /**
+   * Smallest log in bytes that is compacted
+   */
+  std::size_t compact_min_bytes = 64 * 1024 * 1024;
+  
+  /**
+   * Bytes of records buffered before they are written while no 
+   * transaction is open, a transaction's records wait for its commit
+   */
+  std::size_t write_buffer = 1024 * 1024;
+  
+  /**
+   * fsync the log on every commit
+   */
+  bool sync = false;
+};
+
+/**
+ * The database kept as an append-only log of key/value records with the
+ * index of every live key in memory, read back from the log when opened
+ * Links, blacklist entries and robots.txt are families of keys under the
+ * prefixes L|, B| and R|. Writing a key again or deleting it leaves the
+ * old record in the log until it is compacted. A torn record at the end of
+ * the log, eg. after a crash, is dropped when it is opened
+ * Records are indexed as they are appended, so there is no rollback: a 
+ * transaction cut short by an exception keeps the records it made, they
+ * are written by the next commit
+ */
+class log_store : public database
+{
+public:
+  log_store(std::string file, 
+    log_store_options options = log_store_options());
+  
+  virtual ~log_store();
+  
+  void close_db();
+  
+  void begin();
+  
+  void commit();
+  
+  // The compact_url overloads from database
+  using database::set_visited;
+  using database::set_last_visited;
+  using database::check_blacklist;
+  using database::blacklist;
+  
+  void add_links(std::vector<std::string> links);
+  
+  void add_link(std::string link)
+  {
+    add_links(std::vector<std::string>(1, link));
+  }
+  
+  bool get_visited(
+    std::string domain, 
+    std::string path, 
+    std::string protocol);
+  
+  void set_visited(
+    std::string domain,
+    std::string path, 
+    std::string protocol,
+    unsigned int code);
+  
+  void set_last_visited(
+    std::string domain, 
+    std::string path, 
+    std::string protocol);
+  
+  /**
+   * @param cursor A link's sequence number, links are returned in the 
+   *  order they were added
+   */
+  v_links get_links(std::size_t num, std::int64_t &cursor);
+  
+  bool check_blacklist(
+    std::string domain, 
+    std::string path, 
+    std::string proto);
+  
+  void remove_link(
+    std::string domain, 
+    std::string path, 
+    std::string protocol);
+  
+  void blacklist(
+    v_links blacklist, 
+    std::string reason = "default");
+  
+  void blacklist(
+    std::string domain, 
+    std::string path, 
+    std::string protocol, 
+    std::string reason = "default");
+  
+  void set_robot_processed(
+    std::string server, 
+    std::string protocol,
+    bool timed_out,
+    std::string robots);
+  
+  bool should_process_robots(
+    std::string domain, 
+    std::string protocol);
+  
+  std::string get_robots(
+    std::string domain, 
+    std::string protocol);
+  
+  /**
+   * Rewrite the log with only its live records
+   */
+  void compact();
+
+private:
+  /**
+   * Where a key's value is in the log
+   */
+  struct slot
+  {
+    std::uint64_t offset = 0; // Of the value
+    std::uint32_t size = 0;
+    std::uint64_t seq = 0; // An unvisited link's key in frontier, or 0
+  };
+  
+  /**
+   * A link's value
+   */
+  struct link_state
+  {
+    std::uint64_t seq = 0;
+    std::uint8_t visited = 0; // 1 visited, 2 blacklisted
+    std::uint32_t code = 0;
+    std::int64_t last_visited = 0;
+  };
+  
+  std::string file;
+  log_store_options options;
+  int fd = -1;
+  
+  // Keys are ordered so a family or a host is one range
+  std::map<std::string, slot> index;
+  // Unvisited links by sequence number
+  std::map<std::uint64_t, const std::string*> frontier;
+  std::uint64_t next_seq = 1;
+  
+  // Records not yet written, they start at the end of the file
+  std::string buffer;
+  std::uint64_t file_size = 0;
+  // Bytes of records the index points at
+  std::uint64_t live_bytes = 0;
+  
+  // Index and log are shared, so only one thread may use them at once
+  std::recursive_mutex mutex;
+  std::size_t transaction_depth = 0;
+  Logger logger;
+  
+  /**
+   * begin() on construction, commit() when asked. Unwinding only ends the
+   * transaction, so an exception never leaves it open
+   */
+  class transaction_guard
+  {
+  public:
+    transaction_guard(log_store &store) : store(store) { store.begin(); }
+    ~transaction_guard()
+    {
+      if(!committed)
+        store.end_transaction();
+    }
+    
+    void commit()
+    {
+      committed = true;
+      store.commit();
+    }
+  private:
+    log_store &store;
+    bool committed = false;
+  };
+  
+  /**
+   * Leave a transaction without writing it, its records stay buffered
+   */
+  void end_transaction();
+  
+  /**
+   * Read the log into the index, dropping a torn record at its end
+   */
+  void load();
+  
+  /**
+   * Append a record, an empty value with erase set is a deletion
+   */
+  void put(const std::string &key, const std::string &value, 
+    bool erase = false);
+  
+  void erase(const std::string &key) { put(key, "", true); }
+  
+  /**
+   * @return false if the key is not in the index
+   */
+  bool get(const std::string &key, std::string &value);
+  
+  /**
+   * Read size bytes at offset, from the buffer if they are not written
+   */
+  void read_at(std::uint64_t offset, std::size_t size, char *out);
+  
+  /**
+   * Write the buffered records
+   */
+  void flush();
+  
+  /**
+   * Index a record at offset, as read from the log or just appended
+   */
+  void apply(const std::string &key, const std::string &value,
+    std::uint64_t offset, bool erase);
+  
+  bool get_link(const std::string &key, link_state &state);
+  
+  void put_link(const std::string &key, const link_state &state);
+  
+  path_matcher load_blacklist(
+    const std::string &domain, 
+    const std::string &proto);
+  
+  /**
+   * Encode a key as family|protocol\ndomain\npath
+   */
+  static std::string make_key(char family, const std::string &protocol,
+    const std::string &domain, const std::string &path = "");
+  
+  /**
+   * Split a key made by make_key()
+   */
+  static void split_key(const std::string &key, std::string &protocol,
+    std::string &domain, std::string &path);
+  
+  static std::string encode(const link_state &state);
+  
+  static bool decode(const std::string &value, link_state &state);
+  
+  /**
+   * @return Seconds since the epoch
+   */
+  static std::int64_t now();
+};
+
+#endif
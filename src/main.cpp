@@ -24,25 +24,54 @@
 #include "crawler.hpp"
 #include <boost/asio.hpp>
 #include <boost/thread.hpp>
+#include <string>
+#include <vector>
 
 #include "robot_parser.hpp"
 
 int main(int argc, char **argv)
 {  
+  crawler_options options;
+  std::vector<std::string> args;
+  std::size_t threads = boost::thread::hardware_concurrency();
+  
+  for(int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    if(arg == "-c" && i + 1 < argc)
+      options.max_clients = std::stoul(argv[++i]);
+    else if(arg == "-t" && i + 1 < argc)
+      threads = std::stoul(argv[++i]);
+    else if(arg == "-P" && i + 1 < argc)
+      options.parse_threads = std::stoul(argv[++i]);
+    else if(arg == "-H")
+      options.head_first = true;
+    else if(arg == "-d" && i + 1 < argc)
+      options.host_delay = std::stod(argv[++i]);
+    else if(arg == "-p" && i + 1 < argc)
+      options.max_per_host = std::stoul(argv[++i]);
+    else if(arg == "-b" && i + 1 < argc)
+      options.backend = argv[++i];
+    else
+      args.push_back(arg);
+  }
+  
   boost::asio::io_service io;
-  Crawler crawler(io);
+  Crawler crawler(io, options);
   
-  if(argc == 3)
+  if(args.size() == 2)
   {
-    crawler.seed(argv[1], argv[2]);
+    crawler.seed(args[0], args[1]);
   }
   
-  //asio::io_service::work work(io);
-  //boost::thread t(boost::bind(&boost::asio::io_service::run, &io));
   io.post(boost::bind(&Crawler::start, &crawler));
+  
+  // The calling thread is one of the workers
+  boost::thread_group workers;
+  for(std::size_t i = 1; i < threads; i++)
+    workers.create_thread(boost::bind(&boost::asio::io_service::run, &io));
   io.run();
-  //io.stop();
-  //t.join();
+  workers.join_all();
   
   return 0;
 }
@@ -0,0 +1,108 @@
+/*
+ * WebCrawler: parse_pool.cxx
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file parse_pool.cxx
+ * @author Kyle Givler
+ */
+
+#include "parse_pool.hpp"
+#include "http_request.hpp"
+#include <boost/bind.hpp>
+#include <chrono>
+
+parse_pool::parse_pool(std::size_t threads, std::size_t max_queued)
+  : work(new asio::io_service::work(io_service)),
+    max_queued(max_queued ? max_queued : 1),
+    depth(0),
+    max_depth(0),
+    parsed(0),
+    wait_us(0),
+    parse_us(0),
+    max_parse_us(0),
+    logger("parse_pool")
+{
+  logger.setIgnoreLevel(Level::NONE);
+  
+  if(threads == 0)
+    threads = 1;
+  for(std::size_t i = 0; i < threads; i++)
+    this->threads.create_thread(boost::bind(&asio::io_service::run, 
+      &io_service));
+}
+
+parse_pool::~parse_pool()
+{
+  stop();
+}
+
+void parse_pool::post(http_request *request, parsed_handler handler)
+{
+  raise(max_depth, ++depth);
+  io_service.post(boost::bind(&parse_pool::parse, this, request, handler, 
+    now()));
+}
+
+void parse_pool::stop()
+{
+  work.reset();
+  threads.join_all();
+}
+
+void parse_pool::parse(
+  http_request *request, 
+  parsed_handler handler, 
+  std::uint64_t queued)
+{
+  std::uint64_t start = now();
+  std::vector<std::string> links = request->get_links();
+  std::uint64_t took = now() - start;
+  
+  wait_us += start - queued;
+  parse_us += took;
+  raise(max_parse_us, took);
+  parsed++;
+  
+  if(took > 1000000)
+    logger.warn("Slow parse: " + std::to_string(took / 1000) + " ms, " + 
+      std::to_string(request->get_data().size()) + " bytes: " + 
+      request->get_server() + request->get_path());
+  
+  // Uncounted before it is handed back, the prepare_next_request() its 
+  // release posts must see the room
+  depth--;
+  handler(request, std::move(links));
+}
+
+std::uint64_t parse_pool::get_mean_wait() const
+{
+  std::size_t n = parsed;
+  return n ? wait_us / n : 0;
+}
+
+std::uint64_t parse_pool::get_mean_parse() const
+{
+  std::size_t n = parsed;
+  return n ? parse_us / n : 0;
+}
+
+std::uint64_t parse_pool::now()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,152 @@
+/*
+ * WebCrawler: parse_pool.hpp
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file parse_pool.hpp
+ * @author Kyle Givler
+ */
+
+#ifndef _WC_PARSE_POOL_H_
+#define _WC_PARSE_POOL_H_
+
+#include <boost/asio.hpp>
+#include <boost/thread.hpp>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "logger/logger.hpp"
+
+class http_request;
+
+using namespace boost;
+
+/**
+ * Threads of their own that find the links of fetched pages, so the
+ * io_service threads only move bytes. The queue is bounded by the
+ * caller: nothing new should be fetched while full() is true, counting
+ * the fetches already under way as pending since each may be posted
+ */
+class parse_pool
+{
+public:
+  typedef std::function<void(http_request*,
+    std::vector<std::string>)> parsed_handler;
+  
+  /**
+   * @param threads Number of parsing threads, at least one is started
+   * @param max_queued Pages queued, being parsed or pending that make full()
+   *  true
+   */
+  parse_pool(std::size_t threads, std::size_t max_queued);
+  
+  virtual ~parse_pool();
+  
+  /**
+   * Find the request's links on a parsing thread and call handler with
+   * them there, wrap it in a strand to get back to the crawler
+   * Safe to call from any thread
+   */
+  void post(http_request *request, parsed_handler handler);
+  
+  /**
+   * Let the threads finish what is queued and join them
+   */
+  void stop();
+  
+  /**
+   * @param pending Pages that may still be posted, ie. fetches in flight
+   * @return true if max_queued pages are queued, being parsed or pending
+   */
+  bool full(std::size_t pending = 0) const 
+  { 
+    return this->depth + pending >= this->max_queued; 
+  }
+  
+  /**
+   * @return Pages queued or being parsed
+   */
+  std::size_t get_depth() const { return this->depth; }
+  
+  /**
+   * @return Most pages that were queued or being parsed at once
+   */
+  std::size_t get_max_depth() const { return this->max_depth; }
+  
+  /**
+   * @return Pages parsed so far
+   */
+  std::size_t get_parsed() const { return this->parsed; }
+  
+  /**
+   * @return Mean microseconds a page waited for a thread
+   */
+  std::uint64_t get_mean_wait() const;
+  
+  /**
+   * @return Mean microseconds spent parsing a page
+   */
+  std::uint64_t get_mean_parse() const;
+  
+  /**
+   * @return Longest a page took to parse, in microseconds
+   */
+  std::uint64_t get_max_parse() const { return this->max_parse_us; }
+
+private:
+  asio::io_service io_service;
+  std::unique_ptr<asio::io_service::work> work;
+  boost::thread_group threads;
+  std::size_t max_queued;
+  std::atomic<std::size_t> depth;
+  std::atomic<std::size_t> max_depth;
+  std::atomic<std::size_t> parsed;
+  std::atomic<std::uint64_t> wait_us;
+  std::atomic<std::uint64_t> parse_us;
+  std::atomic<std::uint64_t> max_parse_us;
+  Logger logger;
+  
+  /**
+   * Runs on a parsing thread
+   * @param queued When post() was called, in microseconds
+   */
+  void parse(
+    http_request *request,
+    parsed_handler handler,
+    std::uint64_t queued);
+  
+  /**
+   * @return Microseconds on a monotonic clock
+   */
+  static std::uint64_t now();
+  
+  /**
+   * Raise value to at least candidate
+   */
+  template <typename T>
+  static void raise(std::atomic<T> &value, T candidate)
+  {
+    T seen = value;
+    while(seen < candidate && !value.compare_exchange_weak(seen, candidate))
+      ;
+  }
+};
+
+#endif
@@ -0,0 +1,88 @@
+/*
+ * WebCrawler: path_matcher.cxx
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file path_matcher.cxx
+ * @author Kyle Givler
+ */
+
+#include "path_matcher.hpp"
+
+void path_matcher::add(const std::string &pattern)
+{
+  if(pattern.find('*') == std::string::npos)
+  {
+    exact.insert(pattern);
+    return;
+  }
+  
+  wildcard w;
+  std::size_t start = 0;
+  std::size_t star;
+  while( (star = pattern.find('*', start)) != std::string::npos )
+  {
+    w.parts.push_back(pattern.substr(start, star - start));
+    start = star + 1;
+  }
+  w.parts.push_back(pattern.substr(start));
+  wildcards.push_back(w);
+}
+
+bool path_matcher::matches(const std::string &path) const
+{
+  if(exact.count(path))
+    return true;
+  
+  for(auto &w : wildcards)
+    if(match(w, path))
+      return true;
+  
+  return false;
+}
+
+bool path_matcher::match(const wildcard &w, const std::string &path)
+{
+  // There are at least two parts, the first is anchored at the start and 
+  // the last at the end. The ones between are taken at their earliest 
+  // place, which never rules out a match a later place would allow
+  const std::string &first = w.parts.front();
+  const std::string &last = w.parts.back();
+  
+  if(path.size() < first.size() + last.size())
+    return false;
+  if(path.compare(0, first.size(), first) != 0)
+    return false;
+  if(path.compare(path.size() - last.size(), last.size(), last) != 0)
+    return false;
+  
+  std::size_t pos = first.size();
+  std::size_t end = path.size() - last.size();
+  for(std::size_t i = 1; i + 1 < w.parts.size(); i++)
+  {
+    const std::string &part = w.parts[i];
+    if(part.empty())
+      continue;
+    
+    std::size_t found = path.find(part, pos);
+    if(found == std::string::npos || found + part.size() > end)
+      return false;
+    pos = found + part.size();
+  }
+  
+  return true;
+}
@@ -0,0 +1,66 @@
+/*
+ * WebCrawler: path_matcher.hpp
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file path_matcher.hpp
+ * @author Kyle Givler
+ */
+
+#ifndef _WC_PATH_MATCHER_H_
+#define _WC_PATH_MATCHER_H_
+
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * A set of blacklist patterns compiled once and matched against many paths
+ * A pattern matches a whole path, '*' matches any run of characters and 
+ * everything else is literal
+ */
+class path_matcher
+{
+public:
+  void add(const std::string &pattern);
+  
+  /**
+   * @return true if any pattern matches the whole path
+   */
+  bool matches(const std::string &path) const;
+  
+  bool empty() const { return exact.empty() && wildcards.empty(); }
+  
+  std::size_t size() const { return exact.size() + wildcards.size(); }
+  
+private:
+  /**
+   * A pattern split at each '*'
+   */
+  struct wildcard
+  {
+    std::vector<std::string> parts;
+  };
+  
+  // Patterns without a '*' are a hash lookup
+  std::unordered_set<std::string> exact;
+  std::vector<wildcard> wildcards;
+  
+  static bool match(const wildcard &w, const std::string &path);
+};
+
+#endif
@@ -0,0 +1,56 @@
+/*
+ * WebCrawler: request_pool.cxx
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file request_pool.cxx
+ * @author Kyle Givler
+ */
+
+#include "request_pool.hpp"
+
+request_pool::request_pool()
+{
+}
+
+request_pool::~request_pool()
+{
+}
+
+http_request* request_pool::acquire(
+  request_reciver &reciver, 
+  const compact_url &link)
+{
+  if(free_requests.empty())
+  {
+    requests.emplace_back(new http_request(reciver, link));
+    return requests.back().get();
+  }
+  
+  http_request *request = free_requests.back();
+  free_requests.pop_back();
+  request->reset(reciver, link);
+  reused++;
+  return request;
+}
+
+void request_pool::release(http_request *request)
+{
+  // The body's blocks go back to the buffer_pool now, not on reuse
+  request->clear();
+  free_requests.push_back(request);
+}
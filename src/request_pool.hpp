@@ -0,0 +1,93 @@
+/*
+ * WebCrawler: request_pool.hpp
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file request_pool.hpp
+ * @author Kyle Givler
+ */
+
+#ifndef _WC_REQUEST_POOL_H_
+#define _WC_REQUEST_POOL_H_
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "compact_url.hpp"
+#include "http_request.hpp"
+
+class request_reciver;
+
+/**
+ * Owns every http_request the crawler makes. A released request is 
+ * cleared and handed out again, keeping the capacity of its buffers, so
+ * the pool grows to the most requests alive at once: the client slots 
+ * plus the pages waiting to be parsed. Not thread safe, the crawler uses
+ * it on its strand
+ */
+class request_pool
+{
+public:
+  request_pool();
+  
+  virtual ~request_pool();
+  
+  request_pool(const request_pool&) = delete;
+  
+  request_pool& operator=(const request_pool&) = delete;
+  
+  /**
+   * @return A request for link, reused when one is free. It stays owned 
+   *  by the pool, give it back with release()
+   */
+  http_request* acquire(request_reciver &reciver, const compact_url &link);
+  
+  /**
+   * Clear a finished request and keep it for the next acquire()
+   */
+  void release(http_request *request);
+  
+  /**
+   * @return Requests constructed so far
+   */
+  std::size_t get_created() const { return this->requests.size(); }
+  
+  /**
+   * @return Times acquire() handed out a released request
+   */
+  std::size_t get_reused() const { return this->reused; }
+  
+  /**
+   * @return Requests acquired and not released
+   */
+  std::size_t get_in_use() const 
+  { 
+    return this->requests.size() - this->free_requests.size(); 
+  }
+  
+  /**
+   * @return Requests kept for reuse
+   */
+  std::size_t get_free() const { return this->free_requests.size(); }
+
+private:
+  std::vector<std::unique_ptr<http_request>> requests;
+  std::vector<http_request*> free_requests;
+  std::size_t reused = 0;
+};
+
+#endif
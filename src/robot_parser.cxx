@@ -23,78 +23,29 @@
 
 #include "robot_parser.hpp"
 #include "database.hpp"
-#include <boost/regex.hpp>
-#include <boost/algorithm/string/replace.hpp>
-#include <boost/algorithm/string/case_conv.hpp>
 
-using namespace boost;
+const std::string robot_parser::agent = "JoyfulReaper";
 
 robot_parser::robot_parser() : logger("robot_parser")
 {
 }
 
-bool robot_parser::path_is_allowed(std::string i_pattern, std::string path)
-{
-  std::string pattern = algorithm::replace_all_copy(i_pattern, "*", ".*");
-  pattern = algorithm::replace_all_copy(pattern, "?", "\\?");
-  pattern = algorithm::replace_all_copy(pattern, ".", "\\.");
-  
-  regex exp(pattern);
-  cmatch what;
-  
-  if(regex_match(path.c_str(), what, exp))
-    return false; // Path not allowed
-
-  return true; // Path is allowed 
-}
-
-void robot_parser::process_robots(
+robot_rules_ptr robot_parser::process_robots(
   std::string server,
   std::string protocol,
   std::string data,
   bool timed_out,
   database *db)
 {
-  // Follow SOME robots.txt rules...
-  // Not fully compliant
   logger.debug("Proccessing robots.txt for: " + protocol + "://" + 
     server);
   
-  v_links blacklist;
-  std::string line;
-  bool foundUserAgent = false;
-  std::size_t found;
+  robot_rules_ptr rules = std::make_shared<robot_rules>(data, agent);
+  logger.debug(std::to_string(rules->size()) + " rules, Crawl-delay: " + 
+    std::to_string(rules->get_crawl_delay()));
   
-  std::istringstream ss(data);
-  while(!ss.eof())
-  {
-    getline(ss, line);
-    boost::to_lower(line);
-    if( (found = line.find("#")) != std::string::npos )
-      line = line.substr(0, found);
-      
-    if( (found = line.find("user-agent: ")) != std::string::npos)
-    {
-      if( (found = line.find("user-agent: *")) != std::string::npos ||
-           (found = line.find("user-agent: joyfulreaper") != std::string::npos) )
-      {
-        foundUserAgent = true;
-      } else {
-        foundUserAgent = false;
-      }
-    }
-    
-    if( foundUserAgent && (found = line.find("disallow: ")) != std::string::npos)
-    {
-      std::string disallow = line.substr(10, line.length());
-      std::tuple<std::string,std::string,std::string> link(server, 
-        disallow, protocol);
-      blacklist.push_back(link);
-    }
-  }
-  if(!blacklist.empty());
-    db->blacklist(blacklist, "robots.txt");
-  db->set_robot_processed(server, protocol, timed_out);
+  // The text is kept so the rules can be compiled again in a later run
+  db->set_robot_processed(server, protocol, timed_out, data);
   
-  return;
+  return rules;
 }
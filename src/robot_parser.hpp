@@ -25,6 +25,7 @@
 #define _WC_ROBOT_PARSER_H_
 
 #include <string>
+#include "robot_rules.hpp"
 #include "logger/logger.hpp"
 
 class database;
@@ -34,11 +35,16 @@ class robot_parser
 public:
   robot_parser();
 
-  bool path_is_allowed(
-  std::string pattern, 
-  std::string path);
+  /**
+   * The product token our robots.txt group is found by
+   */
+  static const std::string agent;
   
-void process_robots(
+  /**
+   * Compile the rules for our user agent and store robots.txt
+   * @return The host's rules
+   */
+  robot_rules_ptr process_robots(
   std::string server, 
   std::string protocol,
   std::string data,
@@ -0,0 +1,274 @@
+/*
+ * WebCrawler: robot_rules.cxx
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file robot_rules.cxx
+ * @author Kyle Givler
+ */
+
+#include "robot_rules.hpp"
+#include <boost/algorithm/string/case_conv.hpp>
+#include <boost/algorithm/string/trim.hpp>
+#include <cstdlib>
+#include <sstream>
+
+robot_rules::robot_rules()
+  : nodes(1)
+{
+}
+
+robot_rules::robot_rules(const std::string &robots, const std::string &agent)
+  : nodes(1)
+{
+  // Rules from groups naming us and from "*" groups, a group is a run of
+  // User-agent lines and the lines that follow them
+  std::vector<std::pair<bool, std::string>> ours, any;
+  double ours_delay = 0, any_delay = 0;
+  bool found_ours = false;
+  bool in_ours = false, in_any = false;
+  bool group_started = false;
+  
+  std::string me = boost::to_lower_copy(agent);
+  std::istringstream ss(robots);
+  std::string line;
+  while(std::getline(ss, line))
+  {
+    std::size_t found;
+    if( (found = line.find('#')) != std::string::npos )
+      line.erase(found);
+    if( (found = line.find(':')) == std::string::npos )
+      continue;
+    
+    std::string field = boost::to_lower_copy(
+      boost::trim_copy(line.substr(0, found)));
+    std::string value = boost::trim_copy(line.substr(found + 1));
+    
+    if(field == "user-agent")
+    {
+      if(group_started)
+      {
+        in_ours = in_any = false;
+        group_started = false;
+      }
+      
+      // Only the product token counts, "JoyfulReaper/1.0" names us
+      std::string name = boost::to_lower_copy(
+        value.substr(0, value.find_first_of("/ \t")));
+      if(name == "*")
+        in_any = true;
+      else if(name == me)
+        in_ours = found_ours = true;
+      continue;
+    }
+    
+    group_started = true;
+    if(field == "allow" || field == "disallow")
+    {
+      if(in_ours)
+        ours.push_back(std::make_pair(field == "allow", value));
+      if(in_any)
+        any.push_back(std::make_pair(field == "allow", value));
+    }
+    else if(field == "crawl-delay")
+    {
+      double delay = std::atof(value.c_str());
+      if(in_ours)
+        ours_delay = delay;
+      if(in_any)
+        any_delay = delay;
+    }
+  }
+  
+  for(auto &r : found_ours ? ours : any)
+    add(r.first, r.second);
+  crawl_delay = found_ours ? ours_delay : any_delay;
+}
+
+void robot_rules::add(bool allow, const std::string &pattern)
+{
+  // An empty Disallow allows everything, an empty Allow says nothing
+  if(pattern.empty())
+    return;
+  
+  std::size_t special = pattern.find('*');
+  if(pattern.back() == '$')
+    special = std::min(special, pattern.size() - 1);
+  
+  std::size_t n = 0;
+  std::size_t literal = std::min(special, pattern.size());
+  for(std::size_t i = 0; i < literal; i++)
+  {
+    auto child = nodes[n].children.find(pattern[i]);
+    if(child != nodes[n].children.end())
+    {
+      n = child->second;
+      continue;
+    }
+    nodes.push_back(node());
+    nodes[n].children[pattern[i]] = nodes.size() - 1;
+    n = nodes.size() - 1;
+  }
+  
+  rule r;
+  r.allow = allow;
+  r.length = pattern.size();
+  r.anchored = false;
+  
+  if(special == std::string::npos)
+  {
+    int &slot = allow ? nodes[n].allow : nodes[n].disallow;
+    if(slot == -1)
+    {
+      rules.push_back(r);
+      slot = rules.size() - 1;
+    }
+    return;
+  }
+  
+  std::string rest = pattern.substr(special);
+  if(rest.back() == '$')
+  {
+    r.anchored = true;
+    rest.pop_back();
+  }
+  
+  std::size_t start = 0;
+  std::size_t star;
+  while( (star = rest.find('*', start)) != std::string::npos )
+  {
+    r.parts.push_back(rest.substr(start, star - start));
+    start = star + 1;
+  }
+  r.parts.push_back(rest.substr(start));
+  
+  rules.push_back(r);
+  nodes[n].wildcards.push_back(rules.size() - 1);
+}
+
+bool robot_rules::allowed(const std::string &path) const
+{
+  if(path == "/robots.txt")
+    return true;
+  
+  std::size_t best = 0;
+  bool allow = true;
+  auto consider = [&](const rule &r) {
+    if(r.length > best || (r.length == best && r.allow && !allow))
+    {
+      best = r.length;
+      allow = r.allow;
+    }
+  };
+  
+  // Every node on the path's way down is a prefix of the path
+  std::size_t n = 0;
+  for(std::size_t depth = 0; ; depth++)
+  {
+    const node &here = nodes[n];
+    if(here.disallow != -1)
+      consider(rules[here.disallow]);
+    if(here.allow != -1)
+      consider(rules[here.allow]);
+    for(auto w : here.wildcards)
+      if(rules[w].length >= best && match(rules[w], path, depth))
+        consider(rules[w]);
+    
+    if(depth == path.size())
+      break;
+    auto child = here.children.find(path[depth]);
+    if(child == here.children.end())
+      break;
+    n = child->second;
+  }
+  
+  return allow;
+}
+
+bool robot_rules::match(const rule &r, const std::string &path, 
+  std::size_t pos)
+{
+  // parts[0] comes right after the prefix, the others each after a '*' at
+  // their earliest place. Anchored, the last part must end the path
+  const std::string &first = r.parts.front();
+  if(path.compare(pos, first.size(), first) != 0)
+    return false;
+  pos += first.size();
+  
+  std::size_t count = r.parts.size();
+  if(count == 1)
+    return !r.anchored || pos == path.size();
+  
+  std::size_t end = path.size();
+  if(r.anchored)
+  {
+    const std::string &last = r.parts.back();
+    if(end < pos + last.size() || 
+       path.compare(end - last.size(), last.size(), last) != 0)
+      return false;
+    end -= last.size();
+    count--;
+  }
+  
+  for(std::size_t i = 1; i < count; i++)
+  {
+    const std::string &part = r.parts[i];
+    std::size_t found = path.find(part, pos);
+    if(found == std::string::npos || found + part.size() > end)
+      return false;
+    pos = found + part.size();
+  }
+  
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+robot_rules_cache::robot_rules_cache(std::size_t max_entries)
+  : max_entries(max_entries)
+{
+}
+
+robot_rules_ptr robot_rules_cache::get(key_type key)
+{
+  auto found = entries.find(key);
+  if(found == entries.end())
+    return robot_rules_ptr();
+  
+  order.splice(order.begin(), order, found->second);
+  return found->second->second;
+}
+
+void robot_rules_cache::put(key_type key, robot_rules_ptr rules)
+{
+  auto found = entries.find(key);
+  if(found != entries.end())
+  {
+    found->second->second = rules;
+    order.splice(order.begin(), order, found->second);
+    return;
+  }
+  
+  order.push_front(std::make_pair(key, rules));
+  entries[key] = order.begin();
+  
+  if(entries.size() > max_entries)
+  {
+    entries.erase(order.back().first);
+    order.pop_back();
+  }
+}
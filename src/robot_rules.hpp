@@ -0,0 +1,131 @@
+/*
+ * WebCrawler: robot_rules.hpp
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file robot_rules.hpp
+ * @author Kyle Givler
+ */
+
+#ifndef _WC_ROBOT_RULES_H_
+#define _WC_ROBOT_RULES_H_
+
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "compact_url.hpp"
+
+/**
+ * The Allow and Disallow rules of one host's robots.txt that apply to us,
+ * compiled once into a trie over the rules' literal prefixes
+ * The longest matching rule wins, allow wins a tie and no match is allowed
+ */
+class robot_rules
+{
+public:
+  /**
+   * Rules that allow everything
+   */
+  robot_rules();
+  
+  /**
+   * @param robots The robots.txt text
+   * @param agent Our product token, its group is used if there is one, 
+   *  otherwise the "*" group
+   */
+  robot_rules(const std::string &robots, const std::string &agent);
+  
+  /**
+   * @param path The path and query of a URL
+   */
+  bool allowed(const std::string &path) const;
+  
+  /**
+   * @return The Crawl-delay in seconds, 0 if none
+   */
+  double get_crawl_delay() const { return crawl_delay; }
+  
+  std::size_t size() const { return rules.size(); }
+  
+private:
+  struct rule
+  {
+    bool allow;
+    // Pattern length, a longer rule is more specific
+    std::size_t length;
+    // What follows the literal prefix, split at each '*'
+    std::vector<std::string> parts;
+    // The pattern ended with '$'
+    bool anchored;
+  };
+  
+  struct node
+  {
+    std::map<char, std::size_t> children;
+    // Rules whose pattern is exactly this prefix, matched by reaching here
+    int allow = -1;
+    int disallow = -1;
+    // Rules with a '*' or '$' after this prefix
+    std::vector<std::size_t> wildcards;
+  };
+  
+  std::vector<rule> rules;
+  std::vector<node> nodes;
+  double crawl_delay = 0;
+  
+  void add(bool allow, const std::string &pattern);
+  
+  /**
+   * @return true if the rest of a wildcard rule matches path from pos
+   */
+  static bool match(const rule &r, const std::string &path, std::size_t pos);
+};
+
+typedef std::shared_ptr<const robot_rules> robot_rules_ptr;
+
+/**
+ * Least recently used robot_rules by host, not thread safe
+ */
+class robot_rules_cache
+{
+public:
+  typedef compact_url::site_type key_type;
+  
+  robot_rules_cache(std::size_t max_entries);
+  
+  /**
+   * @return The host's rules, null if not cached
+   */
+  robot_rules_ptr get(key_type key);
+  
+  void put(key_type key, robot_rules_ptr rules);
+  
+  std::size_t size() const { return entries.size(); }
+  
+private:
+  typedef std::list<std::pair<key_type, robot_rules_ptr>> lru_list;
+  
+  std::size_t max_entries;
+  // Most recently used first
+  lru_list order;
+  std::unordered_map<key_type, lru_list::iterator> entries;
+};
+
+#endif
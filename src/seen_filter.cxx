@@ -0,0 +1,198 @@
+/*
+ * WebCrawler: seen_filter.cxx
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file seen_filter.cxx
+ * @author Kyle Givler
+ */
+
+#include "seen_filter.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+
+namespace
+{
+  const char magic[8] = { 'W', 'C', 'S', 'E', 'E', 'N', '0', '1' };
+  
+  // Each layer's rate is half the one before it, the rates sum to fp_rate
+  const double tightening = 0.5;
+  
+  std::uint64_t mix(std::uint64_t x)
+  {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+  }
+}
+
+seen_filter::seen_filter(std::size_t capacity, double fp_rate)
+  : capacity(capacity ? capacity : 1),
+    fp_rate(fp_rate)
+{
+  add_layer(this->capacity, fp_rate * (1 - tightening));
+}
+
+bool seen_filter::contains(std::uint64_t fp) const
+{
+  for(auto &l : layers)
+    if(test(l, fp))
+      return true;
+  return false;
+}
+
+void seen_filter::insert(std::uint64_t fp)
+{
+  if(layers.back().count >= layers.back().capacity)
+    add_layer(layers.back().capacity * 2, 
+      fp_rate * (1 - tightening) * std::pow(tightening, layers.size()));
+  
+  // Double hashing, the i'th bit is h1 + i * h2
+  layer &l = layers.back();
+  std::uint64_t m = l.bits.size() * 64;
+  std::uint64_t h1 = fp;
+  std::uint64_t h2 = mix(fp ^ 0x9e3779b97f4a7c15ULL) | 1;
+  for(std::uint32_t i = 0; i < l.hashes; i++)
+  {
+    std::uint64_t bit = (h1 + i * h2) % m;
+    l.bits[bit / 64] |= 1ULL << (bit % 64);
+  }
+  l.count++;
+}
+
+bool seen_filter::test(const layer &l, std::uint64_t fp)
+{
+  std::uint64_t m = l.bits.size() * 64;
+  std::uint64_t h1 = fp;
+  std::uint64_t h2 = mix(fp ^ 0x9e3779b97f4a7c15ULL) | 1;
+  for(std::uint32_t i = 0; i < l.hashes; i++)
+  {
+    std::uint64_t bit = (h1 + i * h2) % m;
+    if(!(l.bits[bit / 64] & (1ULL << (bit % 64))))
+      return false;
+  }
+  return true;
+}
+
+std::size_t seen_filter::size() const
+{
+  std::size_t count = 0;
+  for(auto &l : layers)
+    count += l.count;
+  return count;
+}
+
+std::size_t seen_filter::memory() const
+{
+  std::size_t bytes = 0;
+  for(auto &l : layers)
+    bytes += l.bits.size() * sizeof(std::uint64_t);
+  return bytes;
+}
+
+void seen_filter::add_layer(std::uint64_t capacity, double p)
+{
+  // The optimal size and hash count for capacity items at rate p
+  const double ln2 = std::log(2.0);
+  double bits = -static_cast<double>(capacity) * std::log(p) / (ln2 * ln2);
+  
+  layer l;
+  l.capacity = capacity;
+  l.hashes = std::max(1, static_cast<int>(std::ceil(-std::log2(p))));
+  l.bits.resize(static_cast<std::size_t>(bits / 64) + 1);
+  layers.push_back(std::move(l));
+}
+
+bool seen_filter::save(const std::string &file, std::int64_t mark) const
+{
+  // Written in host byte order, a file from another machine is rejected 
+  // by load() or simply rebuilt
+  std::string tmp = file + ".tmp";
+  {
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    std::uint64_t count = layers.size();
+    out.write(magic, sizeof(magic));
+    out.write(reinterpret_cast<const char*>(&fp_rate), sizeof(fp_rate));
+    out.write(reinterpret_cast<const char*>(&mark), sizeof(mark));
+    out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    for(auto &l : layers)
+    {
+      std::uint64_t words = l.bits.size();
+      out.write(reinterpret_cast<const char*>(&l.hashes), sizeof(l.hashes));
+      out.write(reinterpret_cast<const char*>(&l.capacity), 
+        sizeof(l.capacity));
+      out.write(reinterpret_cast<const char*>(&l.count), sizeof(l.count));
+      out.write(reinterpret_cast<const char*>(&words), sizeof(words));
+      out.write(reinterpret_cast<const char*>(l.bits.data()), 
+        words * sizeof(std::uint64_t));
+    }
+    
+    if(!out)
+    {
+      std::remove(tmp.c_str());
+      return false;
+    }
+  }
+  
+  // A crash part way through leaves the last complete file
+  return std::rename(tmp.c_str(), file.c_str()) == 0;
+}
+
+bool seen_filter::load(const std::string &file, std::int64_t &mark)
+{
+  std::ifstream in(file, std::ios::binary);
+  char file_magic[sizeof(magic)];
+  double file_rate;
+  std::int64_t file_mark;
+  std::uint64_t count;
+  
+  in.read(file_magic, sizeof(file_magic));
+  in.read(reinterpret_cast<char*>(&file_rate), sizeof(file_rate));
+  in.read(reinterpret_cast<char*>(&file_mark), sizeof(file_mark));
+  in.read(reinterpret_cast<char*>(&count), sizeof(count));
+  if(!in || !std::equal(magic, magic + sizeof(magic), file_magic) || 
+     file_rate != fp_rate || count == 0 || count > 64)
+    return false;
+  
+  std::vector<layer> loaded(count);
+  for(auto &l : loaded)
+  {
+    std::uint64_t words;
+    in.read(reinterpret_cast<char*>(&l.hashes), sizeof(l.hashes));
+    in.read(reinterpret_cast<char*>(&l.capacity), sizeof(l.capacity));
+    in.read(reinterpret_cast<char*>(&l.count), sizeof(l.count));
+    in.read(reinterpret_cast<char*>(&words), sizeof(words));
+    if(!in || words == 0 || words > (1ULL << 34) || l.hashes == 0 || 
+       l.hashes > 64)
+      return false;
+    
+    l.bits.resize(words);
+    in.read(reinterpret_cast<char*>(l.bits.data()), 
+      words * sizeof(std::uint64_t));
+    if(!in)
+      return false;
+  }
+  
+  layers.swap(loaded);
+  mark = file_mark;
+  return true;
+}
@@ -0,0 +1,98 @@
+/*
+ * WebCrawler: seen_filter.hpp
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file seen_filter.hpp
+ * @author Kyle Givler
+ */
+
+#ifndef _WC_SEEN_FILTER_H_
+#define _WC_SEEN_FILTER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * A scalable Bloom filter of URL fingerprints, see compact_url::fingerprint
+ * Never misses a URL that was inserted, but may claim to have one that was
+ * not, at most fp_rate of the time. When a layer is full a layer twice its
+ * size with a tighter rate is added, so the bound holds however many URLs
+ * are inserted
+ */
+class seen_filter
+{
+public:
+  /**
+   * @param capacity URLs the first layer holds
+   * @param fp_rate Chance a URL never inserted is reported as seen
+   */
+  seen_filter(std::size_t capacity, double fp_rate);
+  
+  bool contains(std::uint64_t fp) const;
+  
+  void insert(std::uint64_t fp);
+  
+  /**
+   * @return Number of URLs inserted
+   */
+  std::size_t size() const;
+  
+  /**
+   * @return Bytes used by the bit arrays
+   */
+  std::size_t memory() const;
+  
+  double get_fp_rate() const { return fp_rate; }
+  
+  /**
+   * Write the filter to a file, replacing it
+   * @param mark Stored with the filter and returned by load()
+   * @return false if it could not be written
+   */
+  bool save(const std::string &file, std::int64_t mark) const;
+  
+  /**
+   * Replace the filter with one written by save() with the same fp_rate
+   * @return false, leaving the filter alone, if the file is missing or 
+   *  does not match
+   */
+  bool load(const std::string &file, std::int64_t &mark);
+  
+private:
+  struct layer
+  {
+    std::vector<std::uint64_t> bits;
+    std::uint32_t hashes;
+    std::uint64_t capacity;
+    std::uint64_t count = 0;
+  };
+  
+  std::size_t capacity;
+  double fp_rate;
+  std::vector<layer> layers;
+  
+  /**
+   * Add a layer for capacity URLs at error rate p
+   */
+  void add_layer(std::uint64_t capacity, double p);
+  
+  static bool test(const layer &l, std::uint64_t fp);
+};
+
+#endif
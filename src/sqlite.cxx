@@ -23,23 +23,22 @@
 
 #include "sqlite.hpp"
 #include "crawlerException.hpp"
-#include "robot_parser.hpp"
+#include "url.hpp"
+#include <algorithm>
 #include <chrono>
-#include <boost/algorithm/string/replace.hpp>
-#include <boost/algorithm/string/case_conv.hpp>
+#include <map>
 
-#include <unistd.h>
-
-sqlite::sqlite(std::string databaseFile)
+sqlite::sqlite(std::string databaseFile, sqlite_options options)
   : databaseFile(databaseFile),
+    options(options),
     logger("sqlite")
 {
+  logger.setIgnoreLevel(Level::TRACE);
   
-  // Check if table exists:
-  // SELECT name FROM sqlite_master WHERE type='table' AND name = 'Links'
-  
+  // Every connection is used by one thread at a time, the writer under
+  // mutex and each reader while it is leased
   int rc = sqlite3_open_v2(databaseFile.c_str(), &db, SQLITE_OPEN_READWRITE
-    | SQLITE_OPEN_CREATE | SQLITE_OPEN_FULLMUTEX, 0);
+    | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX, 0);
   if(rc != SQLITE_OK)
   {
     sqlite3_close(db);
@@ -48,102 +47,506 @@ sqlite::sqlite(std::string databaseFile)
     throw(CrawlerException(errmsg));
   }
   
-  rc = sqlite3_enable_shared_cache(1);
-  if(rc != SQLITE_OK)
-    logger.warn("enable_shared_cache failed");
-  
-  logger.setIgnoreLevel(Level::TRACE);
+  try
+  {
+    if(options.wal)
+    {
+      pragma(db, "PRAGMA journal_mode = WAL;");
+      pragma(db, "PRAGMA synchronous = NORMAL;");
+    }
+    tune(db);
+    
+    migrate();
+    prepare_statements();
+    open_seen();
+    
+    // Readers only see committed data, without WAL they would block on
+    // every write so the writer answers reads too
+    std::size_t count = options.wal ? options.readers : 0;
+    for(std::size_t i = 0; i < count; i++)
+      open_reader();
+  } catch (CrawlerException &e) {
+    close_db();
+    throw;
+  }
 }
 
 sqlite::~sqlite()
 {
   logger.debug("~Closing database");
-  int rc = sqlite3_close_v2(db);
+  close_db();
+}
+
+void sqlite::exec(std::string sql, std::string errmsg)
+{
+  char *err = nullptr;
+  if(sqlite3_exec(db, sql.c_str(), 0, 0, &err) != SQLITE_OK)
+  {
+    errmsg.append(err ? err : sqlite3_errmsg(db));
+    sqlite3_free(err);
+    throw(CrawlerException(errmsg));
+  }
+}
+
+std::int64_t sqlite::query_int(std::string sql)
+{
+  sqlite3_stmt *statement;
+  int rc = sqlite3_prepare_v2(db, sql.c_str(), -1, &statement, 0);
   if(rc != SQLITE_OK)
-    logger.error("Unable to close DB");
+  {
+    std::string errmsg = "query_int: ";
+    errmsg.append(sqlite3_errmsg(db));
+    throw(CrawlerException(errmsg));
+  }
+  
+  std::int64_t value = 0;
+  if(sqlite3_step(statement) == SQLITE_ROW)
+    value = sqlite3_column_int64(statement, 0);
+  sqlite3_finalize(statement);
+  return value;
+}
+
+void sqlite::open_seen()
+{
+  if(options.seen_fp_rate <= 0)
+    return;
+  
+  // Rowids only grow, the file holds every link up to its mark
+  std::int64_t last = query_int("SELECT IFNULL(MAX(rowid), 0) FROM Links;");
+  std::size_t capacity = std::max<std::size_t>(options.seen_capacity, 
+    last + last / 2);
+  seen.reset(new seen_filter(capacity, options.seen_fp_rate));
+  
+  std::int64_t mark = 0;
+  if(seen->load(databaseFile + ".seen", mark) && mark > last)
+  { // Written for a different database
+    seen.reset(new seen_filter(capacity, options.seen_fp_rate));
+    mark = 0;
+  }
+  
+  sqlite3_stmt *statement = prepare("SELECT protocol, domain, path " \
+    "FROM Links WHERE rowid > ?1;");
+  {
+    statement_guard guard(statement);
+    bind(statement, 1, mark);
+    while(sqlite3_step(statement) == SQLITE_ROW)
+      seen->insert(compact_url::fingerprint(
+        reinterpret_cast<const char*>(sqlite3_column_text(statement, 0)),
+        reinterpret_cast<const char*>(sqlite3_column_text(statement, 1)),
+        reinterpret_cast<const char*>(sqlite3_column_text(statement, 2))));
+  }
+  
+  logger.info("Seen filter: " + std::to_string(seen->size()) + 
+    " links, " + std::to_string(seen->memory() / 1024) + " KiB, " + 
+    std::to_string(last - mark) + " read from Links");
+}
+
+void sqlite::save_seen()
+{
+  if(!seen)
+    return;
+  
+  // Runs from close_db(), so a failure is only logged
+  try
+  {
+    std::int64_t mark = query_int("SELECT IFNULL(MAX(rowid), 0) FROM Links;");
+    if(!seen->save(databaseFile + ".seen", mark))
+      logger.warn("Unable to save the seen filter");
+  } catch (CrawlerException &e) {
+    logger.warn(std::string("Unable to save the seen filter: ") + e.what());
+  }
+  
+  logger.info("Seen filter: " + std::to_string(seen->size()) + 
+    " links, " + std::to_string(seen->memory() / 1024) + " KiB");
+}
+
+void sqlite::migrate()
+{
+  // migrations[i] moves the schema from user_version i to i + 1
+  static const std::vector<std::string> migrations = {
+    // 1: The original tables if this is a new database, then Links 
+    // rebuilt with integer columns, a priority, protocol in the key and
+    // indexes so the frontier query reads only the rows it returns
+    "CREATE TABLE IF NOT EXISTS Links (domain TEXT NOT NULL, " \
+    "  path TEXT NOT NULL, protocol TEXT, visited INTEGER DEFAULT 0, " \
+    "  lastVisited INTEGER, lastCode INTEGER DEFAULT 0, " \
+    "  PRIMARY KEY(domain,path));" \
+    "CREATE TABLE IF NOT EXISTS RobotRules (domain TEXT NOT NULL, " \
+    "  protocol TEXT NOT NULL, lastUpdated INTEGER, PRIMARY KEY(domain));" \
+    "CREATE TABLE IF NOT EXISTS Blacklist (domain TEXT NOT NULL, " \
+    "  path TEXT NOT NULL, protocol TEXT, reason TEXT, " \
+    "  PRIMARY KEY(domain,path));" \
+    "CREATE TABLE Links_new (domain TEXT NOT NULL, path TEXT NOT NULL, " \
+    "  protocol TEXT NOT NULL, visited INTEGER NOT NULL DEFAULT 0, " \
+    "  lastVisited INTEGER NOT NULL DEFAULT 0, " \
+    "  lastCode INTEGER NOT NULL DEFAULT 0, " \
+    "  priority INTEGER NOT NULL DEFAULT 0, " \
+    "  PRIMARY KEY(domain,path,protocol));" \
+    // rowids are kept, get_links() walks them as its cursor
+    "INSERT OR IGNORE INTO Links_new " \
+    "  (rowid,domain,path,protocol,visited,lastVisited,lastCode) " \
+    "  SELECT rowid, domain, path, IFNULL(protocol, 'http'), " \
+    "  CAST(IFNULL(visited, 0) AS INTEGER), " \
+    "  CAST(IFNULL(lastVisited, 0) AS INTEGER), " \
+    "  CAST(IFNULL(lastCode, 0) AS INTEGER) FROM Links;" \
+    "DROP TABLE Links;" \
+    "ALTER TABLE Links_new RENAME TO Links;" \
+    "CREATE INDEX Links_visited_domain ON Links(visited, domain);" \
+    // Only unvisited rows, it shrinks as the crawl goes on
+    "CREATE INDEX Links_frontier ON Links(visited) WHERE visited = 0;" \
+    "CREATE TABLE RobotRules_new (domain TEXT NOT NULL, " \
+    "  protocol TEXT NOT NULL, lastUpdated INTEGER NOT NULL DEFAULT 0, " \
+    "  PRIMARY KEY(domain,protocol));" \
+    "INSERT OR IGNORE INTO RobotRules_new SELECT domain, protocol, " \
+    "  CAST(IFNULL(lastUpdated, 0) AS INTEGER) FROM RobotRules;" \
+    "DROP TABLE RobotRules;" \
+    "ALTER TABLE RobotRules_new RENAME TO RobotRules;",
+    
+    // 2: robots.txt is kept so its rules can be compiled in a later run
+    "ALTER TABLE RobotRules ADD COLUMN robots TEXT NOT NULL DEFAULT '';"
+  };
+  
+  std::size_t version = query_int("PRAGMA user_version;");
+  
+  for(; version < migrations.size(); version++)
+  {
+    logger.info("Migrating database to version " + 
+      std::to_string(version + 1));
+    
+    exec("BEGIN;", "migrate: ");
+    try
+    {
+      exec(migrations[version], "migrate " + std::to_string(version + 1) + 
+        ": ");
+      exec("PRAGMA user_version = " + std::to_string(version + 1) + ";",
+        "migrate: ");
+    } catch (CrawlerException &e) {
+      sqlite3_exec(db, "ROLLBACK;", 0, 0, 0);
+      throw;
+    }
+    exec("COMMIT;", "migrate: ");
+  }
+}
+
+void sqlite::pragma(sqlite3 *conn, std::string sql)
+{
+  char *err = nullptr;
+  if(sqlite3_exec(conn, sql.c_str(), 0, 0, &err) != SQLITE_OK)
+  {
+    logger.warn(sql + " failed: " + (err ? err : ""));
+    sqlite3_free(err);
+  }
+}
+
+void sqlite::tune(sqlite3 *conn)
+{
+  sqlite3_busy_timeout(conn, options.busy_timeout);
+  // Negative cache_size is in KiB rather than pages
+  pragma(conn, "PRAGMA cache_size = -" + std::to_string(options.cache_kb) 
+    + ";");
+  pragma(conn, "PRAGMA mmap_size = " + std::to_string(options.mmap_size) 
+    + ";");
+  pragma(conn, "PRAGMA temp_store = MEMORY;");
+}
+
+void sqlite::open_reader()
+{
+  sqlite3 *conn = nullptr;
+  int rc = sqlite3_open_v2(databaseFile.c_str(), &conn, SQLITE_OPEN_READONLY
+    | SQLITE_OPEN_NOMUTEX, 0);
+  if(rc != SQLITE_OK)
+  {
+    sqlite3_close(conn);
+    std::string errmsg = "open_reader: ";
+    errmsg.append(sqlite3_errstr(rc));
+    throw(CrawlerException(errmsg));
+  }
+  
+  readers.push_back(std::unique_ptr<reader>(new reader()));
+  reader &r = *readers.back();
+  r.db = conn;
+  tune(conn);
+  prepare_reads(r);
+  idle_readers.push_back(&r);
+}
+
+void sqlite::prepare_reads(reader &r)
+{
+  r.get_visited_stmt = prepare(r.db, "SELECT visited FROM Links WHERE " \
+    "domain = ?1 AND path = ?2 AND protocol = ?3;");
+  
+  // Rows are walked in rowid order so each call picks up where the last
+  // one stopped, new links get higher rowids
+  r.get_links_stmt = prepare(r.db, "SELECT domain,path,protocol,rowid " \
+    "FROM Links WHERE visited = 0 AND rowid > ?1 ORDER BY rowid LIMIT ?2;");
+  
+  r.check_blacklist_stmt = prepare(r.db, "SELECT path " \
+    "FROM Blacklist WHERE domain = ?1 AND protocol = ?2;");
+  
+  r.should_process_robots_stmt = prepare(r.db, "SELECT domain FROM " \
+    "RobotRules WHERE domain = ?1 AND protocol = ?2;");
+  
+  r.get_robots_stmt = prepare(r.db, "SELECT robots FROM RobotRules " \
+    "WHERE domain = ?1 AND protocol = ?2;");
+}
+
+sqlite::reader& sqlite::acquire_reader()
+{
+  std::unique_lock<std::mutex> lock(readers_mutex);
+  reader_free.wait(lock, [this] { return !idle_readers.empty(); });
+  reader *r = idle_readers.back();
+  idle_readers.pop_back();
+  return *r;
+}
+
+void sqlite::release_reader(reader &r)
+{
+  {
+    std::lock_guard<std::mutex> lock(readers_mutex);
+    idle_readers.push_back(&r);
+  }
+  reader_free.notify_one();
+}
+
+sqlite::read_lease::read_lease(sqlite &owner)
+  : owner(owner)
+{
+  if(owner.readers.empty())
+  {
+    owner.mutex.lock();
+    r = &owner.writer_reads;
+  } else {
+    r = &owner.acquire_reader();
+  }
+}
+
+sqlite::read_lease::~read_lease()
+{
+  if(r == &owner.writer_reads)
+    owner.mutex.unlock();
+  else
+    owner.release_reader(*r);
+}
+
+void sqlite::prepare_statements()
+{
+  writer_reads.db = db;
+  prepare_reads(writer_reads);
+  
+  begin_stmt = prepare("BEGIN;");
+  commit_stmt = prepare("COMMIT;");
+  rollback_stmt = prepare("ROLLBACK;");
+  
+  insert_link_stmt = prepare("INSERT OR IGNORE INTO Links " \
+    "(domain,path,protocol) VALUES (?1, ?2, ?3);");
+  
+  set_visited_stmt = prepare("UPDATE Links SET visited = 1, " \
+    "lastCode = ?4, lastVisited = ?5 WHERE domain = ?1 AND path = ?2 " \
+    "AND protocol = ?3;");
+  
+  set_last_visited_stmt = prepare("UPDATE Links SET lastVisited = ?4 " \
+    "WHERE domain = ?1 AND path = ?2 AND protocol = ?3;");
+  
+  remove_link_stmt = prepare("DELETE FROM Links WHERE domain = ?1 AND " \
+    "path = ?2 AND protocol = ?3;");
+  
+  // visited = 2 keeps the row, so finding the link again does not queue it
+  mark_blacklisted_stmt = prepare("UPDATE Links SET visited = 2 " \
+    "WHERE rowid = ?1;");
+  
+  blacklist_stmt = prepare("INSERT OR REPLACE INTO Blacklist " \
+    "(domain,path,protocol,reason) VALUES (?1, ?2, ?3, ?4);");
+  
+  set_robot_processed_stmt = prepare("INSERT OR REPLACE INTO RobotRules " \
+    "(domain,protocol,lastUpdated,robots) VALUES (?1, ?2, ?3, ?4);");
+}
+
+sqlite3_stmt* sqlite::prepare(std::string sql)
+{
+  return prepare(db, sql);
+}
+
+sqlite3_stmt* sqlite::prepare(sqlite3 *conn, std::string sql)
+{
+  sqlite3_stmt *statement = nullptr;
+  int rc = sqlite3_prepare_v2(conn, sql.c_str(), -1, &statement, 0);
+  if(rc != SQLITE_OK)
+  {
+    sqlite3_finalize(statement);
+    std::string errmsg = "prepare: ";
+    errmsg.append(sqlite3_errmsg(conn));
+    throw(CrawlerException(errmsg + " " + sql));
+  }
+  
+  statements.push_back(statement);
+  return statement;
+}
+
+void sqlite::bind(sqlite3_stmt *statement, int index, const std::string &value)
+{
+  sqlite3_bind_text(statement, index, value.c_str(), value.size(), 
+    SQLITE_TRANSIENT);
+}
+
+void sqlite::bind(sqlite3_stmt *statement, int index, std::int64_t value)
+{
+  sqlite3_bind_int64(statement, index, value);
+}
+
+void sqlite::step_done(sqlite3_stmt *statement, std::string errmsg)
+{
+  int rc = sqlite3_step(statement);
+  if(rc != SQLITE_DONE)
+  {
+    errmsg.append(sqlite3_errstr(rc));
+    throw(CrawlerException(errmsg));
+  }
+}
+
+std::int64_t sqlite::now()
+{
+  using namespace std::chrono;
+  return duration_cast<seconds>(system_clock::now().time_since_epoch()).count();
 }
 
 void sqlite::close_db()
 {
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  if(!db)
+    return;
+  
   logger.debug("Closing database");
+  // Anything still uncommitted is lost with the connection
+  seen_pending.clear();
+  save_seen();
+  
+  for(auto statement : statements)
+    sqlite3_finalize(statement);
+  statements.clear();
+  
+  {
+    std::lock_guard<std::mutex> readers_lock(readers_mutex);
+    for(auto &r : readers)
+      sqlite3_close_v2(r->db);
+    idle_readers.clear();
+  }
+  
   int rc = sqlite3_close_v2(db);
   if(rc != SQLITE_OK)
     logger.error("Unable to close DB");
+  db = nullptr;
+}
+
+void sqlite::begin()
+{
+  // Held until the matching commit() or rollback(), so the transaction is
+  // this thread's and another thread's begin() waits for it to end
+  mutex.lock();
+  if(transaction_depth++ > 0)
+    return;
+  
+  statement_guard guard(begin_stmt);
+  if(sqlite3_step(begin_stmt) != SQLITE_DONE)
+    logger.error(std::string("BEGIN failed: ") + sqlite3_errmsg(db));
+}
+
+void sqlite::commit()
+{
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  if(transaction_depth == 0)
+    return;
+  // The lock begin() took, lock still holds the mutex
+  mutex.unlock();
+  if(--transaction_depth > 0)
+    return;
+  
+  statement_guard guard(commit_stmt);
+  if(sqlite3_step(commit_stmt) != SQLITE_DONE)
+  {
+    logger.error(std::string("COMMIT failed: ") + sqlite3_errmsg(db));
+    seen_pending.clear();
+    // A failed COMMIT can leave the transaction open, every later batch 
+    // would join it and never be committed
+    if(!sqlite3_get_autocommit(db))
+    {
+      sqlite3_reset(commit_stmt);
+      statement_guard rollback_guard(rollback_stmt);
+      if(sqlite3_step(rollback_stmt) != SQLITE_DONE)
+        logger.error(std::string("ROLLBACK failed: ") + sqlite3_errmsg(db));
+    }
+    return;
+  }
+  
+  if(seen)
+    for(auto fp : seen_pending)
+      seen->insert(fp);
+  seen_pending.clear();
+}
+
+void sqlite::rollback()
+{
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  if(transaction_depth == 0)
+    return;
+  // The lock begin() took, lock still holds the mutex
+  mutex.unlock();
+  if(transaction_depth != 1)
+  {
+    transaction_depth--;
+    return;
+  }
+  
+  transaction_depth = 0;
+  seen_pending.clear();
+  statement_guard guard(rollback_stmt);
+  sqlite3_step(rollback_stmt);
 }
 
 void sqlite::add_links(std::vector<std::string> links)
 {
   logger.debug("Adding links to DB");
-  std::string protocol;
-  std::string domain;
-  std::string path;
-  std::size_t found;
+  std::string protocol, domain, path;
   
-  std::string sql;
-  int rc;
-  
-  sql = "BEGIN";
-  rc = sqlite3_exec(db, sql.c_str(), 0, 0, 0);
-  if(rc != SQLITE_OK)
-    logger.error("BEGIN failed");
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  transaction_guard transaction(*this);
   
   for(auto &link : links)
   {
-    if( (found = link.find("://")) != std::string::npos)
+    if(!url::split_link(link, protocol, domain, path))
     {
-      protocol = link.substr(0, found);
-      link = link.substr(found + 3, link.length());
-    } else {
-      protocol = "http"; // assume http
+      logger.debug("SQLite: Dropping: " + link);
+      continue;
     }
     
-    if(protocol != "http" && protocol != "https")
+    std::uint64_t fp = compact_url::fingerprint(protocol, domain, path);
+    if(seen && seen->contains(fp))
     {
-      logger.debug("SQLite: Dropping: (" + protocol + ")" + link);
+      logger.trace("Already seen: " + domain + path);
       continue;
     }
     
-    if( (found = link.find("/")) != std::string::npos)
+    statement_guard guard(insert_link_stmt);
+    bind(insert_link_stmt, 1, domain);
+    bind(insert_link_stmt, 2, path);
+    bind(insert_link_stmt, 3, protocol);
+    
+    int rc = sqlite3_step(insert_link_stmt);
+    if(rc != SQLITE_DONE)
     {
-      domain = link.substr(0, found);
-      path = link.substr(found, link.length());
-    } else {
-      domain = link;
-      path = "/";
+      std::string errmsg = "add_links: ";
+      errmsg.append(sqlite3_errstr(rc));
+      errmsg.append(" " + protocol + "://" + domain + path);
+      throw(CrawlerException(errmsg));
     }
     
-    path = boost::algorithm::replace_all_copy(path, "'", "''");
-    boost::to_lower(domain);
-    boost::to_lower(protocol);
-    
-    sql = "INSERT INTO Links (domain,path,protocol) " \
-      "VALUES ('" + domain + "', '" + path + "', '" + protocol + "');";
-      
-    //logger.debug("Adding link to DB: " + protocol + "://" + domain + path);
-
-    rc = sqlite3_exec(db, sql.c_str(), 0, 0, 0);
-    
-    if(rc != SQLITE_OK)
-    {
-      if(rc != SQLITE_CONSTRAINT) // Alread in DB
-      {
-        std::string errmsg = "add_links: ";
-        errmsg.append(sqlite3_errstr(rc));
-        errmsg.append(" " + sql);
-        throw(CrawlerException(errmsg));
-      } else {
-        logger.trace("Already in DB: " + domain + path);
-      }
-    } else {
+    seen_pending.push_back(fp);
+    if(sqlite3_changes(db) == 0)
+      logger.trace("Already in DB: " + domain + path);
+    else
       logger.trace("Added link to DB: " + protocol + "://" + domain + path);
-    }
   }
   
-  sql = "COMMIT";
-  rc = sqlite3_exec(db, sql.c_str(), 0, 0, 0);
-  if(rc != SQLITE_OK)
-    logger.error("COMMIT failed");
-
+  transaction.commit();
   return;
 }
 
@@ -152,32 +555,21 @@ bool sqlite::get_visited(
   std::string path, 
   std::string protocol)
 {
-  sqlite3_stmt *statement;
-  
-  std::string sql = "SELECT visited FROM Links WHERE domain = '" \
-    + domain + "' AND path = '" + path + "' AND protocol = '" + protocol \
-    + "';";
-    
-  int rc = sqlite3_prepare_v2(db, sql.c_str(), -1, &statement, 0);
-  if(rc != SQLITE_OK)
-  {
-    sqlite3_finalize(statement);
-    std::string errmsg = "get_vist: ";
-    errmsg.append(sqlite3_errstr(rc));
-    throw(CrawlerException(errmsg));
-  }
-  
-  rc = sqlite3_step(statement);
+  read_lease lease(*this);
+  sqlite3_stmt *statement = lease.get().get_visited_stmt;
+  statement_guard guard(statement);
+  bind(statement, 1, domain);
+  bind(statement, 2, path);
+  bind(statement, 3, protocol);
+  
+  int rc = sqlite3_step(statement);
   if(rc != SQLITE_ROW)
   {
-    sqlite3_finalize(statement);
     std::string errmsg = "get_vist: ";
     errmsg.append(sqlite3_errstr(rc));
     throw(CrawlerException(errmsg));
   }
-  bool ret = sqlite3_column_int(statement, 0);
-  sqlite3_finalize(statement);
-  return ret;
+  return sqlite3_column_int(statement, 0);
 }
 
 void sqlite::set_visited(
@@ -186,34 +578,15 @@ void sqlite::set_visited(
   std::string protocol,
   unsigned int code)
 {
-  sqlite3_stmt *statement;
-  
-  path = boost::algorithm::replace_all_copy(path, "'", "''");
-  
-  std::string sql = "UPDATE Links SET visited = '1', lastCode = '" + \
-    std::to_string(code) + "' WHERE domain = '" + domain + "' AND PATH = '" \
-    + path + "' AND protocol = '" + protocol + "';";
-  
-  int rc = sqlite3_prepare_v2(db, sql.c_str(), -1, &statement, 0);
-  if(rc != SQLITE_OK)
-  {
-    sqlite3_finalize(statement);
-    std::string errmsg = "sql_set_vist: ";
-    errmsg.append(sqlite3_errstr(rc));
-    throw(CrawlerException(errmsg));
-  }
-  
-  rc = sqlite3_step(statement);
-  if(rc != SQLITE_DONE)
-  {
-    sqlite3_finalize(statement);
-    std::string errmsg = "sql_set_vist: ";
-    errmsg.append(sqlite3_errstr(rc));
-    throw(CrawlerException(errmsg));
-  }
-  
-  sqlite3_finalize(statement);
-  set_last_visited(domain, path, protocol);
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  statement_guard guard(set_visited_stmt);
+  bind(set_visited_stmt, 1, domain);
+  bind(set_visited_stmt, 2, path);
+  bind(set_visited_stmt, 3, protocol);
+  bind(set_visited_stmt, 4, static_cast<std::int64_t>(code));
+  bind(set_visited_stmt, 5, now());
+  
+  step_done(set_visited_stmt, "sql_set_vist: ");
 }
 
 void sqlite::set_last_visited(
@@ -221,83 +594,92 @@ void sqlite::set_last_visited(
   std::string path,
   std::string protocol)
 {
-  using namespace std::chrono;
-  system_clock::time_point tp = system_clock::now();
-  system_clock::duration dtn = tp.time_since_epoch();
-  unsigned int seconds = dtn.count() * system_clock::period::num / system_clock::period::den;
-  
-  sqlite3_stmt *statement;
-  std::string sql = "UPDATE Links SET lastVisited = '" + std::to_string(seconds) \
-    + "' WHERE domain = '" + domain + "' AND path = '" + path + "' AND protocol = '" \
-    + protocol + "';";
-    
-  int rc = sqlite3_prepare_v2(db, sql.c_str(), -1, &statement, 0);
-  if(rc != SQLITE_OK)
-  {
-    sqlite3_finalize(statement);
-    std::string errmsg = "set_lvisit: ";
-    errmsg.append(sqlite3_errstr(rc));
-    throw(CrawlerException(errmsg));
-  }
-  
-  rc = sqlite3_step(statement);
-  if(rc != SQLITE_DONE)
-  {
-    sqlite3_finalize(statement);
-    std::string errmsg = "set_lvist: ";
-    errmsg.append(sqlite3_errstr(rc));
-    throw(CrawlerException(errmsg));
-  }
-  sqlite3_finalize(statement);
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  statement_guard guard(set_last_visited_stmt);
+  bind(set_last_visited_stmt, 1, domain);
+  bind(set_last_visited_stmt, 2, path);
+  bind(set_last_visited_stmt, 3, protocol);
+  bind(set_last_visited_stmt, 4, now());
+  
+  step_done(set_last_visited_stmt, "set_lvist: ");
   return;
 }
 
-v_links sqlite::get_links(std::size_t num)
+v_links sqlite::get_links(std::size_t num, std::int64_t &cursor)
 {
   v_links links;
-  sqlite3_stmt *statement;
+  std::size_t rows = num;
+  if(num == 0)
+    return links;
   
-  std::string sql = "SELECT domain,path,protocol FROM Links WHERE visited = '0'" \
-    " LIMIT " + std::to_string(num) + ";";
-    
-  int rc = sqlite3_prepare_v2(db, sql.c_str(), -1, &statement, 0);
-  if(rc != SQLITE_OK)
-  {
-    sqlite3_finalize(statement);
-    std::string errmsg = "get_links: ";
-    errmsg.append(sqlite3_errstr(rc));
-    throw(CrawlerException(errmsg + " " + sql));
-  }
+  read_lease lease(*this);
+  reader &r = lease.get();
   
-  rc = sqlite3_step(statement);
-  while(rc != SQLITE_DONE)
+  // Each host's blacklist is read and compiled once per call
+  std::map<compact_url::site_type, path_matcher> blacklists;
+  
+  // A batch that was all blacklisted says nothing about the rows after it
+  while(links.empty() && rows == num)
   {
-    if(rc == SQLITE_ROW)
+    v_links batch;
+    std::vector<std::int64_t> rowids;
+    rows = 0;
+    
     {
-      std::string domain = reinterpret_cast<const char*>(sqlite3_column_text(statement, 0));
-      std::string path = reinterpret_cast<const char*>(sqlite3_column_text(statement, 1));
-      std::string proto = reinterpret_cast<const char*>(sqlite3_column_text(statement, 2));
+      sqlite3_stmt *statement = r.get_links_stmt;
+      statement_guard guard(statement);
+      bind(statement, 1, cursor);
+      bind(statement, 2, static_cast<std::int64_t>(num));
       
-      if(check_blacklist(domain, path, proto))
+      int rc = sqlite3_step(statement);
+      while(rc != SQLITE_DONE)
       {
-        remove_link(domain, path, proto);
+        if(rc != SQLITE_ROW)
+        {
+          std::string errmsg = "get_links: ";
+          errmsg.append(sqlite3_errstr(rc));
+          throw(CrawlerException(errmsg));
+        }
+        
+        rows++;
+        std::string domain = reinterpret_cast<const char*>(sqlite3_column_text(statement, 0));
+        const char *path = reinterpret_cast<const char*>(sqlite3_column_text(statement, 1));
+        std::string proto = reinterpret_cast<const char*>(sqlite3_column_text(statement, 2));
+        batch.push_back(compact_url(proto, domain, path));
+        rowids.push_back(sqlite3_column_int64(statement, 3));
+        
         rc = sqlite3_step(statement);
+      }
+    }
+    
+    std::vector<std::int64_t> hits;
+    for(std::size_t i = 0; i < batch.size(); i++)
+    {
+      auto &link = batch[i];
+      auto found = blacklists.find(link.get_site());
+      if(found == blacklists.end())
+        found = blacklists.emplace(link.get_site(), load_blacklist(r, 
+          link.get_host(), link.get_protocol())).first;
+      
+      // Marked rows are no longer unvisited, so the cursor can move past
+      // them like any other
+      cursor = rowids[i];
+      
+      if(found->second.matches(link.get_path().to_string()))
+      {
+        logger.debug("Hit blacklist: " + link.to_string());
+        hits.push_back(rowids[i]);
         continue;
       }
       
-      std::tuple<std::string,std::string,std::string> link(domain,path,proto);
       links.push_back(link);
-      
-      rc = sqlite3_step(statement);
-    } else {
-      sqlite3_finalize(statement);
-      std::string errmsg = "get_links: ";
-      errmsg.append(sqlite3_errstr(rc));
-      throw(CrawlerException(errmsg));
     }
+    
+    // The writer is used once the select is reset
+    if(!hits.empty())
+      mark_blacklisted(hits);
   }
   
-  sqlite3_finalize(statement);
   return links;
 }
 
@@ -306,73 +688,73 @@ bool sqlite::check_blacklist(
   std::string path, 
   std::string proto)
 {
-  bool blacklisted = false;
-  std::string  bl_path;
-  sqlite3_stmt *statement;
-  int rc;
-  robot_parser rp;
+  read_lease lease(*this);
+  return load_blacklist(lease.get(), domain, proto).matches(path);
+}
 
-  std::string sql = "SELECT domain,path,protocol FROM Blacklist WHERE " \
-    "domain = '" + domain + "' AND protocol = '" + proto + "';";
-  rc = sqlite3_prepare_v2(db, sql.c_str(), -1, &statement, 0);
+path_matcher sqlite::load_blacklist(
+  reader &r,
+  const std::string &domain, 
+  const std::string &proto)
+{
+  path_matcher matcher;
   
-  if(rc != SQLITE_OK)
+  sqlite3_stmt *statement = r.check_blacklist_stmt;
+  statement_guard guard(statement);
+  bind(statement, 1, domain);
+  bind(statement, 2, proto);
+  
+  int rc;
+  while( (rc = sqlite3_step(statement)) == SQLITE_ROW )
+    matcher.add(reinterpret_cast<const char*>
+      (sqlite3_column_text(statement, 0)));
+  
+  if(rc != SQLITE_DONE)
   {
-    sqlite3_finalize(statement);
     std::string errmsg = "check_bl: ";
     errmsg.append(sqlite3_errstr(rc));
     throw(CrawlerException(errmsg));
   }
   
-  rc = sqlite3_step(statement);
-  while(rc != SQLITE_DONE)
+  return matcher;
+}
+
+void sqlite::mark_blacklisted(const std::vector<std::int64_t> &rowids)
+{
+  logger.info("Dropping " + std::to_string(rowids.size()) + 
+    " blacklisted links");
+  
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  transaction_guard transaction(*this);
+  
+  for(auto rowid : rowids)
   {
-    if(rc == SQLITE_ROW)
+    statement_guard guard(mark_blacklisted_stmt);
+    bind(mark_blacklisted_stmt, 1, rowid);
+    
+    int rc = sqlite3_step(mark_blacklisted_stmt);
+    if(rc != SQLITE_DONE)
     {
-      std::string bl_domain = reinterpret_cast<const char*>
-        (sqlite3_column_text(statement, 0));
-      bl_path = reinterpret_cast<const char*>
-        (sqlite3_column_text(statement, 1));
-      std::string bl_proto = reinterpret_cast<const char*>
-        (sqlite3_column_text(statement, 2));
-      
-      rc = sqlite3_step(statement);
-      
-      if(!rp.path_is_allowed(bl_path, path))
-      {
-        blacklisted = true;
-        logger.debug("Hit blacklist: " + proto +"://" + domain + path
-          + " patern: " + bl_path);
-        sleep(2);
-      }
-      
-    } else {
-      sqlite3_finalize(statement);
-      std::string errmsg = "check_bl: ";
+      std::string errmsg = "mark_blacklisted: ";
       errmsg.append(sqlite3_errstr(rc));
       throw(CrawlerException(errmsg));
     }
   }
   
-  sqlite3_finalize(statement);
-  return blacklisted;
+  transaction.commit();
 }
 
 void sqlite::remove_link(std::string domain, std::string path, std::string protocol)
 {
-  std::string sql = "DELETE FROM Links WHERE domain = '" + domain + "' AND path = '" \
-    + path + "' AND protocol = '" + protocol +"';";
-    
   logger.warn("REMOVING LINK: " + protocol + "://" + domain + path + "!");
   
-  int rc = sqlite3_exec(db, sql.c_str(), 0, 0, 0);
-  if(rc != SQLITE_OK)
-  {
-    std::string errmsg = "remove_link: ";
-    errmsg.append(sqlite3_errstr(rc));
-    errmsg.append(" " + sql);
-    throw(CrawlerException(errmsg));
-  }
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  statement_guard guard(remove_link_stmt);
+  bind(remove_link_stmt, 1, domain);
+  bind(remove_link_stmt, 2, path);
+  bind(remove_link_stmt, 3, protocol);
+  
+  step_done(remove_link_stmt, "remove_link: ");
 }
 
 void sqlite::blacklist(
@@ -381,123 +763,111 @@ void sqlite::blacklist(
   std::string protocol,
   std::string reason)
 {
-  path = boost::algorithm::replace_all_copy(path, "'", "''");
-  
-  std::string sql = "INSERT OR REPLACE INTO Blacklist (domain,path,protocol,reason) " \
-      "VALUES ('" + domain + "', '" + path + "', '" + protocol + "', '" \
-      + reason + "');";
-
   logger.info("Blacklisting: " + protocol + "://" + domain + path + " ( " + reason + ")");
 
-  int rc = sqlite3_exec(db, sql.c_str(), 0, 0, 0);
-  if(rc != SQLITE_OK)
-  {
-    std::string errmsg = "sql_blacklist_single: ";
-    errmsg.append(sqlite3_errstr(rc));
-    errmsg.append(" " + sql);
-    throw(CrawlerException(errmsg));
-  }
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  statement_guard guard(blacklist_stmt);
+  bind(blacklist_stmt, 1, domain);
+  bind(blacklist_stmt, 2, path);
+  bind(blacklist_stmt, 3, protocol);
+  bind(blacklist_stmt, 4, reason);
+  
+  step_done(blacklist_stmt, "sql_blacklist_single: ");
 }
 
 void sqlite::blacklist(v_links blacklist, std::string reason)
 {
-  std::string sql = "BEGIN";
-  int rc = sqlite3_exec(db, sql.c_str(), 0, 0, 0);
-  if(rc != SQLITE_OK)
-    logger.error("BEGIN failed");
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  transaction_guard transaction(*this);
     
   for(auto &link : blacklist)
   {
-    std::string domain = std::get<0>(link);
-    std::string path = std::get<1>(link);
-    std::string protocol = std::get<2>(link);
+    const std::string &domain = link.get_host();
+    std::string path = link.get_path().to_string();
+    const std::string &protocol = link.get_protocol();
     
     //std::size_t found;
     //if( (found = path.find("?")) != std::string::npos )
     //  continue; // We don't add these anyway
     
-    path = boost::algorithm::replace_all_copy(path, "'", "''");
+    statement_guard guard(blacklist_stmt);
+    bind(blacklist_stmt, 1, domain);
+    bind(blacklist_stmt, 2, path);
+    bind(blacklist_stmt, 3, protocol);
+    bind(blacklist_stmt, 4, reason);
     
-    sql = "INSERT OR REPLACE INTO Blacklist (domain,path,protocol,reason) " \
-      "VALUES ('" + domain + "', '" + path + "', '" + protocol + "', '" \
-      + reason + "');";
-  
-    rc = sqlite3_exec(db, sql.c_str(), 0, 0, 0);
+    int rc = sqlite3_step(blacklist_stmt);
     
     logger.info("Blacklisted: " + domain + path + " (" + protocol + ")");
   
-    if(rc != SQLITE_OK)
+    if(rc != SQLITE_DONE)
     {
       std::string errmsg = "sql_blacklist: ";
       errmsg.append(sqlite3_errstr(rc));
-      errmsg.append(" " + sql);
       throw(CrawlerException(errmsg));
     }
   }
-  sql = "COMMIT";
-  rc = sqlite3_exec(db, sql.c_str(), 0, 0, 0);
-  if(rc != SQLITE_OK)
-    logger.error("COMMIT failed");
-    
-   return;
+  
+  transaction.commit();
+  return;
 }
 
 void sqlite::set_robot_processed(std::string domain, 
   std::string protocol,
-  bool timed_out)
+  bool timed_out,
+  std::string robots)
 {
-  using namespace std::chrono;
-  system_clock::time_point tp = system_clock::now();
-  system_clock::duration dtn = tp.time_since_epoch();
-  unsigned int seconds = dtn.count() * system_clock::period::num / system_clock::period::den;
-  
+  std::int64_t seconds = now();
   if(timed_out)
     seconds = 0;
   
-  std::string sql = "INSERT OR REPLACE INTO RobotRules (domain,protocol,lastUpdated) " \
-    "VALUES ('" + domain + "', '" + protocol + "', '" + std::to_string(seconds) + "');";
-  
-  int rc = sqlite3_exec(db, sql.c_str(), 0, 0, 0);
-  
   logger.debug("Adding " + domain + " to RobotRules");
   
-  if(rc != SQLITE_OK)
-   {
-    std::string errmsg = "sql_robot: ";
-    errmsg.append(sqlite3_errstr(rc));
-    errmsg.append(" " + sql);
-    throw(CrawlerException(errmsg));
-   }
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  statement_guard guard(set_robot_processed_stmt);
+  bind(set_robot_processed_stmt, 1, domain);
+  bind(set_robot_processed_stmt, 2, protocol);
+  bind(set_robot_processed_stmt, 3, seconds);
+  bind(set_robot_processed_stmt, 4, robots);
+  
+  step_done(set_robot_processed_stmt, "sql_robot: ");
   return;
 }
 
 bool sqlite::should_process_robots(std::string domain, std::string protocol)
 {
-  bool ret;
-  sqlite3_stmt *statement;
-  std::string sql = "SELECT domain FROM RobotRules WHERE domain = '" + domain + "'" \
-    "AND protocol = '" + protocol + "';";
-  int rc = sqlite3_prepare_v2(db, sql.c_str(), -1, &statement, 0);
-  if(rc != SQLITE_OK)
-  {
-    sqlite3_finalize(statement);
-    std::string errmsg = "sql_prcRobot: ";
-    errmsg.append(sqlite3_errstr(rc));
-    throw(CrawlerException(errmsg));
-  }
+  read_lease lease(*this);
+  sqlite3_stmt *statement = lease.get().should_process_robots_stmt;
+  statement_guard guard(statement);
+  bind(statement, 1, domain);
+  bind(statement, 2, protocol);
   
-  rc = sqlite3_step(statement);
+  int rc = sqlite3_step(statement);
   if(rc == SQLITE_ROW)
-    ret = false;
-  else if(rc == SQLITE_DONE)
-    ret = true;
-  else
-  {
-    sqlite3_finalize(statement);
-    std::string errmsg = "sql_prcRobot: ";
-    errmsg.append(sqlite3_errstr(rc));
-    throw(CrawlerException(errmsg));
-  }
-  sqlite3_finalize(statement);
-  return ret;
+    return false;
+  if(rc == SQLITE_DONE)
+    return true;
+  
+  std::string errmsg = "sql_prcRobot: ";
+  errmsg.append(sqlite3_errstr(rc));
+  throw(CrawlerException(errmsg));
+}
+
+std::string sqlite::get_robots(std::string domain, std::string protocol)
+{
+  read_lease lease(*this);
+  sqlite3_stmt *statement = lease.get().get_robots_stmt;
+  statement_guard guard(statement);
+  bind(statement, 1, domain);
+  bind(statement, 2, protocol);
+  
+  int rc = sqlite3_step(statement);
+  if(rc == SQLITE_ROW)
+    return reinterpret_cast<const char*>(sqlite3_column_text(statement, 0));
+  if(rc == SQLITE_DONE)
+    return "";
+  
+  std::string errmsg = "get_robots: ";
+  errmsg.append(sqlite3_errstr(rc));
+  throw(CrawlerException(errmsg));
 }
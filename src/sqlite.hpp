@@ -25,14 +25,63 @@
 #define _SQLITE_DATABASE_H_
 
 #include <sqlite3.h>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
 #include "database.hpp"
+#include "path_matcher.hpp"
+#include "seen_filter.hpp"
 #include "logger/logger.hpp"
 
 
+/**
+ * How the sqlite database is opened
+ */
+struct sqlite_options
+{
+  /**
+   * Use the WAL journal so reads run alongside the writer
+   */
+  bool wal = true;
+  
+  /**
+   * Read-only connections for reads, used only with wal
+   */
+  std::size_t readers = 4;
+  
+  /**
+   * Page cache per connection in KiB
+   */
+  long cache_kb = 32 * 1024;
+  
+  /**
+   * Bytes of the database file memory mapped per connection
+   */
+  long long mmap_size = 256LL * 1024 * 1024;
+  
+  /**
+   * Milliseconds to wait on a locked database before failing
+   */
+  int busy_timeout = 5000;
+  
+  /**
+   * Chance a new link is taken for a stored one by the seen filter and 
+   * dropped, 0 turns the filter off
+   */
+  double seen_fp_rate = 0.001;
+  
+  /**
+   * Links the seen filter's first layer holds, it grows past this
+   */
+  std::size_t seen_capacity = 1 << 20;
+};
+
 class sqlite : public database
 {
 public:
-  sqlite(std::string databaseFile);
+  sqlite(std::string databaseFile, 
+    sqlite_options options = sqlite_options());
 
   virtual ~sqlite();
   
@@ -41,6 +90,20 @@ public:
    */
   void close_db();
   
+  /**
+   * Transactions belong to the thread that began them, another thread's 
+   * calls wait until it commits or rolls back
+   */
+  void begin();
+  
+  void commit();
+  
+  // The compact_url overloads from database
+  using database::set_visited;
+  using database::set_last_visited;
+  using database::check_blacklist;
+  using database::blacklist;
+  
   /**
    * @param links A vector of links to add to the database
    */
@@ -75,7 +138,7 @@ public:
     std::string path, 
     std::string protocol);
   
-  v_links get_links(std::size_t num);
+  v_links get_links(std::size_t num, std::int64_t &cursor);
   
   bool check_blacklist(
     std::string domain, 
@@ -100,16 +163,220 @@ public:
   void set_robot_processed(
     std::string server, 
     std::string protocol,
-    bool timed_out);
+    bool timed_out,
+    std::string robots);
   
   bool should_process_robots(
     std::string domain, 
     std::string protocol);
+  
+  std::string get_robots(
+    std::string domain, 
+    std::string protocol);
 
 private:
+  /**
+   * Resets a cached statement and clears its bindings on scope exit
+   */
+  class statement_guard
+  {
+  public:
+    statement_guard(sqlite3_stmt *statement) : statement(statement) {}
+    ~statement_guard()
+    {
+      sqlite3_reset(statement);
+      sqlite3_clear_bindings(statement);
+    }
+  private:
+    sqlite3_stmt *statement;
+  };
+  
+  /**
+   * A connection and its statements for the read queries
+   */
+  struct reader
+  {
+    sqlite3 *db = nullptr;
+    sqlite3_stmt *get_visited_stmt = nullptr;
+    sqlite3_stmt *get_links_stmt = nullptr;
+    sqlite3_stmt *check_blacklist_stmt = nullptr;
+    sqlite3_stmt *should_process_robots_stmt = nullptr;
+    sqlite3_stmt *get_robots_stmt = nullptr;
+  };
+  
+  /**
+   * Holds a reader from the pool, or the writer's mutex when there is no
+   * pool, for the life of a read
+   */
+  class read_lease
+  {
+  public:
+    read_lease(sqlite &owner);
+    ~read_lease();
+    reader& get() { return *r; }
+  private:
+    sqlite &owner;
+    reader *r;
+  };
+  
   std::string databaseFile;
-  sqlite3 *db;
+  sqlite_options options;
+  sqlite3 *db = nullptr;
+  
+  // Read statements on the writer connection, used when there are no readers
+  reader writer_reads;
+  std::vector<std::unique_ptr<reader>> readers;
+  std::vector<reader*> idle_readers;
+  std::mutex readers_mutex;
+  std::condition_variable reader_free;
+  
+  // Cached statements are shared, so only one thread may use them at once
+  std::recursive_mutex mutex;
+  std::size_t transaction_depth = 0;
+  std::vector<sqlite3_stmt*> statements;
+  
+  // Fingerprints of every stored link, so known links skip the insert
+  std::unique_ptr<seen_filter> seen;
+  // Inserted in this transaction, added to seen once it commits
+  std::vector<std::uint64_t> seen_pending;
+  
+  sqlite3_stmt *begin_stmt;
+  sqlite3_stmt *commit_stmt;
+  sqlite3_stmt *rollback_stmt;
+  sqlite3_stmt *insert_link_stmt;
+  sqlite3_stmt *set_visited_stmt;
+  sqlite3_stmt *set_last_visited_stmt;
+  sqlite3_stmt *remove_link_stmt;
+  sqlite3_stmt *mark_blacklisted_stmt;
+  sqlite3_stmt *blacklist_stmt;
+  sqlite3_stmt *set_robot_processed_stmt;
   Logger logger;
+  
+  /**
+   * Bring the schema up to date, creating the tables in a new database
+   * Each step runs in its own transaction and bumps PRAGMA user_version
+   */
+  void migrate();
+  
+  /**
+   * Run SQL on the writer connection
+   * @throw CrawlerException with errmsg if it fails
+   */
+  void exec(std::string sql, std::string errmsg);
+  
+  /**
+   * @return The first column of the first row of a query on the writer
+   */
+  std::int64_t query_int(std::string sql);
+  
+  /**
+   * Load the seen filter from its sidecar file, adding the links stored 
+   * since it was written, or build it from Links
+   */
+  void open_seen();
+  
+  /**
+   * Write the seen filter next to the database
+   */
+  void save_seen();
+  
+  /**
+   * Compile every statement once, they are reset and reused per call
+   */
+  void prepare_statements();
+  
+  /**
+   * Prepare the read queries on the reader's connection
+   */
+  void prepare_reads(reader &r);
+  
+  /**
+   * @return A compiled statement, finalized by close_db()
+   */
+  sqlite3_stmt* prepare(std::string sql);
+  
+  sqlite3_stmt* prepare(sqlite3 *conn, std::string sql);
+  
+  /**
+   * Run a pragma, a failure is only logged
+   */
+  void pragma(sqlite3 *conn, std::string sql);
+  
+  /**
+   * Apply the cache, mmap and temp store settings to a connection
+   */
+  void tune(sqlite3 *conn);
+  
+  /**
+   * Open a read-only connection and add it to the pool
+   */
+  void open_reader();
+  
+  /**
+   * Wait for a free reader
+   */
+  reader& acquire_reader();
+  
+  void release_reader(reader &r);
+  
+  /**
+   * Load a host's blacklist and compile it for matching
+   */
+  path_matcher load_blacklist(
+    reader &r,
+    const std::string &domain, 
+    const std::string &proto);
+  
+  /**
+   * Mark rows as blacklisted so they are never loaded again
+   */
+  void mark_blacklisted(const std::vector<std::int64_t> &rowids);
+  
+  void bind(sqlite3_stmt *statement, int index, const std::string &value);
+  
+  void bind(sqlite3_stmt *statement, int index, std::int64_t value);
+  
+  /**
+   * Step a statement that returns no rows
+   * @throw CrawlerException with errmsg if it fails
+   */
+  void step_done(sqlite3_stmt *statement, std::string errmsg);
+  
+  /**
+   * Roll back the outermost transaction after a failed statement
+   * Nested inside another transaction this does nothing, the statement's
+   * own changes were already undone by SQLite
+   */
+  void rollback();
+  
+  /**
+   * begin() on construction, commit() when asked, rollback() if unwound
+   * first, so a throw never leaves the transaction or its lock held
+   */
+  class transaction_guard
+  {
+  public:
+    transaction_guard(sqlite &owner) : owner(owner) { owner.begin(); }
+    ~transaction_guard()
+    {
+      if(!committed)
+        owner.rollback();
+    }
+    
+    void commit()
+    {
+      committed = true;
+      owner.commit();
+    }
+  private:
+    sqlite &owner;
+    bool committed = false;
+  };
+  
+  /**
+   * @return Seconds since the epoch
+   */
+  static std::int64_t now();
 };
 
 
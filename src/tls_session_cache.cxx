@@ -0,0 +1,137 @@
+/*
+ * WebCrawler: tls_session_cache.cxx
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file tls_session_cache.cxx
+ * @author Kyle Givler
+ */
+
+#include "tls_session_cache.hpp"
+
+tls_session_cache::tls_session_cache(std::size_t max_sessions)
+  : sslctx(asio::ssl::context::sslv23_client),
+    max_sessions(max_sessions),
+    logger("tls_session_cache")
+{
+  SSL_CTX *ctx = sslctx.native_handle();
+  
+  // Sessions are kept here by key, OpenSSL's own client cache is not
+  // looked up by host
+  SSL_CTX_set_session_cache_mode(ctx, 
+    SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+  SSL_CTX_set_ex_data(ctx, cache_index(), this);
+  SSL_CTX_sess_set_new_cb(ctx, &tls_session_cache::new_session);
+}
+
+tls_session_cache::~tls_session_cache()
+{
+  for(auto &s : order)
+    SSL_SESSION_free(s.second);
+}
+
+int tls_session_cache::connection_index()
+{
+  static int index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, 
+    nullptr);
+  return index;
+}
+
+int tls_session_cache::cache_index()
+{
+  static int index = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, 
+    nullptr);
+  return index;
+}
+
+void tls_session_cache::prepare(connection &conn, std::string host)
+{
+  SSL *ssl = conn.get_ssl_stream().native_handle();
+  SSL_set_ex_data(ssl, connection_index(), &conn);
+  SSL_set_tlsext_host_name(ssl, host.c_str());
+  
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = sessions.find(conn.get_key());
+  if(it != sessions.end())
+  {
+    order.splice(order.begin(), order, it->second);
+    // SSL_set_session takes its own reference
+    SSL_set_session(ssl, it->second->second);
+    logger.trace("Offering session: " + conn.get_key());
+  }
+}
+
+void tls_session_cache::handshake_done(connection &conn)
+{
+  bool reused = SSL_session_reused(conn.get_ssl_stream().native_handle());
+  
+  std::lock_guard<std::mutex> lock(mutex);
+  handshakes++;
+  if(reused)
+    resumed++;
+}
+
+void tls_session_cache::remove(connection &conn)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = sessions.find(conn.get_key());
+  if(it != sessions.end())
+  {
+    SSL_SESSION_free(it->second->second);
+    order.erase(it->second);
+    sessions.erase(it);
+  }
+}
+
+int tls_session_cache::new_session(SSL *ssl, SSL_SESSION *session)
+{
+  SSL_CTX *ctx = SSL_get_SSL_CTX(ssl);
+  tls_session_cache *cache = static_cast<tls_session_cache*>(
+    SSL_CTX_get_ex_data(ctx, cache_index()));
+  connection *conn = static_cast<connection*>(
+    SSL_get_ex_data(ssl, connection_index()));
+  
+  if(!cache || !conn)
+    return 0;
+  
+  cache->store(conn->get_key(), session);
+  return 1;
+}
+
+void tls_session_cache::store(std::string key, SSL_SESSION *session)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  
+  auto it = sessions.find(key);
+  if(it != sessions.end())
+  {
+    SSL_SESSION_free(it->second->second);
+    it->second->second = session;
+    order.splice(order.begin(), order, it->second);
+    return;
+  }
+  
+  order.push_front(std::make_pair(key, session));
+  sessions[key] = order.begin();
+  
+  if(sessions.size() > max_sessions)
+  {
+    SSL_SESSION_free(order.back().second);
+    sessions.erase(order.back().first);
+    order.pop_back();
+  }
+}
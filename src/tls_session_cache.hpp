@@ -0,0 +1,113 @@
+/*
+ * WebCrawler: tls_session_cache.hpp
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file tls_session_cache.hpp
+ * @author Kyle Givler
+ */
+
+#ifndef _WC_TLS_SESSION_CACHE_H_
+#define _WC_TLS_SESSION_CACHE_H_
+
+#include <boost/asio/ssl.hpp>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "connection.hpp"
+#include "logger/logger.hpp"
+
+/**
+ * The ssl context shared by all connections, along with the last TLS 
+ * session seen for each (protocol, host, port) so reconnects can resume
+ * instead of doing a full handshake. Thread safe
+ */
+class tls_session_cache
+{
+public:
+  /**
+   * @param max_sessions Most hosts a session is kept for, the least 
+   *  recently used is dropped for a new one
+   */
+  tls_session_cache(std::size_t max_sessions = 1024);
+  
+  virtual ~tls_session_cache();
+  
+  /**
+   * @return The context new connections should be created with
+   */
+  asio::ssl::context& get_context() { return this->sslctx; }
+  
+  /**
+   * Set SNI and offer the cached session, call before the handshake
+   * @param host Server name sent in the client hello
+   */
+  void prepare(connection &conn, std::string host);
+  
+  /**
+   * Count a finished handshake and whether it resumed a session
+   */
+  void handshake_done(connection &conn);
+  
+  /**
+   * Forget the session for a connection whose handshake failed
+   */
+  void remove(connection &conn);
+  
+  /**
+   * @return Number of completed handshakes
+   */
+  std::size_t get_handshakes() const { return this->handshakes; }
+  
+  /**
+   * @return Number of completed handshakes that resumed a session
+   */
+  std::size_t get_resumed() const { return this->resumed; }
+
+private:
+  typedef std::list<std::pair<std::string, SSL_SESSION*>> lru_list;
+  
+  asio::ssl::context sslctx;
+  // Most recently used first
+  lru_list order;
+  std::unordered_map<std::string, lru_list::iterator> sessions;
+  std::mutex mutex;
+  std::size_t max_sessions;
+  std::size_t handshakes = 0;
+  std::size_t resumed = 0;
+  Logger logger;
+  
+  /**
+   * SSL ex_data slot holding the connection an SSL object belongs to
+   */
+  static int connection_index();
+  
+  /**
+   * SSL_CTX ex_data slot holding this object
+   */
+  static int cache_index();
+  
+  /**
+   * OpenSSL new session callback, takes ownership of session
+   */
+  static int new_session(SSL *ssl, SSL_SESSION *session);
+  
+  void store(std::string key, SSL_SESSION *session);
+};
+
+#endif
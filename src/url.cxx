@@ -0,0 +1,378 @@
+/*
+ * WebCrawler: url.cxx
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file url.cxx
+ * @author Kyle Givler
+ */
+
+#include "url.hpp"
+#include <cstring>
+
+using boost::string_ref;
+
+namespace
+{
+  bool is_alpha(char c)
+  {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+  }
+  
+  bool is_digit(char c)
+  {
+    return c >= '0' && c <= '9';
+  }
+  
+  int hex_value(char c)
+  {
+    if(is_digit(c))
+      return c - '0';
+    if(c >= 'a' && c <= 'f')
+      return c - 'a' + 10;
+    if(c >= 'A' && c <= 'F')
+      return c - 'A' + 10;
+    return -1;
+  }
+  
+  char lower(char c)
+  {
+    return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+  }
+  
+  bool is_unreserved(char c)
+  {
+    return is_alpha(c) || is_digit(c) || c == '-' || c == '.' || c == '_' || 
+      c == '~';
+  }
+  
+  // Allowed as is in a path, pchar and '/', RFC 3986 section 3.3
+  bool is_path_char(char c)
+  {
+    return is_unreserved(c) || (c != '\0' && std::strchr("!$&'()*+,;=:@/", c));
+  }
+  
+  // Leading and trailing spaces and control characters are not part of 
+  // an href, and tabs and newlines inside it are dropped
+  string_ref trim(string_ref s)
+  {
+    while(!s.empty() && static_cast<unsigned char>(s.front()) <= ' ')
+      s.remove_prefix(1);
+    while(!s.empty() && static_cast<unsigned char>(s.back()) <= ' ')
+      s.remove_suffix(1);
+    return s;
+  }
+  
+  bool equals_lower(string_ref s, const char *lower_case)
+  {
+    std::size_t n = std::strlen(lower_case);
+    if(s.size() != n)
+      return false;
+    for(std::size_t i = 0; i < n; i++)
+      if(lower(s[i]) != lower_case[i])
+        return false;
+    return true;
+  }
+  
+  const char hex_digits[] = "0123456789ABCDEF";
+}
+
+url::parts url::split(string_ref ref)
+{
+  // RFC 3986 appendix B, with the scheme checked against its grammar
+  parts p;
+  
+  std::size_t colon = ref.find(':');
+  if(colon != string_ref::npos && colon > 0 && is_alpha(ref[0]))
+  {
+    bool scheme = true;
+    for(std::size_t i = 1; i < colon && scheme; i++)
+      scheme = is_alpha(ref[i]) || is_digit(ref[i]) || ref[i] == '+' || 
+        ref[i] == '-' || ref[i] == '.';
+    if(scheme)
+    {
+      p.scheme = ref.substr(0, colon);
+      p.has_scheme = true;
+      ref.remove_prefix(colon + 1);
+    }
+  }
+  
+  if(ref.size() >= 2 && ref[0] == '/' && ref[1] == '/')
+  {
+    ref.remove_prefix(2);
+    std::size_t end = ref.find_first_of("/?#");
+    if(end == string_ref::npos)
+      end = ref.size();
+    p.authority = ref.substr(0, end);
+    p.has_authority = true;
+    ref.remove_prefix(end);
+  }
+  
+  std::size_t hash = ref.find('#');
+  if(hash != string_ref::npos)
+  {
+    p.fragment = ref.substr(hash + 1);
+    p.has_fragment = true;
+    ref = ref.substr(0, hash);
+  }
+  
+  std::size_t question = ref.find('?');
+  if(question != string_ref::npos)
+  {
+    p.query = ref.substr(question + 1);
+    p.has_query = true;
+    ref = ref.substr(0, question);
+  }
+  
+  p.path = ref;
+  return p;
+}
+
+bool url::normalize(string_ref absolute, std::string &out)
+{
+  return resolve(parts(), absolute, out);
+}
+
+bool url::resolve(const parts &base, string_ref ref, std::string &out)
+{
+  out.clear();
+  parts r = split(trim(ref));
+  
+  // Section 5.2.2, only the merged path is built separately
+  string_ref scheme = r.has_scheme ? r.scheme : base.scheme;
+  if(!equals_lower(scheme, "http") && !equals_lower(scheme, "https"))
+    return false;
+  
+  const parts &from = (r.has_scheme || r.has_authority) ? r : base;
+  if(!from.has_authority)
+    return false;
+  
+  for(char c : scheme)
+    out += lower(c);
+  out += "://";
+  if(!append_authority(from.authority, scheme, out))
+    return false;
+  
+  std::size_t path_start = out.size();
+  const parts *query = &r;
+  if(r.has_scheme || r.has_authority || r.path.starts_with('/'))
+  {
+    append_encoded(r.path, false, out);
+  } 
+  else if(r.path.empty())
+  {
+    append_encoded(base.path, false, out);
+    if(!r.has_query)
+      query = &base;
+  } 
+  else 
+  { // Merge, section 5.2.3
+    if(base.path.empty())
+      out += '/';
+    else
+      append_encoded(base.path.substr(0, base.path.rfind('/') + 1), false, 
+        out);
+    append_encoded(r.path, false, out);
+  }
+  
+  if(out.size() == path_start || out[path_start] != '/')
+    out.insert(out.begin() + path_start, '/');
+  remove_dot_segments(out, path_start);
+  
+  // An empty query is dropped along with the fragment
+  if(query->has_query && !query->query.empty())
+  {
+    out += '?';
+    append_encoded(query->query, true, out);
+  }
+  
+  return true;
+}
+
+bool url::split_link(
+  std::string link,
+  std::string &protocol,
+  std::string &domain,
+  std::string &path)
+{
+  if(link.find("://") == std::string::npos)
+    link.insert(0, "http://"); // assume http
+  
+  std::string normalized;
+  if(!normalize(link, normalized))
+    return false;
+  
+  parts p = split(normalized);
+  protocol.assign(p.scheme.data(), p.scheme.size());
+  domain.assign(p.authority.data(), p.authority.size());
+  path.assign(p.path.data(), p.path.size());
+  if(p.has_query)
+  {
+    path += '?';
+    path.append(p.query.data(), p.query.size());
+  }
+  return true;
+}
+
+bool url::split_host_port(
+  string_ref authority, 
+  string_ref &host, 
+  unsigned int &port)
+{
+  std::size_t at = authority.rfind('@');
+  if(at != string_ref::npos)
+    authority.remove_prefix(at + 1);
+  
+  // An IPv6 literal holds colons of its own
+  std::size_t colon = authority.rfind(':');
+  std::size_t bracket = authority.rfind(']');
+  if(colon == string_ref::npos || 
+     (bracket != string_ref::npos && bracket > colon))
+  {
+    host = authority;
+    return true;
+  }
+  
+  host = authority.substr(0, colon);
+  string_ref digits = authority.substr(colon + 1);
+  if(digits.empty())
+    return true;
+  
+  unsigned long value = 0;
+  for(char c : digits)
+  {
+    if(!is_digit(c) || (value = value * 10 + (c - '0')) > 65535)
+      return false;
+  }
+  port = value;
+  return true;
+}
+
+bool url::append_authority(string_ref authority, string_ref scheme, 
+  std::string &out)
+{
+  unsigned int default_port = equals_lower(scheme, "https") ? 443 : 80;
+  unsigned int port = default_port;
+  string_ref host;
+  if(!split_host_port(authority, host, port))
+    return false;
+  
+  while(!host.empty() && host.back() == '.')
+    host.remove_suffix(1);
+  if(host.empty())
+    return false;
+  
+  for(char c : host)
+  {
+    if(!is_unreserved(c) && c != '[' && c != ']' && c != ':')
+      return false;
+    out += lower(c);
+  }
+  
+  if(port != default_port)
+  {
+    out += ':';
+    out += std::to_string(port);
+  }
+  return true;
+}
+
+void url::append_encoded(string_ref s, bool query, std::string &out)
+{
+  for(std::size_t i = 0; i < s.size(); i++)
+  {
+    char c = s[i];
+    if(c == '%')
+    {
+      int high = i + 2 < s.size() ? hex_value(s[i + 1]) : -1;
+      int low = high >= 0 ? hex_value(s[i + 2]) : -1;
+      if(low < 0)
+      { // A lone '%' stands for itself
+        out += "%25";
+        continue;
+      }
+      
+      char decoded = static_cast<char>(high * 16 + low);
+      if(is_unreserved(decoded))
+        out += decoded;
+      else
+      {
+        out += '%';
+        out += hex_digits[high];
+        out += hex_digits[low];
+      }
+      i += 2;
+    }
+    else if(c == '\t' || c == '\n' || c == '\r')
+      continue;
+    else if(is_path_char(c) || (query && c == '?'))
+      out += c;
+    else
+    {
+      unsigned char byte = static_cast<unsigned char>(c);
+      out += '%';
+      out += hex_digits[byte >> 4];
+      out += hex_digits[byte & 0xf];
+    }
+  }
+}
+
+void url::remove_dot_segments(std::string &out, std::size_t start)
+{
+  // Section 5.2.4 in place, the output never runs ahead of the input.
+  // Each step reads the '/' and the segment after it
+  std::size_t end = out.size();
+  std::size_t read = start;
+  std::size_t write = start;
+  
+  while(read < end)
+  {
+    std::size_t next = out.find('/', read + 1);
+    if(next == std::string::npos)
+      next = end;
+    
+    std::size_t length = next - read - 1;
+    const char *segment = out.data() + read + 1;
+    bool last = next == end;
+    
+    if(length == 1 && segment[0] == '.')
+    {
+      if(last)
+        out[write++] = '/';
+    }
+    else if(length == 2 && segment[0] == '.' && segment[1] == '.')
+    {
+      // Back to the '/' starting the last segment written
+      if(write > start)
+        write = out.rfind('/', write - 1);
+      if(last)
+        out[write++] = '/';
+    }
+    else
+    {
+      out[write++] = '/';
+      for(std::size_t i = 0; i < length; i++)
+        out[write++] = segment[i];
+    }
+    
+    read = next;
+  }
+  
+  if(write == start)
+    out[write++] = '/';
+  out.resize(write);
+}
@@ -0,0 +1,119 @@
+/*
+ * WebCrawler: url.hpp
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file url.hpp
+ * @author Kyle Givler
+ */
+
+#ifndef _WC_URL_H_
+#define _WC_URL_H_
+
+#include <boost/utility/string_ref.hpp>
+#include <string>
+
+/**
+ * RFC 3986 URL parsing, reference resolution and normalization
+ * Parts are views into the parsed string and results are written into a 
+ * caller's buffer, so a buffer reused across calls stops allocating
+ */
+class url
+{
+public:
+  /**
+   * The components of a URL reference, RFC 3986 section 3
+   * A component that is absent is empty with its has_ flag false
+   */
+  struct parts
+  {
+    boost::string_ref scheme;
+    boost::string_ref authority;
+    boost::string_ref path;
+    boost::string_ref query;
+    boost::string_ref fragment;
+    bool has_scheme = false;
+    bool has_authority = false;
+    bool has_query = false;
+    bool has_fragment = false;
+  };
+  
+  /**
+   * Split a reference into its components, nothing is validated
+   */
+  static parts split(boost::string_ref ref);
+  
+  /**
+   * Resolve a reference against a base URL and normalize the result:
+   * lower case scheme and host, no userinfo, default port or fragment, 
+   * dot segments removed, percent-encodings upper case and unreserved 
+   * characters decoded
+   * @param base An absolute URL
+   * @param out Set to scheme://host[:port]/path[?query]
+   * @return false if the result is not an http or https URL with a host
+   */
+  static bool resolve(const parts &base, boost::string_ref ref, 
+    std::string &out);
+  
+  /**
+   * Normalize an absolute URL, see resolve()
+   */
+  static bool normalize(boost::string_ref absolute, std::string &out);
+  
+  /**
+   * Normalize a link and split it into the columns it is stored under,
+   * http is assumed when it has no scheme
+   * @param path Set to the path and query
+   * @return false if the link is not a crawlable URL
+   */
+  static bool split_link(
+    std::string link,
+    std::string &protocol,
+    std::string &domain,
+    std::string &path);
+  
+  /**
+   * Split an authority into host and port
+   * @param port Left alone when the authority has no port
+   * @return false if the port is not a number below 65536
+   */
+  static bool split_host_port(
+    boost::string_ref authority, 
+    boost::string_ref &host, 
+    unsigned int &port);
+  
+private:
+  /**
+   * Append a normalized host[:port], dropping the scheme's default port
+   */
+  static bool append_authority(boost::string_ref authority, 
+    boost::string_ref scheme, std::string &out);
+  
+  /**
+   * Append a path or query with its percent-encodings normalized and
+   * characters that may not appear in a URL encoded
+   */
+  static void append_encoded(boost::string_ref s, bool query, 
+    std::string &out);
+  
+  /**
+   * Remove "." and ".." segments from the absolute path in out[start..]
+   */
+  static void remove_dot_segments(std::string &out, std::size_t start);
+};
+
+#endif
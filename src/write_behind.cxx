@@ -0,0 +1,295 @@
+/*
+ * WebCrawler: write_behind.cxx
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file write_behind.cxx
+ * @author Kyle Givler
+ */
+
+#include "write_behind.hpp"
+#include <algorithm>
+#include <exception>
+
+write_behind::write_behind(database *db, 
+  std::size_t max_batch, 
+  double interval)
+  : db(db),
+    max_batch(max_batch == 0 ? 1 : max_batch),
+    interval(static_cast<long>(interval * 1000)),
+    logger("write_behind")
+{
+  writer = std::thread(&write_behind::run, this);
+}
+
+write_behind::~write_behind()
+{
+  close_db();
+}
+
+void write_behind::close_db()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(closed)
+      return;
+    closed = true;
+    stopping = true;
+  }
+  
+  wake.notify_one();
+  writer.join();
+  
+  logger.debug("Wrote " + std::to_string(writes) + " changes in " + 
+    std::to_string(batches) + " transactions");
+  db->close_db();
+}
+
+void write_behind::flush()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  if(closed)
+    return;
+  
+  std::size_t target = enqueued;
+  if(writes >= target)
+    return;
+  
+  flush_to = std::max(flush_to, target);
+  wake.notify_one();
+  flushed.wait(lock, [this, target] { return writes >= target; });
+}
+
+void write_behind::enqueue(write w)
+{
+  std::size_t size;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(closed)
+    {
+      logger.warn("Database closed, dropping a write");
+      return;
+    }
+    queued.push_back(w);
+    enqueued++;
+    size = queued.size();
+  }
+  
+  if(size >= max_batch)
+    wake.notify_one();
+}
+
+void write_behind::run()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  
+  while(true)
+  {
+    wake.wait_for(lock, interval, [this] { 
+      return stopping || flush_to > writes || queued.size() >= max_batch; });
+    
+    if(queued.empty())
+    {
+      if(stopping)
+        return;
+      continue;
+    }
+    
+    std::vector<write> batch;
+    batch.swap(queued);
+    writing_robots.swap(queued_robots);
+    writing = true;
+    lock.unlock();
+    
+    // Nothing may escape the writer thread, it would take the crawler down
+    try
+    {
+      db->begin();
+    } catch (std::exception &e) {
+      logger.error(std::string("Begin failed: ") + e.what());
+    }
+    
+    for(auto &w : batch)
+    {
+      // One failed write should not cost the rest of the batch
+      try
+      {
+        w(*db);
+      } catch (std::exception &e) {
+        logger.error(std::string("Write failed: ") + e.what());
+      }
+    }
+    
+    try
+    {
+      db->commit();
+    } catch (std::exception &e) {
+      logger.error(std::string("Commit failed: ") + e.what());
+    }
+    
+    lock.lock();
+    writing = false;
+    writing_robots.clear();
+    batches++;
+    writes += batch.size();
+    flushed.notify_all();
+  }
+}
+
+void write_behind::add_links(std::vector<std::string> links)
+{
+  enqueue([links](database &d) { d.add_links(links); });
+}
+
+void write_behind::add_link(std::string link)
+{
+  enqueue([link](database &d) { d.add_link(link); });
+}
+
+bool write_behind::get_visited(
+  std::string domain, 
+  std::string path, 
+  std::string protocol)
+{
+  flush();
+  return db->get_visited(domain, path, protocol);
+}
+
+void write_behind::set_visited(
+  std::string domain,
+  std::string path,
+  std::string protocol,
+  unsigned int code)
+{
+  enqueue([=](database &d) { d.set_visited(domain, path, protocol, code); });
+}
+
+void write_behind::set_visited(const compact_url &link, unsigned int code)
+{
+  enqueue([=](database &d) { d.set_visited(link, code); });
+}
+
+void write_behind::set_last_visited(
+  std::string domain,
+  std::string path,
+  std::string protocol)
+{
+  enqueue([=](database &d) { d.set_last_visited(domain, path, protocol); });
+}
+
+void write_behind::set_last_visited(const compact_url &link)
+{
+  enqueue([=](database &d) { d.set_last_visited(link); });
+}
+
+v_links write_behind::get_links(std::size_t num, std::int64_t &cursor)
+{
+  // Links queued by finished pages must be in the table before it is read
+  flush();
+  return db->get_links(num, cursor);
+}
+
+bool write_behind::check_blacklist(
+  std::string domain, 
+  std::string path, 
+  std::string proto)
+{
+  flush();
+  return db->check_blacklist(domain, path, proto);
+}
+
+bool write_behind::check_blacklist(const compact_url &link)
+{
+  flush();
+  return db->check_blacklist(link);
+}
+
+void write_behind::remove_link(
+  std::string domain, 
+  std::string path, 
+  std::string protocol)
+{
+  enqueue([=](database &d) { d.remove_link(domain, path, protocol); });
+}
+
+void write_behind::blacklist(v_links blacklist, std::string reason)
+{
+  enqueue([=](database &d) { d.blacklist(blacklist, reason); });
+}
+
+void write_behind::blacklist(
+  std::string domain, 
+  std::string path, 
+  std::string protocol,
+  std::string reason)
+{
+  enqueue([=](database &d) { d.blacklist(domain, path, protocol, reason); });
+}
+
+void write_behind::blacklist(const compact_url &link, std::string reason)
+{
+  enqueue([=](database &d) { d.blacklist(link, reason); });
+}
+
+void write_behind::set_robot_processed(
+  std::string server, 
+  std::string protocol,
+  bool timed_out,
+  std::string robots)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(!closed)
+      queued_robots[robots_key(server, protocol)] = robots;
+  }
+  
+  enqueue([=](database &d) { 
+    d.set_robot_processed(server, protocol, timed_out, robots); });
+}
+
+bool write_behind::should_process_robots(
+  std::string domain, 
+  std::string protocol)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::string key = robots_key(domain, protocol);
+    if(queued_robots.count(key) || writing_robots.count(key))
+      return false;
+  }
+  
+  return db->should_process_robots(domain, protocol);
+}
+
+std::string write_behind::get_robots(
+  std::string domain, 
+  std::string protocol)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::string key = robots_key(domain, protocol);
+    // The queued text is newer than the one being written
+    auto found = queued_robots.find(key);
+    if(found != queued_robots.end())
+      return found->second;
+    found = writing_robots.find(key);
+    if(found != writing_robots.end())
+      return found->second;
+  }
+  
+  return db->get_robots(domain, protocol);
+}
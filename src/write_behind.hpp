@@ -0,0 +1,189 @@
+/*
+ * WebCrawler: write_behind.hpp
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file write_behind.hpp
+ * @author Kyle Givler
+ */
+
+#ifndef _WC_WRITE_BEHIND_H_
+#define _WC_WRITE_BEHIND_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <map>
+#include <thread>
+#include <vector>
+#include "database.hpp"
+#include "logger/logger.hpp"
+
+/**
+ * A database that queues writes and applies them to another database on
+ * its own thread, many at a time in one transaction. Reads wait for the
+ * queued writes first. close_db() writes everything still queued
+ */
+class write_behind : public database
+{
+public:
+  /**
+   * @param db The database written to, owned by this object
+   * @param max_batch Queued writes that trigger a flush
+   * @param interval Seconds queued writes may wait before a flush
+   */
+  write_behind(database *db, 
+    std::size_t max_batch = 1000, 
+    double interval = 1.0);
+  
+  virtual ~write_behind();
+  
+  /**
+   * Write everything queued, stop the writer and close the database
+   */
+  void close_db();
+  
+  /**
+   * Writes are already batched into transactions, these do nothing
+   */
+  void begin() {}
+  
+  void commit() {}
+  
+  /**
+   * Block until every write queued before the call is committed, later
+   * writes are not waited for
+   */
+  void flush();
+  
+  void add_links(std::vector<std::string> links);
+  
+  void add_link(std::string link);
+  
+  bool get_visited(
+    std::string domain, 
+    std::string path, 
+    std::string protocol);
+  
+  void set_visited(
+    std::string domain,
+    std::string path, 
+    std::string protocol,
+    unsigned int code);
+  
+  /**
+   * Queued as the compact_url, its strings are made on the writer thread
+   */
+  void set_visited(const compact_url &link, unsigned int code);
+  
+  void set_last_visited(
+    std::string domain, 
+    std::string path, 
+    std::string protocol);
+  
+  void set_last_visited(const compact_url &link);
+  
+  v_links get_links(std::size_t num, std::int64_t &cursor);
+  
+  bool check_blacklist(
+    std::string domain, 
+    std::string path, 
+    std::string proto);
+  
+  bool check_blacklist(const compact_url &link);
+  
+  void remove_link(
+    std::string domain, 
+    std::string path, 
+    std::string protocol);
+  
+  void blacklist(
+    v_links blacklist, 
+    std::string reason = "default");
+  
+  void blacklist(
+    std::string domain, 
+    std::string path, 
+    std::string protocol, 
+    std::string reason = "default");
+  
+  void blacklist(
+    const compact_url &link, 
+    std::string reason = "default");
+  
+  void set_robot_processed(
+    std::string server, 
+    std::string protocol,
+    bool timed_out,
+    std::string robots);
+  
+  /**
+   * Answered without a flush, a queued set_robot_processed() counts
+   */
+  bool should_process_robots(
+    std::string domain, 
+    std::string protocol);
+  
+  /**
+   * Answered without a flush, like should_process_robots()
+   */
+  std::string get_robots(
+    std::string domain, 
+    std::string protocol);
+
+private:
+  typedef std::function<void(database&)> write;
+  
+  std::unique_ptr<database> db;
+  std::size_t max_batch;
+  std::chrono::milliseconds interval;
+  
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable flushed;
+  std::vector<write> queued;
+  // robots.txt text of the queued and the writing set_robot_processed()
+  std::map<std::string, std::string> queued_robots;
+  std::map<std::string, std::string> writing_robots;
+  bool writing = false;
+  bool stopping = false;
+  bool closed = false;
+  std::size_t batches = 0;
+  // Writes enqueued and applied so far, a flush waits for writes to reach
+  // the enqueued count it started with
+  std::size_t enqueued = 0;
+  std::size_t writes = 0;
+  std::size_t flush_to = 0;
+  std::thread writer;
+  Logger logger;
+  
+  void enqueue(write w);
+  
+  /**
+   * Writer thread, applies queued writes until close_db()
+   */
+  void run();
+  
+  static std::string robots_key(std::string domain, std::string protocol)
+  {
+    return protocol + "://" + domain;
+  }
+};
+
+#endif
@@ -0,0 +1,271 @@
+/*
+ * WebCrawler: body_bench.cpp
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file body_bench.cpp
+ * @author Kyle Givler
+ * 
+ * Bytes copied and heap allocations per MB of body fetched, reading 
+ * pages the way http_client did: into an asio::streambuf, then appended
+ * to a std::string; and the way it does now: into buffer_chain blocks,
+ * straight off the socket when the body is not compressed. The copy out
+ * of the socket is the same for both and is not counted, nor are moves
+ * inside the streambuf
+ * Usage: body_bench [page KiB] [pages]
+ */
+
+#include <boost/asio/streambuf.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <zlib.h>
+#include "buffer_chain.hpp"
+#include "content_decoder.hpp"
+#include "http_body_decoder.hpp"
+
+static std::atomic<std::size_t> allocations(0);
+
+void* operator new(std::size_t size)
+{
+  allocations++;
+  void *p = std::malloc(size ? size : 1);
+  if(!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void *p) noexcept
+{
+  std::free(p);
+}
+
+void* operator new[](std::size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete[](void *p) noexcept
+{
+  operator delete(p);
+}
+
+/**
+ * http_request's body as it was, counting what append() and growing 
+ * the string copy
+ */
+class string_sink : public body_sink
+{
+public:
+  std::string data;
+  std::size_t copied = 0;
+  
+  void append_body(const char *data, std::size_t size)
+  {
+    if(this->data.size() + size > this->data.capacity())
+      copied += this->data.size();
+    this->data.append(data, size);
+    copied += size;
+  }
+};
+
+class chain_sink : public body_sink
+{
+public:
+  buffer_chain data;
+  
+  void append_body(const char *data, std::size_t size)
+  {
+    this->data.append(data, size);
+  }
+};
+
+struct result
+{
+  std::size_t copied = 0;
+  std::size_t allocations = 0;
+  double seconds = 0;
+};
+
+typedef std::chrono::steady_clock bench_clock;
+
+// Socket reads come in pieces of up to this much
+static const std::size_t max_read = 16 * 1024;
+
+static std::string chunked(const std::string &body)
+{
+  std::string out;
+  for(std::size_t pos = 0; pos < body.size(); pos += 8192)
+  {
+    std::size_t n = std::min<std::size_t>(body.size() - pos, 8192);
+    char size[32];
+    std::snprintf(size, sizeof(size), "%zx\r\n", n);
+    out += size + body.substr(pos, n) + "\r\n";
+  }
+  return out + "0\r\n\r\n";
+}
+
+static std::string gzip(const std::string &body)
+{
+  z_stream zs = z_stream();
+  deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 31, 8, 
+    Z_DEFAULT_STRATEGY);
+  std::string out(deflateBound(&zs, body.size()), '\0');
+  zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(body.data()));
+  zs.avail_in = body.size();
+  zs.next_out = reinterpret_cast<Bytef*>(&out[0]);
+  zs.avail_out = out.size();
+  deflate(&zs, Z_FINISH);
+  out.resize(zs.total_out);
+  deflateEnd(&zs);
+  return out;
+}
+
+static result run_before(const std::string &wire, BodyFraming framing, 
+  const std::string &encoding, std::size_t pages, std::mt19937 &rng)
+{
+  result r;
+  std::size_t start_allocs = allocations;
+  auto start = bench_clock::now();
+  
+  for(std::size_t p = 0; p < pages; p++)
+  {
+    boost::asio::streambuf response_buf;
+    string_sink sink;
+    http_body_decoder body;
+    content_decoder content;
+    body.reset(framing, wire.size());
+    content.reset(encoding, &sink, 64 * 1024 * 1024);
+    
+    for(std::size_t pos = 0; pos < wire.size() && !body.is_complete(); )
+    {
+      std::size_t n = std::min(wire.size() - pos, 1 + rng() % max_read);
+      auto space = response_buf.prepare(n);
+      wire.copy(boost::asio::buffer_cast<char*>(space), n, pos);
+      response_buf.commit(n);
+      pos += n;
+      
+      std::size_t used = body.decode(boost::asio::buffer_cast<const char*>(
+        response_buf.data()), response_buf.size(), content);
+      response_buf.consume(used);
+    }
+    r.copied += sink.copied;
+  }
+  
+  r.seconds = std::chrono::duration<double>(bench_clock::now() - start)
+    .count();
+  r.allocations = allocations - start_allocs;
+  return r;
+}
+
+static result run_after(const std::string &wire, BodyFraming framing, 
+  const std::string &encoding, std::size_t pages, std::mt19937 &rng)
+{
+  result r;
+  std::size_t start_allocs = allocations;
+  auto start = bench_clock::now();
+  
+  for(std::size_t p = 0; p < pages; p++)
+  {
+    boost::asio::streambuf response_buf;
+    chain_sink sink;
+    http_body_decoder body;
+    content_decoder content;
+    body.reset(framing, wire.size());
+    content.reset(encoding, &sink, 64 * 1024 * 1024);
+    
+    for(std::size_t pos = 0; pos < wire.size() && !body.is_complete(); )
+    {
+      std::size_t n = std::min(wire.size() - pos, 1 + rng() % max_read);
+      if(content.get_encoding() == ContentEncoding::IDENTITY)
+      {
+        boost::asio::mutable_buffers_1 space = sink.data.prepare();
+        n = std::min(n, boost::asio::buffer_size(space));
+        char *to = boost::asio::buffer_cast<char*>(space);
+        wire.copy(to, n, pos);
+        body.decode(to, n, content);
+      }
+      else
+      {
+        auto space = response_buf.prepare(n);
+        wire.copy(boost::asio::buffer_cast<char*>(space), n, pos);
+        response_buf.commit(n);
+        std::size_t used = body.decode(boost::asio::buffer_cast<const char*>(
+          response_buf.data()), response_buf.size(), content);
+        response_buf.consume(used);
+      }
+      pos += n;
+    }
+    r.copied += sink.data.get_copied();
+  }
+  
+  r.seconds = std::chrono::duration<double>(bench_clock::now() - start)
+    .count();
+  r.allocations = allocations - start_allocs;
+  return r;
+}
+
+static void print(const char *name, const result &r, double mb)
+{
+  std::cout << "  " << std::setw(6) << std::left << name << std::right
+    << std::setw(8) << r.copied / mb / 1e6 << " bytes copied/byte, "
+    << std::setw(8) << r.allocations / mb << " allocations/MB, "
+    << std::setw(8) << mb / r.seconds << " MB/s\n";
+}
+
+int main(int argc, char **argv)
+{
+  std::size_t page_kib = argc > 1 ? std::stoul(argv[1]) : 512;
+  std::size_t pages = argc > 2 ? std::stoul(argv[2]) : 200;
+  
+  std::mt19937 rng(1);
+  std::string page(page_kib * 1024, ' ');
+  for(auto &c : page)
+    c = "<a href=\"/x\">text</a> "[rng() % 22];
+  
+  struct bench_case
+  {
+    const char *name;
+    BodyFraming framing;
+    const char *encoding;
+    std::string wire;
+  };
+  bench_case cases[] = {
+    { "Content-Length", BodyFraming::CONTENT_LENGTH, "", page },
+    { "chunked", BodyFraming::CHUNKED, "", chunked(page) },
+    { "gzip", BodyFraming::CONTENT_LENGTH, "gzip", gzip(page) } };
+  
+  // The pool is warm in a running crawler
+  run_after(cases[0].wire, cases[0].framing, "", 1, rng);
+  
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << pages << " pages of " << page_kib << " KiB\n";
+  double mb = pages * page.size() / 1e6;
+  for(auto &c : cases)
+  {
+    std::cout << c.name << "\n";
+    print("before", run_before(c.wire, c.framing, c.encoding, pages, rng), 
+      mb);
+    print("after", run_after(c.wire, c.framing, c.encoding, pages, rng), mb);
+  }
+  return 0;
+}
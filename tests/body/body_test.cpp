@@ -0,0 +1,202 @@
+/*
+ * WebCrawler: body_test.cpp
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file body_test.cpp
+ * @author Kyle Givler
+ * 
+ * Reads bodies into a buffer_chain the way http_client does, framed by
+ * Content-Length, chunked and until close, plain and gzipped, in random 
+ * read sizes. The chain must hold the body, and plain bodies that are not
+ * chunked must not be copied at all
+ */
+
+#include <iostream>
+#include <random>
+#include <string>
+#include <zlib.h>
+#include "buffer_chain.hpp"
+#include "content_decoder.hpp"
+#include "http_body_decoder.hpp"
+#include "../check.hpp"
+
+class chain_sink : public body_sink
+{
+public:
+  buffer_chain data;
+  
+  void append_body(const char *data, std::size_t size)
+  {
+    this->data.append(data, size);
+  }
+};
+
+static std::string random_body(std::size_t size, std::mt19937 &rng)
+{
+  std::string body(size, ' ');
+  for(auto &c : body)
+    c = 'a' + rng() % 26;
+  return body;
+}
+
+static std::string chunked(const std::string &body, std::mt19937 &rng)
+{
+  std::string out;
+  std::size_t pos = 0;
+  while(pos < body.size())
+  {
+    std::size_t n = std::min<std::size_t>(body.size() - pos, 
+      1 + rng() % 40000);
+    char size[32];
+    std::snprintf(size, sizeof(size), "%zx\r\n", n);
+    out += size + body.substr(pos, n) + "\r\n";
+    pos += n;
+  }
+  return out + "0\r\n\r\n";
+}
+
+static std::string gzip(const std::string &body)
+{
+  z_stream zs = z_stream();
+  deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 31, 8, 
+    Z_DEFAULT_STRATEGY);
+  std::string out(deflateBound(&zs, body.size()), '\0');
+  zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(body.data()));
+  zs.avail_in = body.size();
+  zs.next_out = reinterpret_cast<Bytef*>(&out[0]);
+  zs.avail_out = out.size();
+  deflate(&zs, Z_FINISH);
+  out.resize(zs.total_out);
+  deflateEnd(&zs);
+  return out;
+}
+
+/**
+ * Read wire like http_client::read_content(): a plain body straight into
+ * the chain, a compressed one into a staging buffer first
+ */
+static void read(const std::string &wire, BodyFraming framing, 
+  const std::string &encoding, chain_sink &sink, std::mt19937 &rng)
+{
+  http_body_decoder body;
+  content_decoder content;
+  body.reset(framing, wire.size());
+  content.reset(encoding, &sink, 64 * 1024 * 1024);
+  
+  std::size_t pos = 0;
+  while(pos < wire.size() && !body.is_complete() && !body.has_error())
+  {
+    std::size_t n = std::min<std::size_t>(wire.size() - pos, 
+      1 + rng() % 20000);
+    if(content.get_encoding() == ContentEncoding::IDENTITY)
+    {
+      boost::asio::mutable_buffers_1 space = sink.data.prepare();
+      n = std::min(n, boost::asio::buffer_size(space));
+      char *to = boost::asio::buffer_cast<char*>(space);
+      wire.copy(to, n, pos);
+      body.decode(to, n, content);
+    }
+    else
+    {
+      std::string staged = wire.substr(pos, n);
+      body.decode(staged.data(), staged.size(), content);
+    }
+    pos += n;
+  }
+  body.finish();
+  content.finish();
+}
+
+static void test_append(std::mt19937 &rng)
+{
+  buffer_pool pool;
+  buffer_chain chain(pool);
+  std::string expected;
+  
+  for(int i = 0; i < 200; i++)
+  {
+    std::string piece = random_body(rng() % 5000, rng);
+    chain.append(piece.data(), piece.size());
+    expected += piece;
+  }
+  
+  CHECK("append", chain.size() == expected.size());
+  CHECK("append", chain.to_string() == expected);
+  CHECK("append", chain.prefix(512) == expected.substr(0, 512));
+  CHECK("append", chain.get_copied() == expected.size());
+  CHECK("append", chain.capacity() == 
+    chain.blocks() * buffer_pool::block_size);
+  
+  std::string joined;
+  for(std::size_t i = 0; i < chain.blocks(); i++)
+    joined += chain.block(i).to_string();
+  CHECK("append", joined == expected);
+  
+  // Blocks given back are handed out again
+  std::size_t allocated = pool.get_allocated();
+  chain.clear();
+  CHECK("pool", pool.get_in_use() == 0);
+  CHECK("pool", pool.get_free() == allocated);
+  chain.append(expected.data(), expected.size());
+  CHECK("pool", pool.get_allocated() == allocated);
+  CHECK("pool", chain.to_string() == expected);
+}
+
+static void test_read(std::mt19937 &rng)
+{
+  struct framing_case
+  {
+    const char *name;
+    BodyFraming framing;
+    bool chunk;
+  };
+  const framing_case framings[] = {
+    { "content-length", BodyFraming::CONTENT_LENGTH, false },
+    { "chunked", BodyFraming::CHUNKED, true },
+    { "until-close", BodyFraming::UNTIL_CLOSE, false } };
+  
+  for(auto &f : framings)
+    for(std::string encoding : { "", "gzip" })
+      for(std::size_t size : { 0, 1, 16383, 16384, 16385, 1000000 })
+      {
+        std::string name = std::string(f.name) + " " + encoding + " " + 
+          std::to_string(size);
+        std::string page = random_body(size, rng);
+        std::string wire = encoding.empty() ? page : gzip(page);
+        if(f.chunk)
+          wire = chunked(wire, rng);
+        
+        chain_sink sink;
+        read(wire, f.framing, encoding, sink, rng);
+        CHECK(name, sink.data.to_string() == page);
+        if(encoding.empty() && !f.chunk)
+          CHECK(name, sink.data.get_copied() == 0);
+        if(encoding.empty() && f.chunk)
+          CHECK(name, sink.data.get_copied() <= page.size());
+      }
+}
+
+int main()
+{
+  std::mt19937 rng(1);
+  test_append(rng);
+  test_read(rng);
+  
+  std::cout << (failures ? "FAILED\n" : "OK\n");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,46 @@
+/*
+ * WebCrawler: check.hpp
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file check.hpp
+ * @author Kyle Givler
+ * 
+ * CHECK(name, condition) for the tests, each failure is printed with its
+ * line and counted in failures
+ */
+
+#ifndef _WC_TEST_CHECK_H_
+#define _WC_TEST_CHECK_H_
+
+#include <iostream>
+#include <string>
+
+static int failures = 0;
+
+#define CHECK(name, c) check(name, __LINE__, #c, (c))
+
+static void check(const std::string &name, int line, const char *what, 
+  bool ok)
+{
+  if(ok)
+    return;
+  std::cout << "FAIL " << name << ":" << line << ": " << what << "\n";
+  failures++;
+}
+
+#endif
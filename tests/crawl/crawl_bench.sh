@@ -0,0 +1,76 @@
+#!/bin/sh
+#
+# WebCrawler: crawl_bench.sh
+# Copyright (C) 2014 Kyle Givler
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+#
+# Pages per second crawling fixture_server, seeded with HOSTS loopback
+# addresses that all reach it, for each client count at one io_service
+# thread and then for each thread count at 64 clients
+# Usage: crawl_bench.sh [clients|threads]
+# With LATENCY=0 the crawl is bound by CPU, which is what adding threads
+# is for
+# Environment: CRAWLER (../../src/webCrawler), SECS (20), HOSTS (32),
+#  LATENCY (20 ms per response), PORT (18080)
+
+CRAWLER=$(realpath ${CRAWLER:-../../src/webCrawler})
+SCHEMA=$(realpath ../../src/test.db)
+SECS=${SECS:-20}
+HOSTS=${HOSTS:-32}
+LATENCY=${LATENCY:-20}
+PORT=${PORT:-18080}
+
+if [ ! -x "$CRAWLER" ]; then
+  echo "Build the crawler first, or set CRAWLER" >&2
+  exit 1
+fi
+
+./fixture_server $PORT 100000 $LATENCY 4 &
+SERVER=$!
+trap 'kill $SERVER' EXIT
+sleep 0.5
+
+# crawl clients threads
+crawl()
+{
+  dir=$(mktemp -d)
+  cp "$SCHEMA" "$dir/test.db"
+  i=1
+  while [ $i -le $HOSTS ]; do
+    echo "INSERT INTO Links (domain, path, protocol) VALUES" \
+      "('127.0.0.$i:$PORT', '/', 'http');"
+    i=$((i + 1))
+  done | sqlite3 "$dir/test.db"
+  
+  (cd "$dir" && timeout -s INT $SECS "$CRAWLER" -c $1 -t $2 -d 0 -p 4 \
+    > /dev/null 2>&1)
+  visited=$(sqlite3 "$dir/test.db" "SELECT count(*) FROM Links WHERE visited=1")
+  rm -fr "$dir"
+  
+  awk -v c=$1 -v t=$2 -v n=$visited -v s=$SECS \
+    'BEGIN { printf "%4d clients %2d threads: %8.1f pages/s\n", c, t, n / s }'
+}
+
+if [ "$1" != "threads" ]; then
+  for clients in 1 2 4 8 16 32 64 128; do
+    crawl $clients 1
+  done
+fi
+
+if [ "$1" != "clients" ]; then
+  for threads in 1 2 4 8; do
+    crawl 64 $threads
+  done
+fi
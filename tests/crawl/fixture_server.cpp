@@ -0,0 +1,208 @@
+/*
+ * WebCrawler: fixture_server.cpp
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file fixture_server.cpp
+ * @author Kyle Givler
+ * 
+ * A keep-alive HTTP server for crawl benchmarks. Page /N links to ten 
+ * other pages out of a fixed number, robots.txt allows everything, and 
+ * every response can be held back to stand in for network latency 
+ * without tying up a thread
+ * Usage: fixture_server port [pages] [latency_ms] [threads]
+ */
+
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+
+using boost::asio::ip::tcp;
+using namespace boost;
+
+static std::size_t pages = 100000;
+static posix_time::time_duration latency;
+
+static std::string page_body(std::size_t n)
+{
+  std::ostringstream html;
+  html << "<!DOCTYPE html><html><head><title>Page " << n 
+       << "</title></head><body>\n";
+  for(std::size_t k = 1; k <= 10; k++)
+  {
+    html << "<p>Lorem ipsum dolor sit amet, consectetur adipiscing elit, "
+            "sed do eiusmod tempor incididunt ut labore et dolore magna "
+            "aliqua. <a href=\"/" << (n * 7 + k * 131) % pages 
+         << "\">more</a></p>\n";
+  }
+  html << "</body></html>\n";
+  return html.str();
+}
+
+class session : public std::enable_shared_from_this<session>
+{
+public:
+  session(asio::io_service &io_service)
+    : socket(io_service),
+      timer(io_service)
+  {
+  }
+  
+  tcp::socket& get_socket() { return socket; }
+  
+  void start()
+  {
+    socket.set_option(tcp::no_delay(true));
+    read_request();
+  }
+  
+private:
+  tcp::socket socket;
+  asio::deadline_timer timer;
+  asio::streambuf request;
+  std::string response;
+  bool close = false;
+  
+  void read_request()
+  {
+    asio::async_read_until(socket, request, "\r\n\r\n", 
+      bind(&session::handle_request, shared_from_this(), 
+        asio::placeholders::error));
+  }
+  
+  void handle_request(const system::error_code &err)
+  {
+    if(err)
+      return;
+    
+    std::istream in(&request);
+    std::string method, path, version, line;
+    in >> method >> path >> version;
+    std::getline(in, line);
+    close = version != "HTTP/1.1";
+    while(std::getline(in, line) && line != "\r")
+      if(line.compare(0, 17, "Connection: close") == 0)
+        close = true;
+    
+    std::string type = "text/html";
+    std::string body;
+    if(path == "/robots.txt")
+    {
+      type = "text/plain";
+      body = "User-agent: *\nDisallow:\n";
+    }
+    else
+    {
+      body = page_body(std::strtoul(path.c_str() + 1, nullptr, 10) % pages);
+    }
+    
+    std::ostringstream out;
+    out << "HTTP/1.1 200 OK\r\n"
+        << "Content-Type: " << type << "\r\n"
+        << "Content-Length: " << body.size() << "\r\n";
+    if(close)
+      out << "Connection: close\r\n";
+    out << "\r\n";
+    if(method != "HEAD")
+      out << body;
+    response = out.str();
+    
+    timer.expires_from_now(latency);
+    timer.async_wait(bind(&session::write_response, shared_from_this()));
+  }
+  
+  void write_response()
+  {
+    asio::async_write(socket, asio::buffer(response), 
+      bind(&session::handle_write, shared_from_this(), 
+        asio::placeholders::error));
+  }
+  
+  void handle_write(const system::error_code &err)
+  {
+    if(err)
+      return;
+    
+    if(close)
+    {
+      system::error_code ec;
+      socket.shutdown(tcp::socket::shutdown_both, ec);
+      return;
+    }
+    read_request();
+  }
+};
+
+class server
+{
+public:
+  server(asio::io_service &io_service, unsigned short port)
+    : io_service(io_service),
+      acceptor(io_service, tcp::endpoint(tcp::v4(), port))
+  {
+    accept();
+  }
+  
+private:
+  asio::io_service &io_service;
+  tcp::acceptor acceptor;
+  
+  void accept()
+  {
+    std::shared_ptr<session> s = std::make_shared<session>(io_service);
+    acceptor.async_accept(s->get_socket(), 
+      bind(&server::handle_accept, this, s, asio::placeholders::error));
+  }
+  
+  void handle_accept(std::shared_ptr<session> s, 
+    const system::error_code &err)
+  {
+    if(!err)
+      s->start();
+    accept();
+  }
+};
+
+int main(int argc, char **argv)
+{
+  if(argc < 2)
+  {
+    std::cerr << "Usage: " << argv[0] 
+      << " port [pages] [latency_ms] [threads]\n";
+    return 1;
+  }
+  unsigned short port = std::stoi(argv[1]);
+  if(argc > 2)
+    pages = std::stoul(argv[2]);
+  latency = posix_time::milliseconds(argc > 3 ? std::stol(argv[3]) : 0);
+  std::size_t threads = argc > 4 ? std::stoul(argv[4]) : 2;
+  
+  asio::io_service io_service;
+  server s(io_service, port);
+  
+  boost::thread_group workers;
+  for(std::size_t i = 1; i < threads; i++)
+    workers.create_thread(boost::bind(&asio::io_service::run, &io_service));
+  io_service.run();
+  workers.join_all();
+  return 0;
+}
@@ -0,0 +1,160 @@
+/*
+ * WebCrawler: gumbo_links.cpp
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file gumbo_links.cpp
+ * @author Kyle Givler
+ * 
+ * Writes page.expected next to each page from the tree Gumbo builds,
+ * the way the crawler found links before link_extractor: the href of
+ * every <a>, the first <base> and <link rel=canonical> and what a 
+ * robots <meta> asks for
+ * Usage: gumbo_links page.html...
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <gumbo.h>
+
+struct page_links
+{
+  std::vector<std::string> hrefs;
+  std::string base;
+  std::string canonical;
+  bool has_base = false;
+  bool has_canonical = false;
+  bool nofollow = false;
+  bool noindex = false;
+};
+
+static std::vector<std::string> tokens(const char *value)
+{
+  std::string list(value);
+  std::transform(list.begin(), list.end(), list.begin(), ::tolower);
+  std::replace(list.begin(), list.end(), ',', ' ');
+  
+  std::vector<std::string> out;
+  std::istringstream in(list);
+  std::string token;
+  while(in >> token)
+    out.push_back(token);
+  return out;
+}
+
+static bool has_token(const GumboElement &element, const char *attr,
+  const char *token)
+{
+  GumboAttribute *a = gumbo_get_attribute(&element.attributes, attr);
+  if(!a)
+    return false;
+  std::vector<std::string> list = tokens(a->value);
+  return std::find(list.begin(), list.end(), token) != list.end();
+}
+
+static void element(const GumboElement &e, page_links &links)
+{
+  if(e.tag_namespace != GUMBO_NAMESPACE_HTML)
+    return;
+  
+  GumboAttribute *href = gumbo_get_attribute(&e.attributes, "href");
+  if(e.tag == GUMBO_TAG_A && href)
+  {
+    links.hrefs.push_back(href->value);
+  }
+  else if(e.tag == GUMBO_TAG_BASE && href && !links.has_base)
+  {
+    links.base = href->value;
+    links.has_base = true;
+  }
+  else if(e.tag == GUMBO_TAG_LINK && href && !links.has_canonical &&
+    has_token(e, "rel", "canonical"))
+  {
+    links.canonical = href->value;
+    links.has_canonical = true;
+  }
+  else if(e.tag == GUMBO_TAG_META && has_token(e, "name", "robots"))
+  {
+    bool none = has_token(e, "content", "none");
+    links.nofollow |= none || has_token(e, "content", "nofollow");
+    links.noindex |= none || has_token(e, "content", "noindex");
+  }
+}
+
+static page_links search(GumboNode *root)
+{
+  page_links links;
+  
+  // Pages nest deeper than the stack allows, so walk the tree in 
+  // document order without recursing
+  std::vector<GumboNode*> stack(1, root);
+  while(!stack.empty())
+  {
+    GumboNode *node = stack.back();
+    stack.pop_back();
+    if(node->type != GUMBO_NODE_ELEMENT && node->type != GUMBO_NODE_TEMPLATE)
+      continue;
+    
+    element(node->v.element, links);
+    const GumboVector &children = node->v.element.children;
+    for(unsigned int i = children.length; i > 0; i--)
+      stack.push_back(static_cast<GumboNode*>(children.data[i - 1]));
+  }
+  return links;
+}
+
+int main(int argc, char **argv)
+{
+  if(argc < 2)
+  {
+    std::cerr << "Usage: " << argv[0] << " page.html...\n";
+    return 1;
+  }
+  
+  for(int i = 1; i < argc; i++)
+  {
+    std::string path = argv[i];
+    std::ifstream in(path, std::ios::binary);
+    std::stringstream page;
+    page << in.rdbuf();
+    std::string data = page.str();
+    
+    GumboOutput *output = gumbo_parse_with_options(&kGumboDefaultOptions,
+      data.data(), data.size());
+    page_links links = search(output->root);
+    gumbo_destroy_output(&kGumboDefaultOptions, output);
+    
+    std::ofstream out(path.substr(0, path.size() - 5) + ".expected");
+    // The tree builder clones <a> elements it reopens, so only the first
+    // of each href counts
+    std::set<std::string> seen;
+    for(auto &href : links.hrefs)
+      if(seen.insert(href).second)
+        out << "A " << href << "\n";
+    out << "BASE " << links.base << "\n"
+        << "CANON " << links.canonical << "\n"
+        << "NOFOLLOW " << links.nofollow << "\n"
+        << "NOINDEX " << links.noindex << "\n";
+  }
+  return 0;
+}
@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+#
+# WebCrawler: html5lib_links.py
+# Copyright (C) 2014 Kyle Givler
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+#
+# Writes page.expected next to each page from a full HTML5 tree built by
+# html5lib, for machines without Gumbo. Same output as gumbo_links.
+# Usage: html5lib_links.py page.html...
+
+import sys
+
+import html5lib
+from html5lib.constants import namespaces
+
+HTML = '{%s}' % namespaces['html']
+
+def tokens(value):
+    return value.lower().replace(',', ' ').split()
+
+def links(data):
+    doc = html5lib.parse(data, treebuilder='etree')
+    hrefs = []
+    base = canonical = None
+    nofollow = noindex = False
+    for el in doc.iter():
+        tag = el.tag if isinstance(el.tag, str) else ''
+        if tag == HTML + 'a' and 'href' in el.attrib:
+            hrefs.append(el.attrib['href'])
+        elif tag == HTML + 'base' and 'href' in el.attrib and base is None:
+            base = el.attrib['href']
+        elif (tag == HTML + 'link' and 'href' in el.attrib and canonical is None
+              and 'canonical' in tokens(el.attrib.get('rel', ''))):
+            canonical = el.attrib['href']
+        elif tag == HTML + 'meta' and 'robots' in tokens(el.attrib.get('name', '')):
+            content = tokens(el.attrib.get('content', ''))
+            nofollow |= 'nofollow' in content or 'none' in content
+            noindex |= 'noindex' in content or 'none' in content
+    # The tree builder clones <a> elements it reopens, so only the first
+    # of each href counts
+    seen = set()
+    out = ['A ' + h for h in hrefs if not (h in seen or seen.add(h))]
+    out.append('BASE ' + (base or ''))
+    out.append('CANON ' + (canonical or ''))
+    out.append('NOFOLLOW %d' % nofollow)
+    out.append('NOINDEX %d' % noindex)
+    return out
+
+for path in sys.argv[1:]:
+    # Gumbo only reads UTF-8
+    with open(path, encoding='utf-8', errors='replace') as f:
+        data = f.read()
+    with open(path[:-len('.html')] + '.expected', 'w', encoding='utf-8') as f:
+        f.write('\n'.join(links(data)) + '\n')
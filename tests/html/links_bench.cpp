@@ -0,0 +1,157 @@
+/*
+ * WebCrawler: links_bench.cpp
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file links_bench.cpp
+ * @author Kyle Givler
+ * 
+ * MB/s on one core finding the links of each page, with link_extractor
+ * fed 16 KiB pieces as they come off the socket at each byte_scanner 
+ * level the CPU has, and when built with
+ * HAVE_GUMBO the way http_request did before: gumbo_parse() the whole
+ * body, then walk the tree for <a href>
+ * Usage: links_bench page.html...
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "byte_scanner.hpp"
+#include "link_extractor.hpp"
+#ifdef HAVE_GUMBO
+#include <gumbo.h>
+#endif
+
+typedef std::chrono::steady_clock bench_clock;
+
+// Time enough rounds to read at least this much of a page
+static const std::size_t min_bytes = 100 * 1024 * 1024;
+
+static std::size_t rounds_for(const std::string &page)
+{
+  return std::max<std::size_t>(1, min_bytes / std::max<std::size_t>(1, page.size()));
+}
+
+static double seconds_since(bench_clock::time_point start)
+{
+  return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+static double extractor_mbs(const std::string &page, std::size_t &links)
+{
+  const std::size_t piece = 16 * 1024;
+  std::size_t rounds = rounds_for(page);
+  link_extractor extractor;
+  
+  auto start = bench_clock::now();
+  for(std::size_t r = 0; r < rounds; r++)
+  {
+    extractor.reset();
+    for(std::size_t pos = 0; pos < page.size(); pos += piece)
+      extractor.feed(page.data() + pos, 
+        std::min(piece, page.size() - pos));
+  }
+  double secs = seconds_since(start);
+  
+  links = extractor.get_hrefs().size();
+  return rounds * page.size() / 1e6 / secs;
+}
+
+#ifdef HAVE_GUMBO
+// http_request::search_for_links() as it was
+static void search_for_links(GumboNode *node, std::vector<std::string> &links)
+{
+  if(node->type != GUMBO_NODE_ELEMENT)
+    return;
+  
+  GumboAttribute *href;
+  if(node->v.element.tag == GUMBO_TAG_A &&
+    (href = gumbo_get_attribute(&node->v.element.attributes, "href")))
+  {
+    links.push_back(href->value);
+  }
+  
+  GumboVector *children = &node->v.element.children;
+  for(unsigned int i = 0; i < children->length; ++i)
+    search_for_links(static_cast<GumboNode*>(children->data[i]), links);
+}
+
+static double gumbo_mbs(const std::string &page, std::size_t &links)
+{
+  std::size_t rounds = rounds_for(page);
+  std::vector<std::string> found;
+  
+  auto start = bench_clock::now();
+  for(std::size_t r = 0; r < rounds; r++)
+  {
+    found.clear();
+    GumboOutput *output = gumbo_parse(page.c_str());
+    search_for_links(output->root, found);
+    gumbo_destroy_output(&kGumboDefaultOptions, output);
+  }
+  double secs = seconds_since(start);
+  
+  links = found.size();
+  return rounds * page.size() / 1e6 / secs;
+}
+#endif
+
+int main(int argc, char **argv)
+{
+  if(argc < 2)
+  {
+    std::cerr << "Usage: " << argv[0] << " page.html...\n";
+    return 1;
+  }
+  
+  std::cout << std::fixed << std::setprecision(1);
+  for(int i = 1; i < argc; i++)
+  {
+    std::ifstream in(argv[i], std::ios::binary);
+    std::stringstream data;
+    data << in.rdbuf();
+    std::string page = data.str();
+    
+    std::size_t links = 0;
+    std::cout << argv[i] << " (" << page.size() / 1024 << " KiB)\n";
+    double scalar = 0, mbs = 0;
+    for(auto level : { byte_scanner::Level::SCALAR, 
+      byte_scanner::Level::SSE2, byte_scanner::Level::AVX2 })
+    {
+      if(!byte_scanner::use(level))
+        continue;
+      mbs = extractor_mbs(page, links);
+      if(level == byte_scanner::Level::SCALAR)
+        scalar = mbs;
+      std::cout << "  link_extractor " << std::setw(6) << std::left 
+        << byte_scanner::name(level) << std::right << ": " << mbs 
+        << " MB/s, " << links << " links, " << mbs / scalar << "x\n";
+    }
+#ifdef HAVE_GUMBO
+    double before = gumbo_mbs(page, links);
+    std::cout << "  gumbo:                 " << before << " MB/s, " 
+      << links << " links, " << mbs / before << "x\n";
+#endif
+  }
+  return 0;
+}
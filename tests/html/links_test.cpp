@@ -0,0 +1,200 @@
+/*
+ * WebCrawler: links_test.cpp
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file links_test.cpp
+ * @author Kyle Givler
+ * 
+ * Feeds each page to link_extractor whole, a few bytes at a time and in
+ * random pieces of up to 4 KiB, and compares what it found with the 
+ * page.expected a full parser wrote, see gumbo_links.cpp. An href 
+ * counts once, in the order it first appears. Runs once for each
+ * byte_scanner level the CPU has, after checking the vector searches
+ * find what the scalar ones do at every offset and length
+ * Usage: links_test page.html...
+ */
+
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "byte_scanner.hpp"
+#include "link_extractor.hpp"
+
+static std::string read_file(const std::string &path)
+{
+  std::ifstream in(path, std::ios::binary);
+  std::stringstream data;
+  data << in.rdbuf();
+  return data.str();
+}
+
+static std::vector<std::string> read_lines(const std::string &path)
+{
+  std::ifstream in(path, std::ios::binary);
+  std::vector<std::string> lines;
+  std::string line;
+  while(std::getline(in, line))
+    lines.push_back(line);
+  return lines;
+}
+
+/**
+ * Feed the page in pieces of 1 to max_piece bytes, or whole if it is 0
+ * @return One line per link, in the format of page.expected
+ */
+static std::vector<std::string> extract(const std::string &page, 
+  std::size_t max_piece, std::mt19937 &rng)
+{
+  link_extractor extractor;
+  std::size_t pos = 0;
+  while(pos < page.size())
+  {
+    std::size_t n = page.size() - pos;
+    if(max_piece)
+      n = std::min<std::size_t>(n, 1 + rng() % max_piece);
+    extractor.feed(page.data() + pos, n);
+    pos += n;
+  }
+  
+  std::vector<std::string> lines;
+  std::set<std::string> seen;
+  for(auto &href : extractor.get_hrefs())
+    if(seen.insert(href).second)
+      lines.push_back("A " + href);
+  lines.push_back("BASE " + extractor.get_base());
+  lines.push_back("CANON " + extractor.get_canonical());
+  lines.push_back("NOFOLLOW " + std::to_string(extractor.get_nofollow()));
+  lines.push_back("NOINDEX " + std::to_string(extractor.get_noindex()));
+  return lines;
+}
+
+/**
+ * Compare the searches at the level in use with the scalar ones, over
+ * buffers of the bytes they stop at
+ * @return Number of mismatches
+ */
+static int check_scanner(std::mt19937 &rng)
+{
+  const char *pieces[] = { "</s", "</S", "</x", "<s", "</", "<", "/", "=",
+    ">", " ", "\t", "\n", "\f", "\r", "\v", "s", "\"", "yyyyyyyyyyyy" };
+  byte_scanner::Level level = byte_scanner::level();
+  int failures = 0;
+  
+  for(int round = 0; round < 5000; round++)
+  {
+    std::string buf;
+    while(buf.size() < 100 && rng() % 20)
+      buf += pieces[rng() % (sizeof(pieces) / sizeof(pieces[0]))];
+    const char *p = buf.data() + (buf.empty() ? 0 : rng() % buf.size());
+    const char *end = buf.data() + buf.size();
+    bool slash = rng() % 2, equals = rng() % 2;
+    char c = rng() % 2 ? 's' : 'x';
+    
+    byte_scanner::use(byte_scanner::Level::SCALAR);
+    const char *stop = byte_scanner::tag_stop(p, end, slash, equals);
+    const char *tag = byte_scanner::end_tag(p, end, c);
+    byte_scanner::use(level);
+    if(byte_scanner::tag_stop(p, end, slash, equals) != stop ||
+      byte_scanner::end_tag(p, end, c) != tag)
+    {
+      if(failures++ == 0)
+        std::cout << "FAIL " << byte_scanner::name(level) 
+          << " search differs from scalar on \"" << buf << "\"\n";
+    }
+  }
+  return failures;
+}
+
+static void print_diff(const std::vector<std::string> &got, 
+  const std::vector<std::string> &expected)
+{
+  std::set<std::string> a(got.begin(), got.end());
+  std::set<std::string> b(expected.begin(), expected.end());
+  for(auto &line : a)
+    if(!b.count(line))
+      std::cout << "  extra:   " << line << "\n";
+  for(auto &line : b)
+    if(!a.count(line))
+      std::cout << "  missing: " << line << "\n";
+  if(a == b)
+    std::cout << "  same links, different order\n";
+}
+
+int main(int argc, char **argv)
+{
+  if(argc < 2)
+  {
+    std::cerr << "Usage: " << argv[0] << " page.html...\n";
+    return 1;
+  }
+  
+  std::mt19937 rng(1);
+  const std::size_t pieces[] = { 0, 3, 4096 };
+  int failures = 0;
+  
+  std::vector<byte_scanner::Level> levels;
+  for(auto level : { byte_scanner::Level::SCALAR, byte_scanner::Level::SSE2,
+    byte_scanner::Level::AVX2 })
+    if(byte_scanner::use(level))
+    {
+      levels.push_back(level);
+      failures += check_scanner(rng);
+    }
+  
+  for(int i = 1; i < argc; i++)
+  {
+    std::string path = argv[i];
+    std::string page = read_file(path);
+    std::vector<std::string> expected = 
+      read_lines(path.substr(0, path.size() - 5) + ".expected");
+    if(expected.empty())
+    {
+      std::cout << "FAIL " << path << ": no .expected\n";
+      failures++;
+      continue;
+    }
+    
+    for(auto level : levels)
+    {
+      byte_scanner::use(level);
+      for(std::size_t max_piece : pieces)
+      {
+        std::vector<std::string> got = extract(page, max_piece, rng);
+        if(got != expected)
+        {
+          std::cout << "FAIL " << path << " at " 
+            << byte_scanner::name(level);
+          if(max_piece)
+            std::cout << " in pieces of up to " << max_piece << " bytes";
+          std::cout << "\n";
+          print_diff(got, expected);
+          failures++;
+          break;
+        }
+      }
+    }
+  }
+  
+  std::cout << argc - 1 << " pages at " << levels.size() << " levels, " 
+    << failures << " failed\n";
+  return failures == 0 ? 0 : 1;
+}
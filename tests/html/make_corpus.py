@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+#
+# WebCrawler: make_corpus.py
+# Copyright (C) 2014 Kyle Givler
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+#
+# Writes the link extraction corpus to corpus/: hand written cases for
+# the tokenizer states link_extractor follows, pages stitched together
+# from common fragments, and one large page for the benchmark. The pages
+# are the same on every run.
+# Usage: make_corpus.py [seed]
+
+import os
+import random
+import sys
+
+random.seed(int(sys.argv[1]) if len(sys.argv) > 1 else 1)
+hand = [
+ '<a href="/a">x</a><A HREF=/b>y</A><a href=\'/c\' >',
+ '<!-- <a href="/no"> --><a href="/yes">',
+ '<!--> <a href="/after-abrupt">',
+ '<!---> <a href="/after-abrupt2">',
+ '<script>var s = "<a href=\\"/no\\">";</script><a href="/yes">',
+ '<style>a[href="/x"]{}</style><a href=/y>',
+ '<textarea><a href="/no"></textarea><a href="/yes">',
+ '<title><a href=/no></title ><a href=/yes>',
+ '<script>x</scriptx><a href=/no></script><a href=/yes>',
+ '<a href="/q?a=1&amp;b=2">', '<a href="/q?a=1&b=2&lt;">', '<a href="/e&#47;x&#x2F;y">',
+ '<a href="/q?x=1&amp=2">', '<a href="/q?x=1&ampx">', '<a href="/&nbsp;x">', '<a href="/&apos">',
+ '<a href="/a" href="/b">', '<a title=">" href="/gt">', '<a title=\'">\' href=/gt2>',
+ '<a href = "/spaced" >', '<a href>', '<a href="">', '<a/href=/slash>', '<a =href=/eq href=/ok>',
+ '<base href="/dir/"><a href="x">', '<base target=_blank><base href="http://o/"><base href="/no/">',
+ '<link rel="stylesheet canonical" href="/c1"><link rel=canonical href="/c2">',
+ '<link rel="Canonical" href="/C">', '<meta name="robots" content="noindex, nofollow">',
+ '<meta name=ROBOTS content=NONE>', '<meta name="googlebot" content="nofollow">',
+ '<!DOCTYPE html><html><body><a href="/d">', '<?xml version="1.0"?><a href="/x">',
+ '<![CDATA[ <a href="/cd"> ]]><a href=/after>', '</a href="/endtag"><a href=/real>',
+ '< a href="/notatag"><a href="/tag">', '<a\nhref\n=\n"/nl"\n>', '<plaintext><a href=/no>',
+ '<table><a href="/foster">x</a><tr><td><a href="/cell">', '<a href="/1"><a href="/2">',
+ '<p>text < 5 and <a href="/lt">', '<iframe><a href=/no></iframe><a href=/yes>',
+ '<noscript><a href="/ns"></noscript>', '<xmp><a href=/no></xmp><a href=/yes>',
+ '<a href="/&#0;&#xD800;&#150;&#x110000;">', '<a href="/&#;&#x;&#a">', '<a href="&quot;q&quot">',
+ '<a href="/unterminated', '<a href=/x', '<!-- unterminated <a href=/no>',
+ '<div <a href="/attr-name">', '<a href="/é">', '<A HrEf="/MiXeD">',
+]
+frag = ['<a href="/p%d">', '<A HREF=/p%d >', "<a title='t' href='/p%d'>", '<!-- c <a href="/c%d"> -->', '<script>if(a<b){document.write("<a href=\'/s%d\'>")}</script>',
+        '<style>/* <a href="/st%d"> */</style>', 'text %d &amp; <b>bold</b> ', '<div class="x%d">', '</div>', '<p>', '<img src="/i%d.png">', '<br/>', '<a href="/q%d?x=1&amp;y=2">',
+        '<a href="http://other%d.com/">', '<a href="#f%d">', '<a href="javascript:void(%d)">', '<table><tr><td>%d</td></tr></table>', '<title>t%d</title>', '<textarea>%d <a href=/ta></textarea>',
+        '<![CDATA[%d]]>', '<!DOCTYPE html>', '<ul><li>%d<li>%d</ul>', '<select><option>%d</select>', '<a href="/e%d&lt;&gt;">', '<span title="a>b%d">', '</span>', '< notatag %d', '<a href=%d>', '<form><input name=%d></form>']
+cases = [(h, 'h%d' % i) for i, h in enumerate(hand)]
+for n in range(300):
+    doc = ''.join(random.choice(frag).replace('%d', str(random.randrange(1000))) for _ in range(random.randrange(1, 200)))
+    cases.append((doc, 'g%d' % n))
+# A few large pages: mixed markup, a page that is mostly inline script
+# and one that is mostly text
+big = ''.join(random.choice(frag).replace('%d', str(i)) for i in range(200000))
+cases.append((big, 'big'))
+js = ['if(a<b){c=d<e?f:g}', 'for(var i=0;i<n;i++){x[i]=i<<2}', 'var q="abc".length<3;',
+      's="<span>"+t+"</span>";', 'h+="<div class=x"+v+"</div>";', 'while(k<m&&j<l)k++;',
+      'y=Math.max(u,w)*2+z;']
+script = ['<html><head>']
+for i in range(400):
+    script.append('<script>' + ''.join(random.choice(js) for _ in range(150)) + '</script>')
+    script.append('<a href="/js%d">' % i)
+script.append('</head></html>')
+cases.append((''.join(script), 'script'))
+words = ['lorem', 'ipsum', 'dolor', 'sit', 'amet', 'consectetur', 'adipiscing', 'elit']
+text = ['<!DOCTYPE html><html><head><title>t</title></head><body>']
+for i in range(20000):
+    text.append('<p>' + ' '.join(random.choice(words) for _ in range(50)) + '</p>')
+    if i % 20 == 0:
+        text.append('<a href="/t%d">more</a>' % i)
+text.append('</body></html>')
+cases.append((''.join(text), 'text'))
+
+os.makedirs('corpus', exist_ok=True)
+for doc, name in cases:
+    with open('corpus/%s.html' % name, 'w', encoding='utf-8') as f:
+        f.write(doc)
@@ -0,0 +1,214 @@
+/*
+ * WebCrawler: request_bench.cpp
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file request_bench.cpp
+ * @author Kyle Givler
+ *
+ * Heap allocations per fetched page made by http_request objects: built
+ * with new and deleted when done, as the crawler did, and taken from a
+ * request_pool. Each page goes through what http_client does to a
+ * request, with a window of requests alive at once as with several
+ * clients and a parse queue
+ * Usage: request_bench [body KiB] [pages] [alive]
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <string>
+#include "request_pool.hpp"
+#include "request_reciver.hpp"
+
+static std::atomic<std::size_t> allocations(0);
+
+void* operator new(std::size_t size)
+{
+  allocations++;
+  void *p = std::malloc(size ? size : 1);
+  if(!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void *p) noexcept
+{
+  std::free(p);
+}
+
+void* operator new[](std::size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete[](void *p) noexcept
+{
+  operator delete(p);
+}
+
+class null_reciver : public request_reciver
+{
+public:
+  void receive_http_request(http_request*) {}
+};
+
+struct result
+{
+  std::size_t allocations = 0;
+  double seconds = 0;
+};
+
+typedef std::chrono::steady_clock bench_clock;
+
+static const std::string response_head =
+  "HTTP/1.1 200 OK\r\n"
+  "Date: Sat, 18 Oct 2014 07:14:00 GMT\r\n"
+  "Server: Apache/2.4.10 (Debian)\r\n"
+  "Last-Modified: Fri, 17 Oct 2014 21:03:12 GMT\r\n"
+  "ETag: \"5e1f-5059a8c7d2f40\"\r\n"
+  "Accept-Ranges: bytes\r\n"
+  "Vary: Accept-Encoding\r\n"
+  "Content-Length: 24095\r\n"
+  "Keep-Alive: timeout=5, max=100\r\n"
+  "Connection: Keep-Alive\r\n"
+  "Content-Type: text/html; charset=UTF-8\r\n"
+  "\r\n";
+
+/**
+ * Build the request, read the headers and the body into r, as
+ * http_client does
+ */
+static void fetch(http_request *r, const std::string &body)
+{
+  r->get_request_buf().consume(r->get_request_buf().size());
+  std::ostream request_stream(&r->get_request_buf());
+  request_stream << "GET " << r->get_path() << " HTTP/1.1\r\n";
+  request_stream << "User-Agent: JoyfulReaper\r\n";
+  request_stream << "Host: " << r->get_server() << "\r\n";
+  request_stream << "Accept: */*\r\n";
+  request_stream << "Accept-Charset: utf-8\r\n";
+  request_stream << "Accept-Encoding: gzip, deflate\r\n";
+  request_stream << "Connection: keep-alive\r\n\r\n";
+  r->get_request_buf().consume(r->get_request_buf().size());
+  
+  r->reset_headers();
+  boost::asio::streambuf &response_buf = r->get_response_buf();
+  auto space = response_buf.prepare(response_head.size());
+  response_head.copy(boost::asio::buffer_cast<char*>(space),
+    response_head.size());
+  response_buf.commit(response_head.size());
+  
+  std::istream response_stream(&response_buf);
+  std::string header;
+  while(std::getline(response_stream, header) && header != "\r")
+  {
+    header += '\n';
+    r->add_header(header);
+  }
+  r->set_status_code(200);
+  r->get_header("content-type");
+  
+  for(std::size_t pos = 0; pos < body.size(); )
+  {
+    boost::asio::mutable_buffers_1 space = r->get_data().prepare();
+    std::size_t n = std::min(body.size() - pos,
+      boost::asio::buffer_size(space));
+    char *to = boost::asio::buffer_cast<char*>(space);
+    body.copy(to, n, pos);
+    r->append_body(to, n);
+    pos += n;
+  }
+  r->set_wire_bytes(body.size());
+  r->set_completed(true);
+}
+
+template <typename Acquire, typename Release>
+static result run(const std::vector<compact_url> &links,
+  const std::string &body, std::size_t pages, std::size_t alive,
+  Acquire acquire, Release release)
+{
+  result r;
+  std::deque<http_request*> window;
+  std::size_t start_allocs = allocations;
+  auto start = bench_clock::now();
+  
+  for(std::size_t p = 0; p < pages; p++)
+  {
+    http_request *request = acquire(links[p % links.size()]);
+    fetch(request, body);
+    window.push_back(request);
+    if(window.size() > alive)
+    {
+      release(window.front());
+      window.pop_front();
+    }
+  }
+  for(http_request *request : window)
+    release(request);
+  
+  r.seconds = std::chrono::duration<double>(bench_clock::now() - start)
+    .count();
+  r.allocations = allocations - start_allocs;
+  return r;
+}
+
+static void print(const char *name, const result &r, std::size_t pages)
+{
+  std::cout << "  " << std::setw(6) << std::left << name << std::right
+    << std::setw(8) << double(r.allocations) / pages << " allocations/page, "
+    << std::setw(10) << pages / r.seconds << " pages/s\n";
+}
+
+int main(int argc, char **argv)
+{
+  std::size_t body_kib = argc > 1 ? std::stoul(argv[1]) : 24;
+  std::size_t pages = argc > 2 ? std::stoul(argv[2]) : 100000;
+  std::size_t alive = argc > 3 ? std::stoul(argv[3]) : 72;
+  
+  null_reciver reciver;
+  std::vector<compact_url> links;
+  for(int i = 0; i < 1000; i++)
+    links.push_back(compact_url(i % 3 ? "http" : "https",
+      "host" + std::to_string(i % 50) + ".example",
+      "/articles/2014/10/page-" + std::to_string(i) + ".html"));
+  std::string body(body_kib * 1024, 'x');
+  
+  request_pool pool;
+  auto pool_acquire = [&](const compact_url &link) {
+    return pool.acquire(reciver, link); };
+  auto pool_release = [&](http_request *r) { pool.release(r); };
+  auto new_acquire = [&](const compact_url &link) {
+    return new http_request(reciver, link); };
+  auto new_release = [](http_request *r) { delete r; };
+  
+  // Warm the body blocks, a running crawler holds them
+  run(links, body, alive * 2, alive, new_acquire, new_release);
+  
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << pages << " pages, " << body_kib << " KiB bodies, " << alive
+    << " requests alive\n";
+  print("new", run(links, body, pages, alive, new_acquire, new_release),
+    pages);
+  print("pool", run(links, body, pages, alive, pool_acquire, pool_release),
+    pages);
+  return 0;
+}
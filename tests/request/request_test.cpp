@@ -0,0 +1,224 @@
+/*
+ * WebCrawler: request_test.cpp
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file request_test.cpp
+ * @author Kyle Givler
+ *
+ * Runs requests through a request_pool the way the crawler does. A reused
+ * request must look just like a new one for its link, with nothing left
+ * from the page it fetched before
+ */
+
+#include <iostream>
+#include <string>
+#include "request_pool.hpp"
+#include "request_reciver.hpp"
+#include "../check.hpp"
+
+class null_reciver : public request_reciver
+{
+public:
+  void receive_http_request(http_request*) {}
+};
+
+/**
+ * Touch everything http_client and the crawler set on a request
+ */
+static void fetch(http_request *r, const std::string &body)
+{
+  std::ostream request_stream(&r->get_request_buf());
+  request_stream << "GET " << r->get_path() << " HTTP/1.1\r\n\r\n";
+  
+  std::ostream response_stream(&r->get_response_buf());
+  response_stream << "left over";
+  
+  r->set_request_type(RequestType::HEAD);
+  r->set_request("GET / HTTP/1.0\r\n\r\n");
+  r->set_http_version("HTTP/1.1");
+  r->set_status_code(301);
+  r->add_header("Content-Type: text/html\r\n");
+  r->add_error("Error: something");
+  r->should_blacklist(true, "test");
+  r->set_timed_out(true);
+  r->set_redirected(true);
+  r->set_completed(true);
+  r->set_wire_bytes(body.size());
+  r->set_server("elsewhere.example");
+  r->set_path("/moved");
+  r->set_protocol("https");
+  r->append_body(body.data(), body.size());
+}
+
+/**
+ * Compare every getter of a against b, a fresh request for the same link
+ */
+static void same(const std::string &name, http_request &a, http_request &b)
+{
+  CHECK(name, a.get_server() == b.get_server());
+  CHECK(name, a.get_path() == b.get_path());
+  CHECK(name, a.get_protocol() == b.get_protocol());
+  CHECK(name, a.get_port() == b.get_port());
+  CHECK(name, a.get_http_version() == b.get_http_version());
+  CHECK(name, a.get_status_code() == b.get_status_code());
+  CHECK(name, a.get_data().size() == b.get_data().size());
+  CHECK(name, a.get_data().blocks() == 0);
+  CHECK(name, a.get_wire_bytes() == b.get_wire_bytes());
+  CHECK(name, a.get_headers() == b.get_headers());
+  CHECK(name, a.get_request() == b.get_request());
+  CHECK(name, a.error() == b.error());
+  CHECK(name, a.get_response_buf().size() == 0);
+  CHECK(name, a.get_request_buf().size() == 0);
+  CHECK(name, a.get_request_type() == b.get_request_type());
+  CHECK(name, a.is_completed() == b.is_completed());
+  CHECK(name, a.should_blacklist() == b.should_blacklist());
+  CHECK(name, a.get_blacklist_reason() == b.get_blacklist_reason());
+  CHECK(name, a.get_timed_out() == b.get_timed_out());
+  CHECK(name, a.get_redirected() == b.get_redirected());
+  CHECK(name, a.get_orignial_settings().to_string() ==
+    b.get_orignial_settings().to_string());
+}
+
+static void test_reuse()
+{
+  null_reciver reciver;
+  request_pool pool;
+  buffer_pool &blocks = buffer_pool::get();
+  std::size_t blocks_in_use = blocks.get_in_use();
+  
+  compact_url first("http", "one.example", "/a");
+  compact_url second("https", "two.example:8443", "/b/c");
+  compact_url third("http", "three.example", "/");
+  
+  http_request *a = pool.acquire(reciver, first);
+  http_request *b = pool.acquire(reciver, second);
+  CHECK("reuse", a != b);
+  CHECK("reuse", pool.get_created() == 2);
+  CHECK("reuse", pool.get_in_use() == 2);
+  CHECK("reuse", pool.get_reused() == 0);
+  
+  fetch(a, std::string(40000, 'x') + "<a href=\"/old\">old</a>");
+  CHECK("reuse", blocks.get_in_use() > blocks_in_use);
+  pool.release(a);
+  CHECK("reuse", pool.get_free() == 1);
+  CHECK("reuse", pool.get_in_use() == 1);
+  CHECK("reuse blocks", blocks.get_in_use() == blocks_in_use);
+  
+  // The same object comes back, as new
+  http_request *c = pool.acquire(reciver, second);
+  CHECK("reuse", c == a);
+  CHECK("reuse", pool.get_reused() == 1);
+  CHECK("reuse", pool.get_created() == 2);
+  http_request fresh_second(reciver, second);
+  same("reuse https", *c, fresh_second);
+  CHECK("reuse https", c->get_port() == 443);
+  
+  // Only the new body's links are found
+  std::string page = "<a href=\"/new\">new</a>";
+  c->append_body(page.data(), page.size());
+  std::vector<std::string> links = c->get_links();
+  CHECK("reuse links", links.size() == 1);
+  CHECK("reuse links", !links.empty() &&
+    links[0] == "https://two.example:8443/new");
+  
+  pool.release(b);
+  pool.release(c);
+  CHECK("reuse", pool.get_free() == 2);
+  CHECK("reuse", pool.get_in_use() == 0);
+  
+  http_request *d = pool.acquire(reciver, third);
+  http_request fresh_third(reciver, third);
+  same("reuse http", *d, fresh_third);
+  CHECK("reuse http", d->get_port() == 80);
+  pool.release(d);
+  CHECK("reuse blocks", blocks.get_in_use() == blocks_in_use);
+}
+
+/**
+ * A request reused many times still fetches and parses right
+ */
+static void test_cycles()
+{
+  null_reciver reciver;
+  request_pool pool;
+  std::vector<http_request*> alive;
+  
+  for(int i = 0; i < 1000; i++)
+  {
+    std::string n = std::to_string(i);
+    compact_url link("http", "host" + std::to_string(i % 7) + ".example",
+      "/page" + n);
+    http_request *r = pool.acquire(reciver, link);
+    std::string page = std::string(i * 37 % 50000, ' ') +
+      "<a href=\"next" + n + "\">next</a>";
+    r->append_body(page.data(), page.size());
+    
+    std::vector<std::string> links = r->get_links();
+    CHECK("cycles", links.size() == 1 && links[0] == "http://host" +
+      std::to_string(i % 7) + ".example/next" + n);
+    
+    alive.push_back(r);
+    if(alive.size() > 5)
+    {
+      pool.release(alive.front());
+      alive.erase(alive.begin());
+    }
+  }
+  CHECK("cycles", pool.get_created() == 6);
+  CHECK("cycles", pool.get_reused() == 994);
+  
+  for(http_request *r : alive)
+    pool.release(r);
+  CHECK("cycles", pool.get_free() == 6);
+}
+
+static void test_headers()
+{
+  null_reciver reciver;
+  http_request r(reciver, compact_url("http", "one.example", "/"));
+  
+  for(int i = 0; i < 3; i++)
+  {
+    r.reset_headers();
+    r.add_header("HTTP/1.1 200 OK\r\n");
+    r.add_header("Content-Type:  text/html; charset=UTF-8 \r\n");
+    r.add_header("X-Empty:\r\n");
+    if(i == 2)
+      r.add_header("Content-Length: 10\r\n");
+    
+    CHECK("headers", r.get_headers().size() == (i == 2 ? 4u : 3u));
+    CHECK("headers", r.get_headers()[0] == "HTTP/1.1 200 OK\r\n");
+    CHECK("headers", r.get_header("content-type") == 
+      "text/html; charset=UTF-8");
+    CHECK("headers", r.get_header("CONTENT-TYPE") == 
+      "text/html; charset=UTF-8");
+    CHECK("headers", r.get_header("X-Empty") == "");
+    CHECK("headers", r.get_header("Content") == "");
+    CHECK("headers", r.get_header("Content-Length") == (i == 2 ? "10" : ""));
+  }
+}
+
+int main()
+{
+  test_headers();
+  test_reuse();
+  test_cycles();
+  
+  std::cout << (failures ? "FAILED\n" : "OK\n");
+  return failures == 0 ? 0 : 1;
+}
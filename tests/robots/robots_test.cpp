@@ -0,0 +1,181 @@
+/*
+ * WebCrawler: robots_test.cpp
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file robots_test.cpp
+ * @author Kyle Givler
+ * 
+ * Checks robot_rules against a reference that turns each rule into an
+ * anchored regex and picks the longest matching rule, an Allow winning a
+ * tie (RFC 9309). Random rule sets and paths are drawn from a small 
+ * alphabet so prefixes, '*' and '$' collide often, then a few fixed cases
+ * cover groups, case and Crawl-delay
+ * Usage: robots_test [rule sets] [seed]
+ */
+
+#include <boost/regex.hpp>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "robot_rules.hpp"
+#include "../check.hpp"
+
+static const std::string agent = "JoyfulReaper";
+
+class reference
+{
+public:
+  void add(bool allow, const std::string &pattern)
+  {
+    if(pattern.empty())
+      return;
+    
+    std::string re = "^";
+    for(std::size_t i = 0; i < pattern.size(); i++)
+    {
+      char c = pattern[i];
+      if(c == '*')
+        re += ".*";
+      else if(c == '$' && i + 1 == pattern.size())
+        re += "$";
+      else
+      {
+        if(std::strchr(".^$|()[]{}+?\\", c))
+          re += '\\';
+        re += c;
+      }
+    }
+    rules.push_back(rule{ allow, pattern.size(), boost::regex(re) });
+  }
+  
+  bool allowed(const std::string &path) const
+  {
+    if(path == "/robots.txt")
+      return true;
+    
+    std::size_t best = 0;
+    bool allow = true;
+    for(auto &r : rules)
+    {
+      if(!boost::regex_search(path, r.expression, boost::match_continuous))
+        continue;
+      if(r.length > best || (r.length == best && r.allow && !allow))
+      {
+        best = r.length;
+        allow = r.allow;
+      }
+    }
+    return allow;
+  }
+  
+private:
+  struct rule
+  {
+    bool allow;
+    std::size_t length;
+    boost::regex expression;
+  };
+  
+  std::vector<rule> rules;
+};
+
+static void fuzz(std::size_t sets, unsigned int seed)
+{
+  std::mt19937 gen(seed);
+  const char alphabet[] = "/ab.*$?";
+  
+  // Patterns use the whole alphabet, paths no '*' or '$'
+  auto random_path = [&](std::size_t max, bool pattern) {
+    std::string s = "/";
+    std::size_t length = gen() % max;
+    for(std::size_t i = 0; i < length; i++)
+    {
+      char c = alphabet[gen() % (pattern ? 7 : 5)];
+      s += (!pattern && c == '*') ? 'c' : c;
+    }
+    return s;
+  };
+  
+  std::size_t checks = 0;
+  for(std::size_t set = 0; set < sets && failures < 10; set++)
+  {
+    std::string robots = "User-agent: *\n";
+    reference ref;
+    
+    std::size_t count = 1 + gen() % 8;
+    for(std::size_t i = 0; i < count; i++)
+    {
+      bool allow = gen() % 2;
+      std::string pattern = random_path(8, true);
+      robots += (allow ? "Allow: " : "Disallow: ") + pattern + "\n";
+      ref.add(allow, pattern);
+    }
+    
+    robot_rules rules(robots, agent);
+    for(int i = 0; i < 30; i++)
+    {
+      std::string path = random_path(12, false);
+      if(gen() % 3 == 0)
+        path += "$";
+      checks++;
+      
+      bool got = rules.allowed(path);
+      CHECK("fuzz " + path + " allowed=" + std::to_string(got) + 
+        " with\n" + robots, got == ref.allowed(path));
+    }
+  }
+  
+  std::cout << "fuzz: " << checks << " paths checked\n";
+}
+
+static void cases()
+{
+  robot_rules groups("User-agent: Other\nDisallow: /\n\n"
+    "User-agent: JoyfulReaper/2.0\nUser-agent: x\nDisallow: /priv\n"
+    "Crawl-delay: 3\n\nUser-agent: *\nDisallow: /\n", agent);
+  CHECK("groups", groups.allowed("/pub"));
+  CHECK("groups", !groups.allowed("/private"));
+  CHECK("groups", groups.get_crawl_delay() == 3);
+  
+  robot_rules anchored("User-agent: *\nDisallow: /\nAllow: /ok$\n", agent);
+  CHECK("anchored", !anchored.allowed("/x"));
+  CHECK("anchored", anchored.allowed("/ok"));
+  CHECK("anchored", !anchored.allowed("/oke"));
+  CHECK("anchored", anchored.allowed("/robots.txt"));
+  
+  robot_rules empty("user-agent: *\ndisallow:\n", agent);
+  CHECK("empty", empty.allowed("/a"));
+  
+  robot_rules upper("User-agent: *\nDisallow: /A\n", agent);
+  CHECK("upper", !upper.allowed("/A"));
+  CHECK("upper", upper.allowed("/a"));
+}
+
+int main(int argc, char **argv)
+{
+  std::size_t sets = argc > 1 ? std::stoul(argv[1]) : 20000;
+  unsigned int seed = argc > 2 ? std::stoul(argv[2]) : 42;
+  
+  fuzz(sets, seed);
+  cases();
+  
+  std::cout << (failures ? "FAILED\n" : "OK\n");
+  return failures == 0 ? 0 : 1;
+}
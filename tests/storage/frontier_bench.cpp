@@ -0,0 +1,243 @@
+/*
+ * WebCrawler: frontier_bench.cpp
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file frontier_bench.cpp
+ * @author Kyle Givler
+ * 
+ * Frontier loads per second from a database whose hosts each have a 
+ * large blacklist: get_links() compiling each host's blacklist once per
+ * load and marking the hits in one statement, against the old per-row 
+ * path that queried the blacklist and built a boost::regex per pattern
+ * for every link. The old path also slept 2 seconds per hit, which is 
+ * left out here and only added to its estimate. It is timed for a few 
+ * seconds, not run to the end
+ * Usage: frontier_bench [hosts] [blacklist per host] [links per host]
+ */
+
+#include <boost/algorithm/string.hpp>
+#include <boost/regex.hpp>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sqlite3.h>
+#include "sqlite.hpp"
+
+typedef std::chrono::steady_clock clock_type;
+
+static double since(clock_type::time_point start)
+{
+  return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+// robot_parser::path_is_allowed() as it was
+static bool regex_path_is_allowed(std::string i_pattern, std::string path)
+{
+  using boost::algorithm::replace_all_copy;
+  
+  std::string pattern = replace_all_copy(i_pattern, "*", ".*");
+  pattern = replace_all_copy(pattern, "?", "\\?");
+  pattern = replace_all_copy(pattern, ".", "\\.");
+  
+  boost::regex exp(pattern);
+  boost::cmatch what;
+  return !boost::regex_match(path.c_str(), what, exp);
+}
+
+static std::string host(std::size_t h)
+{
+  return "www.host" + std::to_string(h) + ".example.com";
+}
+
+/**
+ * Each host's blacklist holds the paths of every other one of its first 
+ * links, the way robots_allow() fills it
+ */
+static void seed(const char *file, std::size_t hosts, std::size_t blacklisted,
+  std::size_t links)
+{
+  sqlite db(file);
+  v_links blacklist;
+  std::vector<std::string> batch;
+  
+  for(std::size_t h = 0; h < hosts; h++)
+  {
+    for(std::size_t l = 0; l < links; l++)
+    {
+      std::string path = "/dir" + std::to_string(l % 50) + "/page" + 
+        std::to_string(l) + ".php";
+      batch.push_back("http://" + host(h) + path);
+      if(l % 2 == 0 && l / 2 < blacklisted)
+        blacklist.push_back(compact_url("http", host(h), path));
+    }
+    db.add_links(batch);
+    batch.clear();
+  }
+  db.blacklist(blacklist, "bench");
+  db.close_db();
+}
+
+/**
+ * sqlite::get_links() and check_blacklist() as they were, on their own
+ * connection
+ */
+class per_row_frontier
+{
+public:
+  per_row_frontier(const char *file) { sqlite3_open(file, &db); }
+  
+  ~per_row_frontier() { sqlite3_close(db); }
+  
+  std::size_t get_links(std::size_t num, std::size_t &hits)
+  {
+    std::vector<std::string> rows;
+    sqlite3_stmt *statement;
+    std::string sql = "SELECT domain,path,protocol FROM Links WHERE " \
+      "visited = '0' LIMIT " + std::to_string(num) + ";";
+    sqlite3_prepare_v2(db, sql.c_str(), -1, &statement, 0);
+    while(sqlite3_step(statement) == SQLITE_ROW)
+      for(int c = 0; c < 3; c++)
+        rows.push_back(reinterpret_cast<const char*>(
+          sqlite3_column_text(statement, c)));
+    sqlite3_finalize(statement);
+    
+    std::size_t links = 0;
+    for(std::size_t i = 0; i < rows.size(); i += 3)
+    {
+      if(check_blacklist(rows[i], rows[i + 1], rows[i + 2]))
+      {
+        hits++;
+        remove_link(rows[i], rows[i + 1], rows[i + 2]);
+        continue;
+      }
+      mark(rows[i], rows[i + 1], rows[i + 2]);
+      links++;
+    }
+    return links;
+  }
+  
+private:
+  sqlite3 *db;
+  
+  bool check_blacklist(const std::string &domain, const std::string &path, 
+    const std::string &proto)
+  {
+    bool blacklisted = false;
+    sqlite3_stmt *statement;
+    std::string sql = "SELECT domain,path,protocol FROM Blacklist WHERE " \
+      "domain = '" + domain + "' AND protocol = '" + proto + "';";
+    sqlite3_prepare_v2(db, sql.c_str(), -1, &statement, 0);
+    while(sqlite3_step(statement) == SQLITE_ROW)
+    {
+      std::string bl_path = reinterpret_cast<const char*>(
+        sqlite3_column_text(statement, 1));
+      if(!regex_path_is_allowed(bl_path, path))
+        blacklisted = true;
+    }
+    sqlite3_finalize(statement);
+    return blacklisted;
+  }
+  
+  void remove_link(const std::string &domain, const std::string &path, 
+    const std::string &proto)
+  {
+    std::string sql = "DELETE FROM Links WHERE domain = '" + domain + 
+      "' AND path = '" + path + "' AND protocol = '" + proto + "';";
+    sqlite3_exec(db, sql.c_str(), 0, 0, 0);
+  }
+  
+  // The crawler marked links visited once fetched, the next load relied
+  // on it to move on
+  void mark(const std::string &domain, const std::string &path, 
+    const std::string &proto)
+  {
+    std::string sql = "UPDATE Links SET visited = 1 WHERE domain = '" + 
+      domain + "' AND path = '" + path + "' AND protocol = '" + proto + "';";
+    sqlite3_exec(db, sql.c_str(), 0, 0, 0);
+  }
+};
+
+static void remove_files(const std::string &base)
+{
+  const char *suffixes[] = { "", "-wal", "-shm", ".seen" };
+  for(const char *s : suffixes)
+    std::remove((base + s).c_str());
+}
+
+int main(int argc, char **argv)
+{
+  std::size_t hosts = argc > 1 ? std::stoul(argv[1]) : 100;
+  std::size_t blacklisted = argc > 2 ? std::stoul(argv[2]) : 300;
+  std::size_t links = argc > 3 ? std::stoul(argv[3]) : 1000;
+  const std::size_t load = 100;
+  
+  remove_files("frontier_bench_old.db");
+  remove_files("frontier_bench_new.db");
+  seed("frontier_bench_old.db", hosts, blacklisted, links);
+  seed("frontier_bench_new.db", hosts, blacklisted, links);
+  std::cout << hosts << " hosts, " << blacklisted << " blacklisted paths and "
+    << links << " links each, loads of " << load << "\n";
+  
+  {
+    sqlite db("frontier_bench_new.db");
+    std::int64_t cursor = 0;
+    std::size_t loads = 0;
+    std::size_t loaded = 0;
+    clock_type::time_point start = clock_type::now();
+    v_links batch;
+    while(!(batch = db.get_links(load, cursor)).empty())
+    {
+      loads++;
+      loaded += batch.size();
+    }
+    double secs = since(start);
+    db.close_db();
+    
+    std::cout << "  compiled: " << static_cast<std::size_t>(loads / secs) 
+      << " loads/s, " << static_cast<std::size_t>(loaded / secs) 
+      << " links/s, " << hosts * links - loaded << " blacklisted\n";
+  }
+  
+  {
+    per_row_frontier db("frontier_bench_old.db");
+    std::size_t loads = 0;
+    std::size_t loaded = 0;
+    std::size_t hits = 0;
+    clock_type::time_point start = clock_type::now();
+    while(since(start) < 5)
+    {
+      std::size_t got = db.get_links(load, hits);
+      if(got == 0 && hits == 0)
+        break;
+      loads++;
+      loaded += got;
+    }
+    double secs = since(start);
+    
+    std::cout << "  per row:  " << loads / secs << " loads/s, " 
+      << static_cast<std::size_t>(loaded / secs) << " links/s, " 
+      << hits << " blacklisted in " << secs << " s, " 
+      << loads / (secs + 2.0 * hits) << " loads/s with the sleep\n";
+  }
+  
+  remove_files("frontier_bench_old.db");
+  remove_files("frontier_bench_new.db");
+  return 0;
+}
@@ -0,0 +1,224 @@
+/*
+ * WebCrawler: sqlite_bench.cpp
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file sqlite_bench.cpp
+ * @author Kyle Givler
+ * 
+ * Link inserts and visited updates per second through the sqlite 
+ * backend's prepared statements, against the SQL it used to build by
+ * concatenation and parse on every call. Both run on the same schema, 
+ * pragmas and transactions of 100, so only the statements differ
+ * Usage: sqlite_bench [links]
+ */
+
+#include <boost/algorithm/string.hpp>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sqlite3.h>
+#include "sqlite.hpp"
+
+typedef std::chrono::steady_clock clock_type;
+
+static double since(clock_type::time_point start)
+{
+  return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+static std::string host(std::size_t i)
+{
+  return "www.host" + std::to_string(i % 5000) + ".example.com";
+}
+
+static std::string path(std::size_t i)
+{
+  return "/articles/" + std::to_string(i) + ".html";
+}
+
+/**
+ * sqlite::add_links() and set_visited() as they were before statements 
+ * were prepared once, logging left out
+ */
+class concatenated_sqlite
+{
+public:
+  /**
+   * @param file A database the sqlite backend created
+   */
+  concatenated_sqlite(const char *file)
+  {
+    sqlite3_open(file, &db);
+    const char *setup = 
+      "PRAGMA synchronous = NORMAL; PRAGMA cache_size = -32768;"
+      "PRAGMA mmap_size = 268435456; PRAGMA temp_store = MEMORY;";
+    sqlite3_exec(db, setup, 0, 0, 0);
+  }
+  
+  ~concatenated_sqlite() { sqlite3_close(db); }
+  
+  void begin() { sqlite3_exec(db, "BEGIN", 0, 0, 0); }
+  
+  void commit() { sqlite3_exec(db, "COMMIT", 0, 0, 0); }
+  
+  void add_links(std::vector<std::string> links)
+  {
+    std::string protocol, domain, path, sql;
+    std::size_t found;
+    
+    begin();
+    for(auto &link : links)
+    {
+      if( (found = link.find("://")) != std::string::npos)
+      {
+        protocol = link.substr(0, found);
+        link = link.substr(found + 3, link.length());
+      } else {
+        protocol = "http";
+      }
+      
+      if(protocol != "http" && protocol != "https")
+        continue;
+      
+      if( (found = link.find("/")) != std::string::npos)
+      {
+        domain = link.substr(0, found);
+        path = link.substr(found, link.length());
+      } else {
+        domain = link;
+        path = "/";
+      }
+      
+      path = boost::algorithm::replace_all_copy(path, "'", "''");
+      boost::to_lower(domain);
+      boost::to_lower(protocol);
+      
+      sql = "INSERT INTO Links (domain,path,protocol) " \
+        "VALUES ('" + domain + "', '" + path + "', '" + protocol + "');";
+      sqlite3_exec(db, sql.c_str(), 0, 0, 0);
+    }
+    commit();
+  }
+  
+  void set_visited(std::string domain, std::string path, 
+    std::string protocol, unsigned int code)
+  {
+    path = boost::algorithm::replace_all_copy(path, "'", "''");
+    std::string sql = "UPDATE Links SET visited = '1', lastCode = '" + \
+      std::to_string(code) + "' WHERE domain = '" + domain + 
+      "' AND PATH = '" + path + "' AND protocol = '" + protocol + "';";
+    step(sql);
+    
+    sql = "UPDATE Links SET lastVisited = '" + std::to_string(time(0)) + 
+      "' WHERE domain = '" + domain + "' AND path = '" + path + 
+      "' AND protocol = '" + protocol + "';";
+    step(sql);
+  }
+  
+private:
+  sqlite3 *db;
+  
+  void step(const std::string &sql)
+  {
+    sqlite3_stmt *statement;
+    sqlite3_prepare_v2(db, sql.c_str(), -1, &statement, 0);
+    sqlite3_step(statement);
+    sqlite3_finalize(statement);
+  }
+};
+
+struct rates
+{
+  double inserts;
+  double updates;
+};
+
+template<typename Store>
+static rates run(Store &store, std::size_t n)
+{
+  rates r;
+  clock_type::time_point start = clock_type::now();
+  std::vector<std::string> batch;
+  for(std::size_t i = 0; i < n; i++)
+  {
+    batch.push_back("http://" + host(i) + path(i));
+    if(batch.size() == 100)
+    {
+      store.add_links(batch);
+      batch.clear();
+    }
+  }
+  store.add_links(batch);
+  r.inserts = n / since(start);
+  
+  start = clock_type::now();
+  for(std::size_t i = 0; i < n; i += 100)
+  {
+    store.begin();
+    for(std::size_t j = i; j < i + 100 && j < n; j++)
+      store.set_visited(host(j), path(j), "http", 200);
+    store.commit();
+  }
+  r.updates = n / since(start);
+  return r;
+}
+
+static void remove_files(const char *name)
+{
+  std::string base = name;
+  const char *suffixes[] = { "", "-wal", "-shm", ".seen" };
+  for(const char *s : suffixes)
+    std::remove((base + s).c_str());
+}
+
+int main(int argc, char **argv)
+{
+  std::size_t n = argc > 1 ? std::stoul(argv[1]) : 200000;
+  remove_files("sqlite_bench_old.db");
+  remove_files("sqlite_bench_new.db");
+  
+  // The seen filter would skip work the old code did
+  sqlite_options options;
+  options.seen_fp_rate = 0;
+  sqlite("sqlite_bench_old.db", options).close_db();
+  
+  rates before, after;
+  {
+    concatenated_sqlite store("sqlite_bench_old.db");
+    before = run(store, n);
+  }
+  {
+    sqlite store("sqlite_bench_new.db", options);
+    after = run(store, n);
+    store.close_db();
+  }
+  
+  std::cout << n << " links\n"
+    << "  concatenated: " << static_cast<std::size_t>(before.inserts) 
+    << " inserts/s, " << static_cast<std::size_t>(before.updates) 
+    << " visited updates/s\n"
+    << "  prepared:     " << static_cast<std::size_t>(after.inserts) 
+    << " inserts/s, " << static_cast<std::size_t>(after.updates) 
+    << " visited updates/s\n";
+  
+  remove_files("sqlite_bench_old.db");
+  remove_files("sqlite_bench_new.db");
+  return 0;
+}
@@ -0,0 +1,122 @@
+/*
+ * WebCrawler: storage_bench.cpp
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file storage_bench.cpp
+ * @author Kyle Givler
+ * 
+ * Ingest and lookup rates of the sqlite and log store backends on the 
+ * same links: add_links() in batches of 100, robots and blacklist lookups
+ * per link, reading the frontier back and marking links visited
+ * Usage: storage_bench [links]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "sqlite.hpp"
+#include "log_store.hpp"
+
+typedef std::chrono::steady_clock clock_type;
+
+static double since(clock_type::time_point start)
+{
+  return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+static std::string host(std::size_t i)
+{
+  return "www.host" + std::to_string(i % 5000) + ".example.com";
+}
+
+static std::string path(std::size_t i)
+{
+  return "/articles/" + std::to_string(i) + ".html";
+}
+
+static void run(const std::string &name, database *d, std::size_t n)
+{
+  clock_type::time_point start = clock_type::now();
+  std::vector<std::string> batch;
+  for(std::size_t i = 0; i < n; i++)
+  {
+    batch.push_back("http://" + host(i) + path(i));
+    if(batch.size() == 100)
+    {
+      d->add_links(batch);
+      batch.clear();
+    }
+  }
+  d->add_links(batch);
+  double ingest = since(start);
+  
+  start = clock_type::now();
+  std::size_t hits = 0;
+  for(std::size_t i = 0; i < n; i++)
+    hits += d->should_process_robots(host(i), "http");
+  for(std::size_t i = 0; i < n; i++)
+    hits += d->check_blacklist(host(i), path(i), "http");
+  double lookup = since(start);
+  
+  start = clock_type::now();
+  std::int64_t cursor = 0;
+  std::size_t read = 0;
+  v_links links;
+  while(!(links = d->get_links(500, cursor)).empty())
+    read += links.size();
+  double scan = since(start);
+  
+  start = clock_type::now();
+  d->begin();
+  for(std::size_t i = 0; i < n; i += 10)
+    d->set_visited(host(i), path(i), "http", 200);
+  d->commit();
+  double visit = since(start);
+  
+  d->close_db();
+  delete d;
+  
+  std::cout << name << ": ingest " << static_cast<std::size_t>(n / ingest)
+    << " links/s, lookups " << static_cast<std::size_t>(2 * n / lookup) 
+    << "/s, get_links " << static_cast<std::size_t>(read / scan) 
+    << " links/s (" << read << "), set_visited " 
+    << static_cast<std::size_t>(n / 10 / visit) << "/s\n";
+}
+
+int main(int argc, char **argv)
+{
+  std::size_t n = argc > 1 ? std::stoul(argv[1]) : 200000;
+  
+  const char *files[] = { "storage_bench.db", "storage_bench.db-wal", 
+    "storage_bench.db-shm", "storage_bench.db.seen", "storage_bench.log" };
+  for(const char *f : files)
+    std::remove(f);
+  
+  run("sqlite", new sqlite("storage_bench.db"), n);
+  run("log_store", new log_store("storage_bench.log"), n);
+  
+  clock_type::time_point start = clock_type::now();
+  delete new log_store("storage_bench.log");
+  std::cout << "log_store: reopen " << since(start) << " s\n";
+  
+  for(const char *f : files)
+    std::remove(f);
+  return 0;
+}
@@ -0,0 +1,330 @@
+/*
+ * WebCrawler: storage_test.cpp
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file storage_test.cpp
+ * @author Kyle Givler
+ * 
+ * Runs the same database calls against every backend, the results must 
+ * agree and survive closing and reopening. Then checks what only the log
+ * store has: compaction, recovery from a torn last record and transactions
+ * that are only written by their commit. Files are created in the current
+ * directory
+ */
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include "sqlite.hpp"
+#include "log_store.hpp"
+#include "../check.hpp"
+
+static std::string join(const v_links &links)
+{
+  std::string s;
+  for(auto &l : links)
+    s += l.to_string() + " ";
+  return s;
+}
+
+static std::uint64_t file_size(const std::string &file)
+{
+  struct stat st;
+  return stat(file.c_str(), &st) == 0 ? st.st_size : 0;
+}
+
+static void remove_files(const std::string &file)
+{
+  for(const char *suffix : { "", "-wal", "-shm", ".seen", ".compact" })
+    std::remove((file + suffix).c_str());
+}
+
+typedef std::function<database*()> opener;
+
+static void conformance(const std::string &name, opener open)
+{
+  database *d = open();
+  
+  // Unknown schemes are dropped, duplicates kept once, paths normalized
+  d->add_links({ "http://a.com/x", "a.com/y", "https://b.com/z?q=1", 
+    "ftp://c/", "http://a.com/x", "http://a.com/private/1", 
+    "http://a.com/../q" });
+  std::int64_t cursor = 0;
+  v_links links = d->get_links(100, cursor);
+  CHECK(name, links.size() == 5);
+  CHECK(name, join(links).find("http://a.com/q ") != std::string::npos);
+  
+  CHECK(name, !d->get_visited("a.com", "/x", "http"));
+  d->set_visited("a.com", "/x", "http", 200);
+  CHECK(name, d->get_visited("a.com", "/x", "http"));
+  
+  d->blacklist("a.com", "/private/*", "http", "test");
+  CHECK(name, d->check_blacklist("a.com", "/private/1", "http"));
+  CHECK(name, !d->check_blacklist("a.com", "/public", "http"));
+  CHECK(name, !d->check_blacklist("a.com", "/private/1", "https"));
+  
+  // Visited and blacklisted links are not handed out again
+  cursor = 0;
+  links = d->get_links(100, cursor);
+  CHECK(name, links.size() == 3);
+  
+  // The cursor only moves forward, new links come after it
+  d->add_link("http://a.com/new");
+  v_links more = d->get_links(100, cursor);
+  CHECK(name, more.size() == 1 && 
+    more[0].to_string() == "http://a.com/new");
+  
+  cursor = 0;
+  CHECK(name, d->get_links(2, cursor).size() == 2);
+  CHECK(name, d->get_links(10, cursor).size() == 2);
+  
+  CHECK(name, d->should_process_robots("a.com", "http"));
+  d->set_robot_processed("a.com", "http", false, 
+    "User-agent: *\nDisallow: /p");
+  CHECK(name, !d->should_process_robots("a.com", "http"));
+  CHECK(name, d->should_process_robots("a.com", "https"));
+  CHECK(name, d->get_robots("a.com", "http") == 
+    "User-agent: *\nDisallow: /p");
+  CHECK(name, d->get_robots("b.com", "http") == "");
+  
+  d->remove_link("a.com", "/y", "http");
+  d->set_last_visited("a.com", "/q", "http");
+  
+  v_links blacklist;
+  blacklist.push_back(compact_url("https", "b.com", "/z?q=1"));
+  d->blacklist(blacklist, "test");
+  CHECK(name, d->check_blacklist("b.com", "/z?q=1", "https"));
+  
+  // The compact_url overloads store the same rows as the string ones
+  d->add_link("http://v.com/1");
+  compact_url queued("http", "v.com", "/1");
+  CHECK(name, !d->get_visited("v.com", "/1", "http"));
+  d->set_visited(queued, 301);
+  CHECK(name, d->get_visited("v.com", "/1", "http"));
+  d->set_last_visited(queued);
+  d->blacklist(compact_url("http", "c.com", "/drop"), "test");
+  CHECK(name, d->check_blacklist(compact_url("http", "c.com", "/drop")));
+  CHECK(name, !d->check_blacklist(compact_url("http", "c.com", "/keep")));
+  
+  d->begin();
+  d->add_link("http://t.com/1");
+  d->begin();
+  d->add_link("http://t.com/2");
+  d->commit();
+  d->commit();
+  
+  d->close_db();
+  delete d;
+  
+  // Everything above must be there after a reopen
+  d = open();
+  cursor = 0;
+  links = d->get_links(100, cursor);
+  CHECK(name, links.size() == 4);
+  CHECK(name, join(links).find("http://t.com/2 ") != std::string::npos);
+  CHECK(name, join(links).find("http://a.com/y ") == std::string::npos);
+  CHECK(name, d->get_visited("a.com", "/x", "http"));
+  CHECK(name, !d->should_process_robots("a.com", "http"));
+  CHECK(name, d->get_robots("a.com", "http") == 
+    "User-agent: *\nDisallow: /p");
+  CHECK(name, d->check_blacklist("a.com", "/private/9", "http"));
+  CHECK(name, d->check_blacklist("b.com", "/z?q=1", "https"));
+  d->close_db();
+  delete d;
+  
+  std::cout << name << ": conformance done\n";
+}
+
+static void compaction()
+{
+  const std::string file = "storage_test_compact.log";
+  remove_files(file);
+  
+  log_store_options options;
+  options.compact_min_bytes = 0;
+  options.compact_ratio = 0.3;
+  
+  log_store *d = new log_store(file, options);
+  d->begin();
+  for(int i = 0; i < 1000; i++)
+    d->add_link("http://h.com/" + std::to_string(i));
+  d->commit();
+  std::uint64_t before = file_size(file);
+  
+  // Every link record is replaced, most of the file is garbage
+  d->begin();
+  for(int i = 0; i < 1000; i++)
+    d->set_visited("h.com", "/" + std::to_string(i), "http", 200);
+  d->commit();
+  d->close_db();
+  delete d;
+  
+  // Not compacted it would be about twice the size
+  CHECK("compaction", file_size(file) < before + before / 2);
+  CHECK("compaction", file_size(file + ".compact") == 0);
+  
+  d = new log_store(file, options);
+  std::int64_t cursor = 0;
+  CHECK("compaction", d->get_links(10, cursor).empty());
+  CHECK("compaction", d->get_visited("h.com", "/5", "http"));
+  CHECK("compaction", d->get_visited("h.com", "/999", "http"));
+  d->close_db();
+  delete d;
+  
+  remove_files(file);
+  std::cout << "log_store: compaction done\n";
+}
+
+static void torn_tail()
+{
+  const std::string file = "storage_test_torn.log";
+  remove_files(file);
+  
+  log_store *d = new log_store(file);
+  d->add_link("http://h.com/last");
+  d->close_db();
+  delete d;
+  
+  // A crash in the middle of appending a record
+  std::uint64_t good = file_size(file);
+  FILE *f = std::fopen(file.c_str(), "ab");
+  std::fwrite("\x01\x02\x03\x04\x05\x06\x07", 1, 7, f);
+  std::fclose(f);
+  
+  d = new log_store(file);
+  std::int64_t cursor = 0;
+  v_links links = d->get_links(10, cursor);
+  CHECK("torn tail", links.size() == 1 && 
+    links[0].to_string() == "http://h.com/last");
+  
+  // New records go where the torn one was
+  d->add_link("http://h.com/after");
+  d->close_db();
+  delete d;
+  CHECK("torn tail", file_size(file) > good);
+  
+  d = new log_store(file);
+  cursor = 0;
+  CHECK("torn tail", d->get_links(10, cursor).size() == 2);
+  d->close_db();
+  delete d;
+  
+  remove_files(file);
+  std::cout << "log_store: torn tail done\n";
+}
+
+static void transactions()
+{
+  const std::string file = "storage_test_transaction.log";
+  remove_files(file);
+  
+  // Buffered records of an open transaction are not written however many
+  log_store_options options;
+  options.write_buffer = 64;
+  log_store *d = new log_store(file, options);
+  std::uint64_t empty = file_size(file);
+  d->begin();
+  for(int i = 0; i < 200; i++)
+    d->add_link("http://h.com/" + std::to_string(i));
+  CHECK("transactions", file_size(file) == empty);
+  d->commit();
+  CHECK("transactions", file_size(file) > empty);
+  
+  // With the links gone from the file, get_links() fails reading the one 
+  // it blacklists inside its transaction
+  d->blacklist("h.com", "/0", "http", "test");
+  CHECK("transactions", ::truncate(file.c_str(), empty) == 0);
+  bool threw = false;
+  try
+  {
+    std::int64_t cursor = 0;
+    d->get_links(10, cursor);
+  } catch (std::exception &e) {
+    threw = true;
+  }
+  CHECK("transactions", threw);
+  
+  // The failed transaction was ended, a commit still writes
+  std::uint64_t before = file_size(file);
+  d->add_link("http://h.com/after");
+  CHECK("transactions", file_size(file) > before);
+  d->close_db();
+  delete d;
+  
+  remove_files(file);
+  std::cout << "log_store: transactions done\n";
+}
+
+static void sqlite_transactions()
+{
+  const std::string file = "storage_test_owner.db";
+  remove_files(file);
+  
+  // A thread's write must not join another thread's open transaction, it
+  // waits for the commit and is then committed on its own
+  sqlite *d = new sqlite(file);
+  d->begin();
+  d->add_link("http://h.com/mine");
+  
+  std::atomic<bool> done(false);
+  std::thread other([&] {
+    d->add_link("http://h.com/other");
+    done = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  CHECK("sqlite transactions", !done);
+  d->commit();
+  other.join();
+  CHECK("sqlite transactions", done);
+  d->close_db();
+  delete d;
+  
+  d = new sqlite(file);
+  std::int64_t cursor = 0;
+  CHECK("sqlite transactions", d->get_links(10, cursor).size() == 2);
+  d->close_db();
+  delete d;
+  
+  remove_files(file);
+  std::cout << "sqlite: transactions done\n";
+}
+
+int main()
+{
+  remove_files("storage_test.db");
+  remove_files("storage_test.log");
+  
+  conformance("sqlite", [] { return new sqlite("storage_test.db"); });
+  conformance("log_store", [] { return new log_store("storage_test.log"); });
+  compaction();
+  torn_tail();
+  transactions();
+  sqlite_transactions();
+  
+  remove_files("storage_test.db");
+  remove_files("storage_test.log");
+  
+  std::cout << (failures ? "FAILED\n" : "OK\n");
+  return failures == 0 ? 0 : 1;
+}
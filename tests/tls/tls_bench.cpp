@@ -0,0 +1,151 @@
+/*
+ * WebCrawler: tls_bench.cpp
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file tls_bench.cpp
+ * @author Kyle Givler
+ * 
+ * Handshakes per second through tls_session_cache against a TLS server 
+ * on localhost, for TLS 1.2 and 1.3, with every handshake a full one and
+ * with each reconnect resuming the session the last one left behind
+ * The server answers each handshake with one byte, which the client 
+ * reads so TLS 1.3 session tickets arrive before it closes
+ * Usage: tls_bench cert.pem key.pem [handshakes]
+ */
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include "connection.hpp"
+#include "tls_session_cache.hpp"
+
+/**
+ * Accepts a number of connections one at a time on its own thread
+ */
+class tls_server
+{
+public:
+  tls_server(const std::string &cert, const std::string &key, int version,
+    int connections)
+    : sslctx(asio::ssl::context::sslv23_server),
+      acceptor(io_service, tcp::endpoint(asio::ip::address_v4::loopback(), 0))
+  {
+    sslctx.use_certificate_chain_file(cert);
+    sslctx.use_private_key_file(key, asio::ssl::context::pem);
+    SSL_CTX_set_min_proto_version(sslctx.native_handle(), version);
+    SSL_CTX_set_max_proto_version(sslctx.native_handle(), version);
+    thread = std::thread(&tls_server::run, this, connections);
+  }
+  
+  ~tls_server()
+  {
+    thread.join();
+  }
+  
+  tcp::endpoint get_endpoint() const { return acceptor.local_endpoint(); }
+  
+private:
+  asio::io_service io_service;
+  asio::ssl::context sslctx;
+  tcp::acceptor acceptor;
+  std::thread thread;
+  
+  void run(int connections)
+  {
+    for(int i = 0; i < connections; i++)
+    {
+      asio::ssl::stream<tcp::socket> stream(io_service, sslctx);
+      system::error_code ec;
+      acceptor.accept(stream.lowest_layer(), ec);
+      if(ec)
+        return;
+      stream.lowest_layer().set_option(tcp::no_delay(true), ec);
+      
+      stream.handshake(asio::ssl::stream_base::server, ec);
+      if(ec)
+        continue;
+      char byte = 'x';
+      asio::write(stream, asio::buffer(&byte, 1), ec);
+      // Returns when the client closes
+      asio::read(stream, asio::buffer(&byte, 1), ec);
+    }
+  }
+};
+
+typedef std::chrono::steady_clock bench_clock;
+
+/**
+ * Connect, handshake and read the server's byte handshakes times
+ * @param resume false to forget each session so the next is a full one
+ */
+static void run(const std::string &cert, const std::string &key, 
+  int version, const char *version_name, bool resume, int handshakes)
+{
+  tls_server server(cert, key, version, handshakes);
+  tls_session_cache tls;
+  asio::io_service io_service;
+  std::string conn_key = "https://localhost:" + 
+    std::to_string(server.get_endpoint().port());
+  
+  auto start = bench_clock::now();
+  for(int i = 0; i < handshakes; i++)
+  {
+    connection conn(io_service, tls.get_context(), conn_key, true);
+    conn.get_socket().connect(server.get_endpoint());
+    conn.get_socket().set_option(tcp::no_delay(true));
+    tls.prepare(conn, "localhost");
+    conn.get_ssl_stream().handshake(asio::ssl::stream_base::client);
+    tls.handshake_done(conn);
+    
+    char byte;
+    asio::read(conn.get_ssl_stream(), asio::buffer(&byte, 1));
+    if(!resume)
+      tls.remove(conn);
+  }
+  double secs = std::chrono::duration<double>(
+    bench_clock::now() - start).count();
+  
+  std::cout << std::setw(7) << version_name 
+    << (resume ? ", resumed: " : ", full:    ")
+    << std::setw(8) << handshakes / secs << " handshakes/s ("
+    << tls.get_resumed() << " of " << tls.get_handshakes() 
+    << " resumed)\n";
+}
+
+int main(int argc, char **argv)
+{
+  if(argc < 3)
+  {
+    std::cerr << "Usage: " << argv[0] << " cert.pem key.pem [handshakes]\n";
+    return 1;
+  }
+  std::string cert = argv[1];
+  std::string key = argv[2];
+  int handshakes = argc > 3 ? std::stoi(argv[3]) : 2000;
+  
+  std::cout << std::fixed << std::setprecision(0);
+  run(cert, key, TLS1_2_VERSION, "TLS 1.2", false, handshakes);
+  run(cert, key, TLS1_2_VERSION, "TLS 1.2", true, handshakes);
+  run(cert, key, TLS1_3_VERSION, "TLS 1.3", false, handshakes);
+  run(cert, key, TLS1_3_VERSION, "TLS 1.3", true, handshakes);
+  return 0;
+}
@@ -0,0 +1,81 @@
+/*
+ * WebCrawler: frontier_memory.cpp
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file frontier_memory.cpp
+ * @author Kyle Givler
+ * 
+ * Heap bytes per queued link with millions of links in the frontier, as
+ * compact_urls with interned hosts, or as the (server, path, protocol) 
+ * string tuples the frontier kept per host before. Run once per layout,
+ * so each starts from a clean heap. Counts what glibc's mallinfo2() 
+ * reports in use
+ * Usage: frontier_memory compact|tuple [links]
+ */
+
+#include <cstdio>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <string>
+#include <tuple>
+#include <malloc.h>
+#include "frontier.hpp"
+
+static std::size_t heap_in_use()
+{
+  struct mallinfo2 m = mallinfo2();
+  return m.uordblks + m.hblkhd;
+}
+
+int main(int argc, char **argv)
+{
+  if(argc < 2)
+  {
+    std::cerr << "Usage: " << argv[0] << " compact|tuple [links]\n";
+    return 1;
+  }
+  bool compact = std::string(argv[1]) == "compact";
+  std::size_t n = argc > 2 ? std::stoul(argv[2]) : 10000000;
+  
+  // The frontier before compact_url: a queue of tuples per host
+  typedef std::tuple<std::string,std::string,std::string> tuple_link;
+  std::map<std::string, std::deque<tuple_link>> tuples;
+  frontier queue(0, 2);
+  
+  std::size_t before = heap_in_use();
+  char path[128];
+  for(std::size_t i = 0; i < n; i++)
+  {
+    std::string host = "www.host" + std::to_string(i % 5000) + 
+      ".example.com";
+    snprintf(path, sizeof(path), "/articles/2014/%zu/some-page-title-%zu.html",
+      i % 977, i);
+    
+    if(compact)
+      queue.push(compact_url("https", host, path));
+    else
+      tuples[host].push_back(tuple_link(host, path, "https"));
+  }
+  std::size_t after = heap_in_use();
+  
+  std::cout << argv[1] << ": " << n << " links, " 
+    << static_cast<double>(after - before) / n << " bytes per link, "
+    << (after - before) / (1024 * 1024) << " MiB\n";
+  return 0;
+}
@@ -0,0 +1,73 @@
+/*
+ * WebCrawler: url_bench.cpp
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file url_bench.cpp
+ * @author Kyle Givler
+ * 
+ * URLs resolved and normalized per second, a mix of the relative, dotted
+ * and absolute links found on pages
+ * Usage: url_bench [rounds]
+ */
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "url.hpp"
+
+int main(int argc, char **argv)
+{
+  std::size_t rounds = argc > 1 ? std::stoul(argv[1]) : 2000;
+  
+  std::vector<std::string> refs;
+  for(int i = 0; i < 1000; i++)
+  {
+    std::string n = std::to_string(i);
+    if(i % 3 == 0)
+      refs.push_back("/path/" + n + "/../page.html");
+    else if(i % 3 == 1)
+      refs.push_back("../rel/" + n + "?x=%7e1");
+    else
+      refs.push_back("https://Other" + std::to_string(i % 10) + 
+        ".com:443/a/./b/" + n + "#frag");
+  }
+  
+  url::parts base = url::split("http://example.com/dir/sub/index.html");
+  std::string out;
+  std::size_t resolved = 0;
+  std::size_t bytes = 0;
+  
+  auto start = std::chrono::steady_clock::now();
+  for(std::size_t r = 0; r < rounds; r++)
+  {
+    for(auto &ref : refs)
+    {
+      if(url::resolve(base, ref, out))
+        bytes += out.size();
+      resolved++;
+    }
+  }
+  std::chrono::duration<double> took = 
+    std::chrono::steady_clock::now() - start;
+  
+  std::cout << resolved << " URLs in " << took.count() << " s: " 
+    << static_cast<std::size_t>(resolved / took.count()) << " URLs/s (" 
+    << bytes << " bytes out)\n";
+  return 0;
+}
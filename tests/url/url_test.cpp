@@ -0,0 +1,200 @@
+/*
+ * WebCrawler: url_test.cpp
+ * Copyright (C) 2014 Kyle Givler
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file url_test.cpp
+ * @author Kyle Givler
+ * 
+ * Resolves the RFC 3986 section 5.4 examples and the crawler's own 
+ * normalization cases, prints each failure and exits non-zero if any
+ * Also interns hosts across several of the host_table's blocks while 
+ * another thread reads the names back
+ */
+
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+#include "compact_url.hpp"
+#include "url.hpp"
+
+// The base URL of RFC 3986 section 5.4
+static const char *rfc_base = "http://a/b/c/d;p?q";
+
+// Links the crawler does not follow, see url::resolve()
+static const char *rejected = "(rejected)";
+
+struct test_case
+{
+  const char *base;
+  const char *ref;
+  const char *expected;
+};
+
+// RFC 3986 5.4.1, the fragment is dropped and "g:h" is not http(s)
+static const test_case normal_cases[] = {
+  { rfc_base, "g:h",      rejected },
+  { rfc_base, "g",        "http://a/b/c/g" },
+  { rfc_base, "./g",      "http://a/b/c/g" },
+  { rfc_base, "g/",       "http://a/b/c/g/" },
+  { rfc_base, "/g",       "http://a/g" },
+  { rfc_base, "//g",      "http://g/" },
+  { rfc_base, "?y",       "http://a/b/c/d;p?y" },
+  { rfc_base, "g?y",      "http://a/b/c/g?y" },
+  { rfc_base, "#s",       "http://a/b/c/d;p?q" },
+  { rfc_base, "g#s",      "http://a/b/c/g" },
+  { rfc_base, "g?y#s",    "http://a/b/c/g?y" },
+  { rfc_base, ";x",       "http://a/b/c/;x" },
+  { rfc_base, "g;x",      "http://a/b/c/g;x" },
+  { rfc_base, "g;x?y#s",  "http://a/b/c/g;x?y" },
+  { rfc_base, "",         "http://a/b/c/d;p?q" },
+  { rfc_base, ".",        "http://a/b/c/" },
+  { rfc_base, "./",       "http://a/b/c/" },
+  { rfc_base, "..",       "http://a/b/" },
+  { rfc_base, "../",      "http://a/b/" },
+  { rfc_base, "../g",     "http://a/b/g" },
+  { rfc_base, "../..",    "http://a/" },
+  { rfc_base, "../../",   "http://a/" },
+  { rfc_base, "../../g",  "http://a/g" },
+};
+
+// RFC 3986 5.4.2, "http:g" is resolved strictly, a scheme without an
+// authority is rejected
+static const test_case abnormal_cases[] = {
+  { rfc_base, "../../../g",    "http://a/g" },
+  { rfc_base, "../../../../g", "http://a/g" },
+  { rfc_base, "/./g",          "http://a/g" },
+  { rfc_base, "/../g",         "http://a/g" },
+  { rfc_base, "g.",            "http://a/b/c/g." },
+  { rfc_base, ".g",            "http://a/b/c/.g" },
+  { rfc_base, "g..",           "http://a/b/c/g.." },
+  { rfc_base, "..g",           "http://a/b/c/..g" },
+  { rfc_base, "./../g",        "http://a/b/g" },
+  { rfc_base, "./g/.",         "http://a/b/c/g/" },
+  { rfc_base, "g/./h",         "http://a/b/c/g/h" },
+  { rfc_base, "g/../h",        "http://a/b/c/h" },
+  { rfc_base, "g;x=1/./y",     "http://a/b/c/g;x=1/y" },
+  { rfc_base, "g;x=1/../y",    "http://a/b/c/y" },
+  { rfc_base, "g?y/./x",       "http://a/b/c/g?y/./x" },
+  { rfc_base, "g?y/../x",      "http://a/b/c/g?y/../x" },
+  { rfc_base, "g#s/./x",       "http://a/b/c/g" },
+  { rfc_base, "g#s/../x",      "http://a/b/c/g" },
+  { rfc_base, "http:g",        rejected },
+};
+
+// Case, percent-encoding, default port and the links the crawler drops
+static const test_case normalization_cases[] = {
+  { rfc_base, "HTTP://Example.COM:80/%7Efoo/%2fa%2Fb/%41",
+    "http://example.com/~foo/%2Fa%2Fb/A" },
+  { rfc_base, "https://x.org:443",         "https://x.org/" },
+  { rfc_base, "https://x.org:80/",         "https://x.org:80/" },
+  { rfc_base, "http://x.org:8080/a",       "http://x.org:8080/a" },
+  { rfc_base, "http://user:pw@x.org/",     "http://x.org/" },
+  { rfc_base, "  /a b\n/c  ",              "http://a/a%20b/c" },
+  { rfc_base, "/a%zz%",                    "http://a/a%25zz%25" },
+  { rfc_base, "/\xc3\xa9",                 "http://a/%C3%A9" },
+  { rfc_base, "/a/%2e%2E/b",               "http://a/b" },
+  { rfc_base, "/a?",                       "http://a/a" },
+  { rfc_base, "http://x.org.:/",           "http://x.org/" },
+  { rfc_base, "http://[::1]:8080/x",       "http://[::1]:8080/x" },
+  { rfc_base, "//Other.com/./x/../y",      "http://other.com/y" },
+  { rfc_base, "http://x.org:99999/",       rejected },
+  { rfc_base, "http:///a",                 rejected },
+  { rfc_base, "javascript:void(0)",        rejected },
+  { rfc_base, "mailto:x@y",                rejected },
+  { "http://a", "b",                       "http://a/b" },
+  { "http://a", "?q",                      "http://a/?q" },
+  { "", "HTTP://A.com/a/../b#f",           "http://a.com/b" },
+};
+
+static int run(const char *name, const test_case *cases, std::size_t count)
+{
+  int failures = 0;
+  std::string out;
+  
+  for(std::size_t i = 0; i < count; i++)
+  {
+    const test_case &t = cases[i];
+    bool ok = *t.base ? url::resolve(url::split(t.base), t.ref, out)
+                      : url::normalize(t.ref, out);
+    std::string got = ok ? out : rejected;
+    
+    if(got != t.expected)
+    {
+      std::cout << "FAIL " << name << ": <" << t.base << "> + <" << t.ref 
+        << "> = <" << got << "> expected <" << t.expected << ">\n";
+      failures++;
+    }
+  }
+  
+  std::cout << name << ": " << count - failures << "/" << count 
+    << " passed\n";
+  return failures;
+}
+
+#define RUN(cases) run(#cases, cases, sizeof(cases) / sizeof(cases[0]))
+
+static std::string host_name(std::size_t i)
+{
+  return "host" + std::to_string(i) + ".example";
+}
+
+static int host_table_test()
+{
+  const std::size_t hosts = 20000;
+  std::atomic<bool> done(false);
+  std::atomic<int> failures(0);
+  
+  // Names are read without the lock while they are being interned
+  std::thread reader([&] {
+    while(!done)
+    {
+      std::size_t n = host_table::size();
+      for(std::size_t id = n > 64 ? n - 64 : 0; id < n; id++)
+        if(host_table::name(id).compare(0, 4, "host") != 0)
+          failures++;
+    }
+  });
+  
+  std::size_t first = host_table::size();
+  for(std::size_t i = 0; i < hosts; i++)
+    if(host_table::intern(host_name(i)) != first + i)
+      failures++;
+  done = true;
+  reader.join();
+  
+  for(std::size_t i = 0; i < hosts; i++)
+  {
+    if(host_table::intern(host_name(i)) != first + i || 
+       host_table::name(first + i) != host_name(i))
+      failures++;
+  }
+  if(host_table::size() != first + hosts)
+    failures++;
+  
+  std::cout << "host_table: " << (failures ? "FAILED" : "passed") << "\n";
+  return failures;
+}
+
+int main()
+{
+  int failures = RUN(normal_cases) + RUN(abnormal_cases) + 
+    RUN(normalization_cases) + host_table_test();
+  
+  return failures == 0 ? 0 : 1;
+}